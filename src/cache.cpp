@@ -473,6 +473,7 @@ void CacheList::preload_cache(level *lev)
 void CacheList::load_cache_prof_info(char *filename, level *lev)
 {
   int j;
+  sound_bank_reset();               // forget the effects queued for the last level
   for (j=0; j<this->total; j++)
     if (list[j].last_access>=0)      // reset all loaded cache items to 0, all non-load to -1
       list[j].last_access=0;
@@ -568,7 +569,7 @@ void CacheList::load_cache_prof_info(char *filename, level *lev)
         case SPEC_CHARACTER2 : fig(j); break;
         case SPEC_IMAGE : img(j); break;
         case SPEC_PARTICLE : part(j); break;
-        case SPEC_EXTERN_SFX : sfx(j); break;
+        case SPEC_EXTERN_SFX : queue_sfx(j); break;
         case SPEC_EXTERNAL_LCACHE : lblock(j); break;
         case SPEC_PALETTE : ctint(j); break;
           }
@@ -621,7 +622,7 @@ void CacheList::load_cache_prof_info(char *filename, level *lev)
         case SPEC_CHARACTER2 : fig(j); break;
         case SPEC_IMAGE : img(j); break;
         case SPEC_PARTICLE : part(j); break;
-        case SPEC_EXTERN_SFX : sfx(j); break;
+        case SPEC_EXTERN_SFX : queue_sfx(j); break;
         case SPEC_EXTERNAL_LCACHE : lblock(j); break;
         case SPEC_PALETTE : ctint(j); break;
       }
@@ -1001,11 +1002,20 @@ sound_effect *CacheList::sfx(int id)
   {
     touch(me);                                           // hold me, feel me, be me!
     char *fn=crc_manager.get_filename(me->file_number);
-    me->data=(void *)new sound_effect(fn);
+    me->data=(void *)new sound_effect(fn,id);
     return (sound_effect *)me->data;
   }
 }
 
+// Sound effects are decoded in the background and only made into a
+// sound_effect, from the decoded data, the first time they are played.
+void CacheList::queue_sfx(int id)
+{
+  CacheItem *me=list+id;
+  CONDITION(id<total && id>=0 && me->file_number>=0,"Bad id");
+  sound_bank_queue(id,crc_manager.get_filename(me->file_number));
+}
+
 
 part_frame *CacheList::part(int id)
 {
@@ -119,6 +119,7 @@ public:
     image *img(int id);
     part_frame *part(int id);
     sound_effect *sfx(int id);
+    void queue_sfx(int id);
     LObject *lblock(int id);
     char_tint *ctint(int id);
 
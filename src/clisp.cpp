@@ -42,6 +42,9 @@
 #include "chat.h"
 #include "jdir.h"
 #include "netcfg.h"
+#include "drawlist.h"
+#include "lisp_aot.h"
+#include "lisp_lex.h"
 
 //AR
 #include "sdlport/setup.h"
@@ -346,7 +349,7 @@ void clisp_init()                            // call by lisp_init, defines symbo
   add_c_bool_fun("platform_push",2,2,         128);
 
   add_c_function("def_sound",1,2,             133);  // symbol, filename [ or just filenmae]
-  add_c_bool_fun("play_sound",1,4,            134);
+  add_c_bool_fun("play_sound",1,5,            134);  // id [volume [x y [pitch]]]
 
   add_c_function("def_particle",2,2,          137);  // symbol, filename
   add_c_function("add_panim",4,4,             138);  // id, x, y, dir
@@ -574,6 +577,11 @@ void clisp_init()                            // call by lisp_init, defines symbo
   add_lisp_function("show_kills",0,0,           62);
   add_lisp_function("mkptr",1,1,                63);
   add_lisp_function("seq",3,3,                  64);
+
+  if (settings.lisp_aot)
+    lisp_aot_register(&lisp_aot_table);
+  if (settings.lisp_lexical)
+    lisp_lex_enable();
 }
 
 
@@ -1210,9 +1218,9 @@ long c_caller(long number, void *args)
     case 48 : return lnumber_value(CAR(args))&BLOCKED_RIGHT; break;
 
     case 50 : dev_cont->add_palette(args); break;
-    case 51 : write_PCX(main_screen,pal,lstring_value(CAR(args))); break;
+    case 51 : draw_list.Flush(); write_PCX(main_screen,pal,lstring_value(CAR(args))); break;
 
-    case 52 : the_game->zoom=lnumber_value(CAR(args)); the_game->draw(); break;
+    case 52 : draw_list.Flush(); the_game->zoom=lnumber_value(CAR(args)); the_game->draw(); break;
     case 55 : the_game->show_help(lstring_value(CAR(args))); break;
 
     case 56 : return current_object->direction; break;
@@ -1302,7 +1310,7 @@ long c_caller(long number, void *args)
       int32_t c = lnumber_value(CAR(args));
       ivec2 pos1 = the_game->GameToMouse(ivec2(x1, y1), current_view);
       ivec2 pos2 = the_game->GameToMouse(ivec2(x2, y2), current_view);
-      main_screen->Line(pos1, pos2, c);
+      draw_list.Line(pos1, pos2, c);
       return 1;
     } break;
     case 93 : return wm->dark_color(); break;
@@ -1419,8 +1427,9 @@ long c_caller(long number, void *args)
         lbreak("expecting y after x in play_sound\n");
         exit(1);
       }
-      int32_t y=lnumber_value(lcar(a));
-      the_game->play_sound(id,vol,x,y);
+      int32_t y=lnumber_value(lcar(a)); a=CDR(a);
+      int pitch=a ? lnumber_value(lcar(a)) : 128;
+      the_game->play_sound(id,vol,x,y,pitch);
     } else cache.sfx(id)->play(vol);
       }
 
@@ -1853,7 +1862,7 @@ long c_caller(long number, void *args)
       int32_t x1=lnumber_value(CAR(args)); args=lcdr(args);
       int32_t y1=lnumber_value(CAR(args)); args=lcdr(args);
       int32_t id=lnumber_value(CAR(args));
-      main_screen->PutImage(cache.img(id), ivec2(x1, y1), 1);
+      draw_list.PutImage(cache.img(id), ivec2(x1, y1));
     } break;
     case 217 :
     {
@@ -1894,7 +1903,7 @@ long c_caller(long number, void *args)
     case 223 :
     {
       char *fn=lstring_value(CAR(args));
-      current_level->save(fn,1);
+      current_level->save(fn,1,save_game_done);
 	  
 	  //AR
 	  settings.quick_load = get_save_filename_prefix();
@@ -1987,7 +1996,7 @@ long c_caller(long number, void *args)
       int32_t s = lnumber_value(CAR(args));
       ivec2 pos1 = the_game->GameToMouse(ivec2(x1, y1), current_view);
       ivec2 pos2 = the_game->GameToMouse(ivec2(x2, y2), current_view);
-      ScatterLine(pos1, pos2, c, s);
+      draw_list.ScatterLine(pos1, pos2, c, s);
       return 1;
 
     } break;
@@ -2040,7 +2049,7 @@ long c_caller(long number, void *args)
       int32_t s = lnumber_value(CAR(args));
       ivec2 pos1 = the_game->GameToMouse(ivec2(x1, y1), current_view);
       ivec2 pos2 = the_game->GameToMouse(ivec2(x2, y2), current_view);
-      AScatterLine(pos1, pos2, c1, c2, s);
+      draw_list.AScatterLine(pos1, pos2, c1, c2, s);
       return 1;
 
     } break;
@@ -2059,7 +2068,7 @@ long c_caller(long number, void *args)
       int32_t cx2=lnumber_value(CAR(args)); args=lcdr(args);
       int32_t cy2=lnumber_value(CAR(args)); args=lcdr(args);
       int32_t c1=lnumber_value(CAR(args)); args=lcdr(args);
-      main_screen->Bar(ivec2(cx1, cy1), ivec2(cx2, cy2), c1);
+      draw_list.Bar(ivec2(cx1, cy1), ivec2(cx2, cy2), c1);
     } break;
     case 248 :
     {
@@ -2215,7 +2224,7 @@ long c_caller(long number, void *args)
       int color=-1;
       if (args)
         color=lnumber_value(CAR(args));
-      fnt->PutString(main_screen, ivec2(x, y), st, color);
+      draw_list.PutString(fnt, ivec2(x, y), st, color);
     } break;
     case 278 : return ((JCFont *)lpointer_value(CAR(args)))->Size().x; break;
     case 279 : return ((JCFont *)lpointer_value(CAR(args)))->Size().y; break;
@@ -2233,7 +2242,7 @@ long c_caller(long number, void *args)
       int32_t x2=lnumber_value(CAR(args));   args=CDR(args);
       int32_t y2=lnumber_value(CAR(args));   args=CDR(args);
       int32_t c=lnumber_value(CAR(args));
-      main_screen->Bar(ivec2(x1, y1), ivec2(x2, y2), c);
+      draw_list.Bar(ivec2(x1, y1), ivec2(x2, y2), c);
     } break;
     case 283 :
     {
@@ -2242,7 +2251,7 @@ long c_caller(long number, void *args)
       int32_t x2=lnumber_value(CAR(args));   args=CDR(args);
       int32_t y2=lnumber_value(CAR(args));   args=CDR(args);
       int32_t c=lnumber_value(CAR(args));
-      main_screen->Rectangle(ivec2(x1, y1), ivec2(x2, y2), c);
+      draw_list.Rectangle(ivec2(x1, y1), ivec2(x2, y2), c);
     } break;
     case 284 :
     {
@@ -16,6 +16,7 @@
 
 #include "level.h"
 #include "intsect.h"
+#include "sampler.h"
 
 class collide_patch
 {
@@ -162,6 +163,7 @@ void add_collide(collide_patch *&first, int32_t x1, int32_t y1, int32_t x2, int3
 
 void level::check_collisions()
 {
+  SampleScope sample(SAMPLE_COLLISIONS);
   game_object *target,*rec,*subject;
   int32_t sx1,sy1,sx2,sy2,tx1,ty1,tx2,ty2,hitx=0,hity=0,t_centerx;
 
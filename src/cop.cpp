@@ -24,6 +24,7 @@
 #include "clisp.h"
 #include "ant.h"
 #include "dev.h"
+#include "drawlist.h"
 
 enum { point_angle, fire_delay1 };
 
@@ -836,9 +837,9 @@ void *bottom_draw()
       {
     player_draw(just_fired,o->get_tint());
     if (o->controller() && o->controller()->local_player())
-      main_screen->PutImage(cache.img(S_health_image),
-                            ivec2(o->controller()->m_bb.x - 20,
-                                  o->controller()->m_aa.y + 5), 1);
+      draw_list.PutImage(cache.img(S_health_image),
+                         ivec2(o->controller()->m_bb.x - 20,
+                               o->controller()->m_aa.y + 5));
       } break;
       case FAST_POWER :
       {
@@ -858,9 +859,9 @@ void *bottom_draw()
     player_draw(just_fired,o->get_tint());
     o->state=(character_state)old_state;
     if (o->controller() && o->controller()->local_player())
-      main_screen->PutImage(cache.img(S_fast_image),
-                            ivec2(o->controller()->m_bb.x - 20,
-                                  o->controller()->m_aa.y + 5), 1);
+      draw_list.PutImage(cache.img(S_fast_image),
+                         ivec2(o->controller()->m_bb.x - 20,
+                               o->controller()->m_aa.y + 5));
       } break;
       case FLY_POWER :
       {
@@ -880,9 +881,9 @@ void *bottom_draw()
     o->state=(character_state)old_state;
 
     if (o->controller() && o->controller()->local_player())
-      main_screen->PutImage(cache.img(S_fly_image),
-                            ivec2(o->controller()->m_bb.x - 20,
-                                  o->controller()->m_aa.y + 5), 1);
+      draw_list.PutImage(cache.img(S_fly_image),
+                         ivec2(o->controller()->m_bb.x - 20,
+                               o->controller()->m_aa.y + 5));
       } break;
       case SNEAKY_POWER :
       {
@@ -894,9 +895,9 @@ void *bottom_draw()
       o->draw_predator();
 
     if (o->controller() && o->controller()->local_player())
-      main_screen->PutImage(cache.img(S_sneaky_image),
-                            ivec2(o->controller()->m_bb.x - 20,
-                                  o->controller()->m_aa.y + 5), 1);
+      draw_list.PutImage(cache.img(S_sneaky_image),
+                         ivec2(o->controller()->m_bb.x - 20,
+                               o->controller()->m_aa.y + 5));
       } break;
     }
   }
@@ -1041,7 +1042,7 @@ void *score_draw()
       if (sorted_players[i]==local)
         strcat(msg," <<");
 
-      fnt->PutString(main_screen, pos, msg, color);
+      draw_list.PutString(fnt, pos, msg, color);
       pos.y += fnt->Size().y;
     }
   }
@@ -12,6 +12,9 @@
 #   include "config.h"
 #endif
 
+#include <stdlib.h>
+#include <string.h>
+
 #include "common.h"
 
 #include "game.h"
@@ -25,6 +28,10 @@
 #include "lisp.h"
 #include "clisp.h"
 #include "net/netface.h"
+#include "jdir.h"
+#include "video.h"
+#include "framedump.h"
+#include "sdlport/setup.h"
 
 
 demo_manager demo_man;
@@ -37,6 +44,10 @@ extern void net_receive();
 extern void net_send(int force);
 extern void fade_in(image *im, int steps);
 extern void fade_out(int steps);
+extern Settings settings;
+extern char req_name[100];
+
+#define DEMO_SEEK_SECONDS 30
 
 void get_event(Event &ev)
 { wm->get_event(ev);
@@ -120,6 +131,12 @@ void demo_manager::do_inputs()
       if (get_packet(buf,size))              // get starting inputs
       {
         process_packet_commands(buf, size);
+        played_ticks++;
+        if (seek_tick>=0 && played_ticks>=seek_tick)
+        {
+          seek_tick=-1;
+          show_position();
+        }
         ivec2 mouse = the_game->GameToMouse(ivec2(player_list->pointer_x,
                                                   player_list->pointer_y),
                                             player_list);
@@ -154,6 +171,14 @@ void demo_manager::reset_game()
 int demo_manager::start_playing(char *filename)
 {
   uint8_t sig[15];
+  if (filename!=play_name)
+  {
+    strncpy(play_name,filename,sizeof(play_name)-1);
+    play_name[sizeof(play_name)-1]=0;
+    Lisp::SaveGlobals();
+  }
+  else
+    Lisp::RestoreGlobals(); // starting over, see seek()
   record_file=open_file(filename,"rb");
   if (record_file->open_failure()) { delete record_file; return 0; }
   char name[100],nsize,diff;
@@ -164,6 +189,14 @@ int demo_manager::start_playing(char *filename)
       record_file->read(&diff,1)!=1)
   { delete record_file; return 0; }
 
+  // One record per tick: count them so seeks know where the end is
+  int32_t start=record_file->tell();
+  uint16_t ps;
+  total_ticks=0;
+  while (record_file->read(&ps,2)==2 && !record_file->seek(lstl(ps),SEEK_CUR))
+    total_ticks++;
+  record_file->seek(start,SEEK_SET);
+
   char tname[100],*c;
   strcpy(tname,name);
   c=tname;
@@ -186,12 +219,79 @@ int demo_manager::start_playing(char *filename)
 
   state=PLAYING;
   reset_game();
+  fast=pause=step=0;
+  played_ticks=0;
 
 
 
   return 1;
 }
 
+void demo_manager::seek(int32_t tick)
+{
+  tick=Max(0,Min(tick,total_ticks));
+  if (tick<played_ticks)
+  {
+    // start over, keeping what the player had chosen
+    int f=fast,p=pause;
+    LSymbol *d=initial_difficulty;
+    delete record_file;
+    record_file=NULL;
+    if (!start_playing(play_name))
+    {
+      set_state(NORMAL);
+      return;
+    }
+    initial_difficulty=d;
+    fast=f; pause=p;
+  }
+  seek_tick=tick>played_ticks ? tick : -1; // do_inputs clears it on arrival
+}
+
+void demo_manager::show_position()
+{
+  int ms=Max(1,(int)settings.physics_update);
+  int32_t at=played_ticks;
+  char msg[100];
+  sprintf(msg,"%d:%02d / %d:%02d%s%s",at*ms/60000,at*ms/1000%60,
+          total_ticks*ms/60000,total_ticks*ms/1000%60,
+          pause ? " paused" : "",fast ? " fast" : "");
+  the_game->show_help(msg);
+}
+
+// Space pauses, '.' steps one tick, 'f' toggles fast forward, the arrows
+// seek DEMO_SEEK_SECONDS back and forth and Home goes back to the start.
+// Any other key ends the demo, as it always did. Nothing else reads events
+// while a demo plays, so everything else is dropped: quitting and window
+// resizes are already acted on by the event layer.
+void demo_manager::playback_keys()
+{
+  while (state==PLAYING && wm->IsPending())
+  {
+    Event ev;
+    wm->get_event(ev);
+    if (ev.type!=EV_KEY)
+      continue;
+
+    int32_t at=played_ticks;
+    int32_t jump=DEMO_SEEK_SECONDS*1000/Max(1,(int)settings.physics_update);
+    switch (ev.key)
+    {
+      case JK_SPACE: pause=!pause; break;
+      case '.': pause=1; step=1; break;
+      case 'f': case 'F': fast=!fast; break;
+      case JK_RIGHT: seek(at+jump); break;
+      case JK_LEFT: seek(at-jump); break;
+      case JK_HOME: seek(0); break;
+      default:
+        set_state(NORMAL);
+        break;
+    }
+    if (state==PLAYING)
+      show_position();
+  }
+}
+
 int demo_manager::set_state(demo_state new_state, char *filename)
 {
   if (new_state==state) return 1;
@@ -202,6 +302,7 @@ int demo_manager::set_state(demo_state new_state, char *filename)
     { delete record_file; } break;
     case PLAYING :
     {
+      seek_tick=-1;
 /*
       fade_in(cache.img(cache.reg("art/help.spe","sell6",SPEC_IMAGE,1)),8);
       Timer now; now.WaitMs(2000);
@@ -278,3 +379,139 @@ int demo_manager::get_packet(void *packet, int &packet_size)   // returns non 0
   return 0;
 }
 
+
+void demo_manager::note_divergence()
+{
+  if (first_divergence<0)
+    first_divergence=played_ticks;
+}
+
+static int compare_names(void const *a, void const *b)
+{
+  return strcmp(*(char * const *)a,*(char * const *)b);
+}
+
+// Plays every .dem file of a directory as fast as possible, without ever
+// drawing, and checks the sync value recorded for each tick against the
+// one computed now. Meant to be run with no display, see main(). Every
+// demo starts from the Lisp globals the first one found, so the result of
+// one does not depend on the demos played before it.
+int verify_demos(char const *dir)
+{
+  char **files,**dirs;
+  int tfiles,tdirs,total=0,failed=0;
+  get_directory((char *)dir,files,tfiles,dirs,tdirs);
+  if (tfiles)
+    qsort(files,tfiles,sizeof(char *),compare_names);
+
+  Lisp::SaveGlobals();
+
+  for (int i=0; i<tfiles; i++)
+  {
+    int len=strlen(files[i]);
+    if (len<4 || strcmp(files[i]+len-4,".dem"))
+      continue;
+
+    char path[512];
+    snprintf(path,sizeof(path),"%s/%s",dir,files[i]);
+    total++;
+
+    Lisp::RestoreGlobals();
+    demo_man.first_divergence=-1;
+    if (!demo_man.set_state(demo_manager::PLAYING,path))
+    {
+      printf("FAIL %s: cannot be played\n",files[i]);
+      failed++;
+      continue;
+    }
+
+    Uint32 start=SDL_GetTicks();
+    int32_t ticks=0;
+    while (demo_man.current_state()==demo_manager::PLAYING && !the_game->done())
+    {
+      if (req_name[0])
+      {
+        the_game->load_level(req_name);
+        req_name[0]=0;
+      }
+
+      demo_man.do_inputs();
+      if (demo_man.current_state()!=demo_manager::PLAYING ||
+          demo_man.first_divergence>=0)
+        break;
+      the_game->step();
+      ticks++;
+    }
+    Uint32 ms=Max(1,(int)(SDL_GetTicks()-start));
+    if (demo_man.current_state()==demo_manager::PLAYING)
+      demo_man.set_state(demo_manager::NORMAL);
+
+    if (demo_man.first_divergence>=0)
+    {
+      printf("FAIL %s: out of sync at tick %d (%d ticks/s)\n",files[i],
+             demo_man.first_divergence,(int)(ticks*1000LL/ms));
+      failed++;
+    }
+    else
+      printf("PASS %s: %d ticks (%d ticks/s)\n",files[i],ticks,
+             (int)(ticks*1000LL/ms));
+  }
+
+  printf("%d of %d demos passed\n",total-failed,total);
+
+  for (int i=0; i<tfiles; i++) free(files[i]);
+  for (int i=0; i<tdirs; i++) free(dirs[i]);
+  free(files);
+  free(dirs);
+  return failed;
+}
+
+// Plays a demo with no frame limiter and writes one picture per game tick,
+// so the video runs at exactly the tick rate whatever the machine's speed.
+int export_demo(char const *demo, char const *output)
+{
+  if (!demo_man.set_state(demo_manager::PLAYING,(char *)demo))
+  {
+    fprintf(stderr,"%s: cannot be played\n",demo);
+    return 0;
+  }
+  if (!framedump_open(output))
+  {
+    fprintf(stderr,"%s: cannot be opened for writing\n",output);
+    demo_man.set_state(demo_manager::NORMAL);
+    return 0;
+  }
+
+  int ms=Max(1,(int)settings.physics_update);
+  fprintf(stderr,"writing %dx%d rgb24 frames at %d/%d fps, for example:\n"
+         "  ffmpeg -f rawvideo -pix_fmt rgb24 -s %dx%d -r %d/%d -i - out.mp4\n",
+         xres,yres,1000,ms,xres,yres,1000,ms);
+
+  Uint32 start=SDL_GetTicks();
+  int32_t frames=0;
+  while (demo_man.current_state()==demo_manager::PLAYING && !the_game->done())
+  {
+    if (req_name[0])
+    {
+      the_game->load_level(req_name);
+      req_name[0]=0;
+    }
+
+    demo_man.do_inputs();
+    if (demo_man.current_state()!=demo_manager::PLAYING)
+      break;
+    the_game->step();
+
+    the_game->frame_alpha=256;
+    the_game->update_screen();
+    framedump_grab();
+    frames++;
+  }
+  if (demo_man.current_state()==demo_manager::PLAYING)
+    demo_man.set_state(demo_manager::NORMAL);
+  framedump_close();
+
+  Uint32 elapsed=Max(1,(int)(SDL_GetTicks()-start));
+  fprintf(stderr,"%d frames written (%d frames/s)\n",frames,(int)(frames*1000LL/elapsed));
+  return 1;
+}
@@ -20,6 +20,17 @@ class demo_manager
   bFILE *record_file;
   int skip_next;
 
+  // Playback controls. A demo only holds the inputs of each tick, so the
+  // world at a given tick can only be rebuilt by playing up to it: a seek
+  // runs the ticks as fast as possible with drawing off, and a seek
+  // backwards first starts the demo over, with the Lisp globals put back
+  // as they were when it first started.
+  char play_name[256];
+  int32_t total_ticks, seek_tick;
+  int fast, pause, step;
+  void seek(int32_t tick);
+  void show_position();
+
   public :
   enum demo_state { NORMAL,
             RECORDING,
@@ -33,12 +44,27 @@ class demo_manager
   int start_recording(char *filename);
   void reset_game();
   int demo_skip() { if (skip_next) { skip_next--; return 1; } else return 0; }
-  demo_manager() { state=NORMAL; skip_next=0; }
+  demo_manager() { state=NORMAL; skip_next=0; total_ticks=0; seek_tick=-1; fast=pause=step=0;
+                   played_ticks=0;
+                   first_divergence=-1; }
   void do_inputs();
+
+  void playback_keys();              // call once per frame while playing
+  int fast_forwarding() { return state==PLAYING && (fast || seek_tick>=0); } // run ticks with no delay?
+  int seeking() { return state==PLAYING && seek_tick>=0; } // skip drawing?
+  int paused() { return state==PLAYING && pause && seek_tick<0; }
+  int take_step() { int s=step; step=0; return s; }
+
+  int32_t played_ticks;              // since the demo started, across levels
+  int32_t first_divergence;          // played_ticks when a sync value did not match
+  void note_divergence();
 } ;
 
 extern demo_manager demo_man;
 
+int verify_demos(char const *dir);   // returns the number of failed demos
+int export_demo(char const *demo, char const *output); // raw RGB frames
+
 extern void get_event(Event &ev);
 extern int event_waiting();
 
@@ -38,6 +38,8 @@
 #include "sbar.h"
 #include "compiled.h"
 #include "chat.h"
+#include "sampler.h"
+#include "net/netstat.h"
 
 //AR
 #include "sdlport/setup.h"
@@ -1189,6 +1191,20 @@ void dev_controll::do_command(char const *command, Event &ev)
     the_game->need_refresh();
   }
 
+  if (!strcmp(fword,"sample"))
+    sampler_toggle(st);
+
+  if (!strcmp(fword,"sfx"))
+    sound_show_stats();
+
+  if (!strcmp(fword,"netstat"))
+  {
+    if (st[0])
+      netstat_csv_toggle(st);
+    else
+      netstat_overlay=!netstat_overlay;
+  }
+
   if (!strcmp(fword,"mem"))
   {
     if (st[0])
@@ -3457,6 +3473,8 @@ void dev_controll::show_mem()
   }
   dprintf("%d character=%d bytes\n",t,s);
 
+  objpool_show_stats();
+
 }
 
 
@@ -0,0 +1,316 @@
+/*
+ *  Abuse - dark 2D side-scrolling platform game
+ *  Copyright (c) 1995 Crack dot Com
+ *  Copyright (c) 2005-2011 Sam Hocevar <sam@hocevar.net>
+ *
+ *  This software was released into the Public Domain. As with most public
+ *  domain software, no warranty is made or implied by Crack dot Com, by
+ *  Jonathan Clark, or by Sam Hocevar.
+ */
+
+#if defined HAVE_CONFIG_H
+#   include "config.h"
+#endif
+
+#include <string.h>
+
+#include "common.h"
+
+#include "drawlist.h"
+#include "video.h"
+#include "particle.h"
+#include "loader2.h"
+#include "jrand.h"
+#include "game.h"
+
+DrawList draw_list;
+
+void DrawList::Begin()
+{
+    // A nested frame (a draw function redrawing the whole game) must not
+    // end up underneath what was recorded before it.
+    if (m_depth)
+        Flush();
+    m_depth++;
+}
+
+void DrawList::End()
+{
+    Flush();
+    if (m_depth)
+        m_depth--;
+}
+
+void DrawList::Flush()
+{
+    if (m_items.empty())
+        return;
+
+    // Rasterising may itself end up drawing (fonts, scatter lines), make
+    // sure that goes straight to the screen.
+    int depth = m_depth;
+    m_depth = 0;
+
+    for (size_t i = 0; i < m_items.size(); i++)
+        Rasterise(m_items[i]);
+
+    m_items.clear();
+    m_text.clear();
+    m_depth = depth;
+}
+
+DrawItem &DrawList::Add(int op, void *src, ivec2 p1)
+{
+    m_items.push_back(DrawItem());
+    DrawItem &item = m_items.back();
+    item.op = op;
+    item.screen = main_screen;
+    main_screen->GetClip(item.caa, item.cbb);
+    item.src = src;
+    item.p1 = p1;
+    return item;
+}
+
+void DrawList::Rasterise(DrawItem const &item)
+{
+    image *screen = item.screen;
+    ivec2 caa, cbb;
+    screen->GetClip(caa, cbb);
+    screen->SetClip(item.caa, item.cbb);
+
+    TransImage *timg = (TransImage *)item.src;
+
+    switch (item.op)
+    {
+    case OP_IMAGE:
+        timg->PutImage(screen, item.p1);
+        break;
+    case OP_REMAP:
+        timg->PutRemap(screen, item.p1, item.map1);
+        break;
+    case OP_DOUBLE_REMAP:
+        timg->PutDoubleRemap(screen, item.p1, item.map1, item.map2);
+        break;
+    case OP_FADE:
+        timg->PutFade(screen, item.p1, item.a, item.b,
+                      color_table, the_game->current_palette());
+        break;
+    case OP_FADE_TINT:
+        timg->PutFadeTint(screen, item.p1, item.a, item.b, item.map1,
+                          color_table, the_game->current_palette());
+        break;
+    case OP_PREDATOR:
+        timg->PutPredator(screen, item.p1);
+        break;
+    case OP_SCANLINE:
+        timg->PutScanLine(screen, item.p1, item.a);
+        break;
+    case OP_PUT_IMAGE:
+        screen->PutImage((image *)item.src, item.p1, 1);
+        break;
+    case OP_LINE:
+        screen->Line(item.p1, item.p2, item.a);
+        break;
+    case OP_SCATTER_LINE:
+    case OP_ASCATTER_LINE:
+    {
+        // Replay the random numbers the line would have used when it was
+        // recorded, so the draw functions in between saw the same ones.
+        image *old_screen = main_screen;
+        unsigned short old_rand = rand_on;
+        main_screen = screen;
+        rand_on = item.d;
+        if (item.op == OP_SCATTER_LINE)
+            ::ScatterLine(item.p1, item.p2, item.a, item.c);
+        else
+            ::AScatterLine(item.p1, item.p2, item.a, item.b, item.c);
+        rand_on = old_rand;
+        main_screen = old_screen;
+        break;
+    }
+    case OP_BAR:
+        screen->Bar(item.p1, item.p2, item.a);
+        break;
+    case OP_RECT:
+        screen->Rectangle(item.p1, item.p2, item.a);
+        break;
+    case OP_STRING:
+        ((JCFont *)item.src)->PutString(screen, item.p1, &m_text[item.b],
+                                        item.a);
+        break;
+    }
+
+    screen->SetClip(caa, cbb);
+}
+
+void DrawList::PutImage(TransImage *im, ivec2 pos)
+{
+    if (!IsRecording())
+    {
+        im->PutImage(main_screen, pos);
+        return;
+    }
+    Add(OP_IMAGE, im, pos);
+}
+
+void DrawList::PutRemap(TransImage *im, ivec2 pos, uint8_t *map)
+{
+    if (!IsRecording())
+    {
+        im->PutRemap(main_screen, pos, map);
+        return;
+    }
+    Add(OP_REMAP, im, pos).map1 = map;
+}
+
+void DrawList::PutDoubleRemap(TransImage *im, ivec2 pos, uint8_t *map,
+                              uint8_t *map2)
+{
+    if (!IsRecording())
+    {
+        im->PutDoubleRemap(main_screen, pos, map, map2);
+        return;
+    }
+    DrawItem &item = Add(OP_DOUBLE_REMAP, im, pos);
+    item.map1 = map;
+    item.map2 = map2;
+}
+
+void DrawList::PutFade(TransImage *im, ivec2 pos, int amount, int nframes)
+{
+    if (!IsRecording())
+    {
+        im->PutFade(main_screen, pos, amount, nframes,
+                    color_table, the_game->current_palette());
+        return;
+    }
+    DrawItem &item = Add(OP_FADE, im, pos);
+    item.a = amount;
+    item.b = nframes;
+}
+
+void DrawList::PutFadeTint(TransImage *im, ivec2 pos, int amount,
+                           int nframes, uint8_t *tint)
+{
+    if (!IsRecording())
+    {
+        im->PutFadeTint(main_screen, pos, amount, nframes, tint,
+                        color_table, the_game->current_palette());
+        return;
+    }
+    DrawItem &item = Add(OP_FADE_TINT, im, pos);
+    item.a = amount;
+    item.b = nframes;
+    item.map1 = tint;
+}
+
+void DrawList::PutPredator(TransImage *im, ivec2 pos)
+{
+    if (!IsRecording())
+    {
+        im->PutPredator(main_screen, pos);
+        return;
+    }
+    Add(OP_PREDATOR, im, pos);
+}
+
+void DrawList::PutScanLine(TransImage *im, ivec2 pos, int line)
+{
+    if (!IsRecording())
+    {
+        im->PutScanLine(main_screen, pos, line);
+        return;
+    }
+    Add(OP_SCANLINE, im, pos).a = line;
+}
+
+void DrawList::PutImage(image *im, ivec2 pos)
+{
+    if (!IsRecording())
+    {
+        main_screen->PutImage(im, pos, 1);
+        return;
+    }
+    Add(OP_PUT_IMAGE, im, pos);
+}
+
+void DrawList::Line(ivec2 p1, ivec2 p2, int color)
+{
+    if (!IsRecording())
+    {
+        main_screen->Line(p1, p2, color);
+        return;
+    }
+    DrawItem &item = Add(OP_LINE, NULL, p1);
+    item.p2 = p2;
+    item.a = color;
+}
+
+void DrawList::ScatterLine(ivec2 p1, ivec2 p2, int c, int s)
+{
+    if (!IsRecording())
+    {
+        ::ScatterLine(p1, p2, c, s);
+        return;
+    }
+    DrawItem &item = Add(OP_SCATTER_LINE, NULL, p1);
+    item.p2 = p2;
+    item.a = c;
+    item.c = s;
+    item.d = rand_on;
+    // the line draws two random numbers per point
+    rand_on += 2 * (1 + Max(abs(p2.x - p1.x), abs(p2.y - p1.y)));
+}
+
+void DrawList::AScatterLine(ivec2 p1, ivec2 p2, int c1, int c2, int s)
+{
+    if (!IsRecording())
+    {
+        ::AScatterLine(p1, p2, c1, c2, s);
+        return;
+    }
+    DrawItem &item = Add(OP_ASCATTER_LINE, NULL, p1);
+    item.p2 = p2;
+    item.a = c1;
+    item.b = c2;
+    item.c = s;
+    item.d = rand_on;
+    rand_on += 2 * (1 + Max(abs(p2.x - p1.x), abs(p2.y - p1.y)));
+}
+
+void DrawList::Bar(ivec2 p1, ivec2 p2, int color)
+{
+    if (!IsRecording())
+    {
+        main_screen->Bar(p1, p2, color);
+        return;
+    }
+    DrawItem &item = Add(OP_BAR, NULL, p1);
+    item.p2 = p2;
+    item.a = color;
+}
+
+void DrawList::Rectangle(ivec2 p1, ivec2 p2, int color)
+{
+    if (!IsRecording())
+    {
+        main_screen->Rectangle(p1, p2, color);
+        return;
+    }
+    DrawItem &item = Add(OP_RECT, NULL, p1);
+    item.p2 = p2;
+    item.a = color;
+}
+
+void DrawList::PutString(JCFont *font, ivec2 pos, char const *st, int color)
+{
+    if (!IsRecording())
+    {
+        font->PutString(main_screen, pos, st, color);
+        return;
+    }
+    DrawItem &item = Add(OP_STRING, font, pos);
+    item.a = color;
+    item.b = (int32_t)m_text.size();
+    m_text.insert(m_text.end(), st, st + strlen(st) + 1);
+}
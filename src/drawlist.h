@@ -0,0 +1,97 @@
+/*
+ *  Abuse - dark 2D side-scrolling platform game
+ *  Copyright (c) 1995 Crack dot Com
+ *  Copyright (c) 2005-2011 Sam Hocevar <sam@hocevar.net>
+ *
+ *  This software was released into the Public Domain. As with most public
+ *  domain software, no warranty is made or implied by Crack dot Com, by
+ *  Jonathan Clark, or by Sam Hocevar.
+ */
+
+#ifndef __DRAWLIST_HPP_
+#define __DRAWLIST_HPP_
+
+#include <vector>
+
+#include "image.h"
+#include "transimage.h"
+#include "fonts.h"
+
+// Object drawing is done in two passes: while the level walks its active
+// list (running C and Lisp draw functions), every primitive those functions
+// ask for is recorded here with its screen position, remap tables and the
+// clip rectangle in effect; afterwards the list is rasterised in one go.
+// Outside of Begin()/End() every call draws straight away, so code that
+// also runs outside object drawing can use the list unconditionally.
+
+struct DrawItem
+{
+    uint8_t op;
+    image *screen;          // main_screen or small_render at record time
+    ivec2 caa, cbb;         // clip rectangle at record time
+    void *src;              // TransImage, image or JCFont depending on op
+    ivec2 p1, p2;
+    uint8_t *map1, *map2;   // remap or tint tables
+    int32_t a, b, c, d;     // fade amount/frames, colours, scatter, text...
+};
+
+class DrawList
+{
+public:
+    enum
+    {
+        OP_IMAGE,           // TransImage::PutImage
+        OP_REMAP,           // TransImage::PutRemap
+        OP_DOUBLE_REMAP,    // TransImage::PutDoubleRemap
+        OP_FADE,            // TransImage::PutFade
+        OP_FADE_TINT,       // TransImage::PutFadeTint
+        OP_PREDATOR,        // TransImage::PutPredator
+        OP_SCANLINE,        // TransImage::PutScanLine
+        OP_PUT_IMAGE,       // image::PutImage, transparent
+        OP_LINE,
+        OP_SCATTER_LINE,
+        OP_ASCATTER_LINE,
+        OP_BAR,
+        OP_RECT,
+        OP_STRING,
+    };
+
+    DrawList() : m_depth(0) { }
+
+    void Begin();           // start recording
+    void End();             // rasterise everything recorded and stop
+    void Flush();           // rasterise what is pending, keep recording
+
+    bool IsRecording() const { return m_depth > 0; }
+    size_t Pending() const { return m_items.size(); }
+
+    void PutImage(TransImage *im, ivec2 pos);
+    void PutRemap(TransImage *im, ivec2 pos, uint8_t *map);
+    void PutDoubleRemap(TransImage *im, ivec2 pos, uint8_t *map,
+                        uint8_t *map2);
+    void PutFade(TransImage *im, ivec2 pos, int amount, int nframes);
+    void PutFadeTint(TransImage *im, ivec2 pos, int amount, int nframes,
+                     uint8_t *tint);
+    void PutPredator(TransImage *im, ivec2 pos);
+    void PutScanLine(TransImage *im, ivec2 pos, int line);
+
+    void PutImage(image *im, ivec2 pos);
+    void Line(ivec2 p1, ivec2 p2, int color);
+    void ScatterLine(ivec2 p1, ivec2 p2, int c, int s);
+    void AScatterLine(ivec2 p1, ivec2 p2, int c1, int c2, int s);
+    void Bar(ivec2 p1, ivec2 p2, int color);
+    void Rectangle(ivec2 p1, ivec2 p2, int color);
+    void PutString(JCFont *font, ivec2 pos, char const *st, int color);
+
+private:
+    DrawItem &Add(int op, void *src, ivec2 p1);
+    void Rasterise(DrawItem const &item);
+
+    int m_depth;
+    std::vector<DrawItem> m_items;
+    std::vector<char> m_text;
+};
+
+extern DrawList draw_list;
+
+#endif
@@ -0,0 +1,228 @@
+/*
+ *  Abuse - dark 2D side-scrolling platform game
+ *  Copyright (c) 1995 Crack dot Com
+ *  Copyright (c) 2005-2011 Sam Hocevar <sam@hocevar.net>
+ *
+ *  This software was released into the Public Domain. As with most public
+ *  domain software, no warranty is made or implied by Crack dot Com, by
+ *  Jonathan Clark, or by Sam Hocevar.
+ */
+
+#if defined HAVE_CONFIG_H
+#   include "config.h"
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#include <SDL.h>
+
+#include "common.h"
+
+#include "framedump.h"
+#include "video.h"
+#include "dprint.h"
+
+#define DUMP_SLOTS 8       // frames in flight
+#define DUMP_MAX_WORKERS 4
+
+extern SDL_Surface *surface; // the 8-bit screen, see sdlport/video.cpp
+
+enum { SLOT_FREE, SLOT_GRABBED, SLOT_CONVERTING, SLOT_DONE };
+
+struct dump_slot
+{
+  int state;
+  std::vector<uint8_t> pixels, rgb;
+  uint8_t palette[256*3];
+};
+
+static dump_slot slots[DUMP_SLOTS];
+static int dump_w, dump_h;
+static int next_grab, next_write, quitting;
+static FILE *dump_fp = NULL;
+static int dump_is_pipe;
+static SDL_mutex *dump_mutex;
+static SDL_cond *dump_cond;
+static SDL_Thread *writer, *workers[DUMP_MAX_WORKERS];
+static int total_workers;
+static int stdout_fd = -1; // the real standard output, see framedump_take_stdout
+
+static int convert_frames(void *data)
+{
+  (void)data;
+  SDL_LockMutex(dump_mutex);
+  for (;;)
+  {
+    dump_slot *s=NULL;
+    for (int i=0; i<DUMP_SLOTS && !s; i++)
+      if (slots[i].state==SLOT_GRABBED)
+        s=&slots[i];
+    if (!s)
+    {
+      if (quitting)
+        break;
+      SDL_CondWait(dump_cond,dump_mutex);
+      continue;
+    }
+    s->state=SLOT_CONVERTING;
+    SDL_UnlockMutex(dump_mutex);
+
+    uint8_t const *src=&s->pixels[0];
+    uint8_t *dst=&s->rgb[0];
+    for (int i=dump_w*dump_h; i; i--,dst+=3)
+      memcpy(dst,s->palette+*src++*3,3);
+
+    SDL_LockMutex(dump_mutex);
+    s->state=SLOT_DONE;
+    SDL_CondBroadcast(dump_cond);
+  }
+  SDL_UnlockMutex(dump_mutex);
+  return 0;
+}
+
+static int write_frames(void *data)
+{
+  (void)data;
+  SDL_LockMutex(dump_mutex);
+  for (;;)
+  {
+    dump_slot &s=slots[next_write%DUMP_SLOTS];
+    if (s.state!=SLOT_DONE)
+    {
+      if (quitting && next_write==next_grab)
+        break;
+      SDL_CondWait(dump_cond,dump_mutex);
+      continue;
+    }
+    SDL_UnlockMutex(dump_mutex);
+
+    size_t size=s.rgb.size();
+    if (dump_fp && fwrite(&s.rgb[0],1,size,dump_fp)!=size)
+    {
+      dprintf("framedump: write failed, no more frames\n");
+      if (dump_is_pipe) pclose(dump_fp); else if (dump_fp!=stdout) fclose(dump_fp);
+      dump_fp=NULL;
+    }
+
+    SDL_LockMutex(dump_mutex);
+    s.state=SLOT_FREE;
+    next_write++;
+    SDL_CondBroadcast(dump_cond);
+  }
+  SDL_UnlockMutex(dump_mutex);
+  return 0;
+}
+
+void framedump_take_stdout()
+{
+#ifdef HAVE_UNISTD_H
+  fflush(stdout);
+  stdout_fd=dup(1);
+  if (stdout_fd>=0)
+    dup2(2,1);
+#endif
+}
+
+int framedump_open(char const *name)
+{
+  dump_is_pipe=name[0]=='|';
+  if (!strcmp(name,"-"))
+  {
+#ifdef HAVE_UNISTD_H
+    dump_fp=stdout_fd>=0 ? fdopen(stdout_fd,"wb") : NULL;
+#else
+    dump_fp=stdout;
+#endif
+  }
+  else if (dump_is_pipe)
+    dump_fp=popen(name+1,"w");
+  else
+    dump_fp=fopen(name,"wb");
+  if (!dump_fp)
+    return 0;
+
+  dump_w=xres;
+  dump_h=yres;
+  next_grab=next_write=quitting=0;
+  for (int i=0; i<DUMP_SLOTS; i++)
+  {
+    slots[i].state=SLOT_FREE;
+    slots[i].pixels.resize(dump_w*dump_h);
+    slots[i].rgb.resize(dump_w*dump_h*3);
+  }
+
+  dump_mutex=SDL_CreateMutex();
+  dump_cond=SDL_CreateCond();
+  total_workers=Max(1,Min(SDL_GetCPUCount()-1,DUMP_MAX_WORKERS));
+  for (int i=0; i<total_workers; i++)
+    workers[i]=SDL_CreateThread(convert_frames,"framedump",NULL);
+  writer=SDL_CreateThread(write_frames,"framedump writer",NULL);
+  return 1;
+}
+
+void framedump_grab()
+{
+  if (!dump_mutex)
+    return;
+
+  SDL_LockMutex(dump_mutex);
+  dump_slot &s=slots[next_grab%DUMP_SLOTS];
+  while (s.state!=SLOT_FREE)     // the encoder is behind, wait for it
+    SDL_CondWait(dump_cond,dump_mutex);
+  SDL_UnlockMutex(dump_mutex);
+
+  if (SDL_MUSTLOCK(surface))
+    SDL_LockSurface(surface);
+  for (int y=0; y<dump_h; y++)
+    memcpy(&s.pixels[y*dump_w],(uint8_t *)surface->pixels+y*surface->pitch,dump_w);
+  if (SDL_MUSTLOCK(surface))
+    SDL_UnlockSurface(surface);
+
+  SDL_Color const *c=surface->format->palette->colors;
+  int ncolors=Min(surface->format->palette->ncolors,256);
+  memset(s.palette,0,sizeof(s.palette));
+  for (int i=0; i<ncolors; i++)
+  {
+    s.palette[i*3]=c[i].r;
+    s.palette[i*3+1]=c[i].g;
+    s.palette[i*3+2]=c[i].b;
+  }
+
+  SDL_LockMutex(dump_mutex);
+  s.state=SLOT_GRABBED;
+  next_grab++;
+  SDL_CondBroadcast(dump_cond);
+  SDL_UnlockMutex(dump_mutex);
+}
+
+void framedump_close()
+{
+  if (!dump_mutex)
+    return;
+
+  SDL_LockMutex(dump_mutex);
+  quitting=1;
+  SDL_CondBroadcast(dump_cond);
+  SDL_UnlockMutex(dump_mutex);
+
+  SDL_WaitThread(writer,NULL);
+  for (int i=0; i<total_workers; i++)
+    SDL_WaitThread(workers[i],NULL);
+
+  if (dump_fp)
+  {
+    if (dump_is_pipe) pclose(dump_fp);
+    else if (dump_fp==stdout) fflush(stdout);
+    else fclose(dump_fp);
+    dump_fp=NULL;
+  }
+  SDL_DestroyCond(dump_cond);
+  SDL_DestroyMutex(dump_mutex);
+  dump_cond=NULL;
+  dump_mutex=NULL;
+}
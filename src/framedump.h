@@ -0,0 +1,27 @@
+/*
+ *  Abuse - dark 2D side-scrolling platform game
+ *  Copyright (c) 1995 Crack dot Com
+ *  Copyright (c) 2005-2011 Sam Hocevar <sam@hocevar.net>
+ *
+ *  This software was released into the Public Domain. As with most public
+ *  domain software, no warranty is made or implied by Crack dot Com, by
+ *  Jonathan Clark, or by Sam Hocevar.
+ */
+
+#ifndef __FRAMEDUMP_HPP_
+#define __FRAMEDUMP_HPP_
+
+// Writes screen frames as raw 24-bit RGB, one after the other with no
+// header, for an encoder such as "ffmpeg -f rawvideo -pix_fmt rgb24".
+// Grabbing only copies the 8-bit screen and its palette; worker threads
+// expand the palette while the game goes on, and a writer thread puts
+// the frames out in order.
+
+// Call before anything else is printed when writing to "-": keeps the real
+// standard output for the frames and sends printf's text to stderr instead.
+void framedump_take_stdout();
+int framedump_open(char const *name);  // "-" is stdout, "|cmd" pipes to cmd
+void framedump_grab();
+void framedump_close();                // waits for the queued frames
+
+#endif
@@ -75,6 +75,9 @@
 #include "chat.h"
 #include "demo.h"
 #include "netcfg.h"
+#include "sampler.h"
+#include "net/netstat.h"
+#include "framedump.h"
 
 //AR
 #include "sdlport/setup.h"
@@ -94,6 +97,10 @@ int frame_panic = 0, massive_frame_panic = 0;
 int demo_start = 0, idle_ticks = 0;
 int req_end = 0;
 
+// ticks the main loop may run back to back to catch up after a slow frame
+#define MAX_TICKS_PER_FRAME 4
+#define DEMO_FAST_MS 40 // time spent ticking per drawn frame in demo fast forward
+
 extern palette *old_pal;
 char **start_argv;
 int start_argc;
@@ -172,7 +179,7 @@ void AR_HiresTitleScreen()
 }*/
 //
 
-void Game::play_sound(int id, int vol, int32_t x, int32_t y)
+void Game::play_sound(int id, int vol, int32_t x, int32_t y, int pitch)
 {
     if(!(sound_avail & SFX_INITIALIZED))
         return;
@@ -217,7 +224,7 @@ void Game::play_sound(int id, int vol, int32_t x, int32_t y)
 
     int v = (400 - mindist) * sfx_volume / 400 - (127 - vol);
     if(v > 0)
-        cache.sfx(id)->play(v, 128, p);
+        cache.sfx(id)->play(v, pitch, p);
 }
 
 int get_option(char const *name)
@@ -540,6 +547,8 @@ void Game::set_level(level *nl)
 
 void Game::load_level(char const *name)
 {
+    level_save_wait(); // it may be the save still being written
+
     if(current_level)
       delete current_level;
 
@@ -675,6 +684,7 @@ static void post_render()
 
 void Game::draw_map(view *v, int interpolate)
 {
+  SampleScope sample(SAMPLE_DRAW_MAP);
   backtile *bt;
   int x1, y1, x2, y2, x, y, xo, yo, nxoff, nyoff;
   ivec2 caa, cbb;
@@ -738,8 +748,8 @@ void Game::draw_map(view *v, int interpolate)
   int32_t xoff, yoff;
   if(interpolate)
   {
-    xoff = v->interpolated_xoff();
-    yoff = v->interpolated_yoff();
+    xoff = v->interpolated_xoff(frame_alpha);
+    yoff = v->interpolated_yoff(frame_alpha);
   } else
   {
     xoff = v->xoff();
@@ -929,7 +939,7 @@ void Game::draw_map(view *v, int interpolate)
   if(dev & DRAW_PEOPLE_LAYER)
   {
     if(interpolate)
-      current_level->interpolate_draw_objects(v);
+      current_level->interpolate_draw_objects(v, frame_alpha);
     else
       current_level->draw_objects(v);
   }
@@ -1342,6 +1352,7 @@ Game::Game(int argc, char **argv)
   help_text_frames = 0;
   strcpy(help_text, "");
   no_delay = 0;
+  frame_alpha = 0;
 
   image_init();
   zoom = 15;
@@ -1498,6 +1509,14 @@ void Game::toggle_delay()
 
 void Game::show_time()
 {
+    if (first_view && netstat_overlay)
+    {
+        char const *line;
+        for (int i = 0; (line = netstat_line(i)); i++)
+            console_font->PutString(main_screen, first_view->m_aa
+                                    + ivec2(0, (fps_on ? 20 : 0) + i * 10), line);
+    }
+
     if (!first_view || !fps_on)
         return;
 
@@ -1537,14 +1556,7 @@ void Game::update_screen()
       for(f = first_view; f; f = f->next)
       {
         if(f->drawable())
-    {
-      if(interpolate_draw)
-      {
-            draw_map(f, 1);
-        wm->flush_screen();
-      }
-          draw_map(f, 0);
-    }
+          draw_map(f, interpolate_draw);
       }
       if(current_automap)
       current_automap->draw();
@@ -1854,8 +1866,14 @@ void net_send(int force = 0)
         if (p->local_player())
           p->get_input();
 
-      base->packet.write_uint8(SCMD_SYNC);
-      base->packet.write_uint16(make_sync());
+      net_add_timing(Max(1, (int)settings.physics_update));
+
+      // Held input is sent with the next round's, which has its own sync
+      if (!net_input_held())
+      {
+        base->packet.write_uint8(SCMD_SYNC);
+        base->packet.write_uint16(make_sync());
+      }
 
       if (base->join_list)
         base->packet.write_uint8(SCMD_RELOAD);
@@ -1981,9 +1999,14 @@ void Game::step()
         set_key_down(JK_ESC, 0);
       }
       ambient_ramp = 0;
-      view *v;
-      for (v = first_view; v; v = v->next)
-        v->update_scroll();
+      // Interpolated drawing blends each view between its last two ticks,
+      // which a second scroll per tick would make the same position.
+      if (!interpolate_draw)
+      {
+        view *v;
+        for (v = first_view; v; v = v->next)
+          v->update_scroll();
+      }
 
       cache.prof_poll_start();
       current_level->tick();
@@ -2339,10 +2362,28 @@ int main(int argc, char *argv[])
   start_argc = argc;
   start_argv = argv;
 
+  char const *verify_dir = NULL, *export_name = NULL, *export_output = NULL;
   for (int i = 0; i < argc; i++)
   {
     if (!strcmp(argv[i], "-cprint"))
       external_print = 1;
+
+    // No window and no sound, so that build machines can run it
+    if (!strcmp(argv[i], "-verify_demos") && i + 1 < argc)
+    {
+      verify_dir = argv[i + 1];
+      SDL_setenv("SDL_VIDEODRIVER", "dummy", 1);
+      SDL_setenv("SDL_AUDIODRIVER", "dummy", 1);
+    }
+    if (!strcmp(argv[i], "-export_demo") && i + 2 < argc)
+    {
+      export_name = argv[i + 1];
+      export_output = argv[i + 2];
+      if (!strcmp(export_output, "-"))
+        framedump_take_stdout();
+      SDL_setenv("SDL_VIDEODRIVER", "dummy", 1);
+      SDL_setenv("SDL_AUDIODRIVER", "dummy", 1);
+    }
   }
 
   set_dprinter(game_printer);
@@ -2350,6 +2391,7 @@ int main(int argc, char *argv[])
   set_no_space_handler(handle_no_space);
 
   setup(argc, argv);
+  interpolate_draw = settings.interpolate;
 
   show_startup();
 
@@ -2385,6 +2427,19 @@ int main(int argc, char *argv[])
     dev_cont = new dev_controll();
     dev_cont->load_stuff();
 
+    if (verify_dir)
+    {
+      int failed = verify_demos(verify_dir);
+      sound_uninit();
+      exit(failed ? 1 : 0);
+    }
+    if (export_name)
+    {
+      int ok = export_demo(export_name, export_output);
+      sound_uninit();
+      exit(ok ? 0 : 1);
+    }
+
     for (int i = 1; i + 1 < argc; i++)
     {
       if (!strcmp(argv[i], "-server"))
@@ -2403,23 +2458,37 @@ int main(int argc, char *argv[])
 
     net_send(1);
 
-    static Uint32 last_tick_start = SDL_GetTicks();
-    static Uint32 last_physics_tick_time = SDL_GetTicks();
+    // Fixed timestep: the simulation always advances in whole ticks of
+    // settings.physics_update ms so it stays deterministic (demos and
+    // network play depend on this), while the screen is redrawn as often
+    // as frame_rate allows. Leftover time is carried to the next frame and
+    // used to interpolate drawing between the last two ticks.
+    Uint32 tick_ms = Max(1, net_tick_ms(settings.physics_update));
+    const Uint32 frame_ms = settings.frame_rate > 0 ? 1000 / settings.frame_rate : 0;
 
-    const float target_frame_duration_ms = 1000.0f / 60.0f;
+    Uint32 last_frame_start = SDL_GetTicks();
+    Uint32 tick_accumulator = tick_ms; // run the first tick right away
 
     while (!g->done())
     {
-      Uint32 tick_start = SDL_GetTicks();
-      Uint32 frame_duration_ms = tick_start - last_tick_start; // Calculate time since last frame
+      Uint32 frame_start = SDL_GetTicks();
+      Uint32 frame_duration_ms = frame_start - last_frame_start;
 
-      if (frame_duration_ms < target_frame_duration_ms && !g->no_delay)
+      if (frame_duration_ms < frame_ms && !g->no_delay)
       {
-        SDL_Delay(target_frame_duration_ms - frame_duration_ms);
+        SDL_Delay(frame_ms - frame_duration_ms);
         continue;
       }
+      last_frame_start = frame_start;
+
+      // In a network game the server decides how long a tick is
+      tick_ms = Max(1, net_tick_ms(settings.physics_update));
 
       music_check();
+      level_save_poll();
+
+      if (demo_man.current_state() == demo_manager::PLAYING)
+        demo_man.playback_keys();
 
       if (req_end)
       {
@@ -2438,13 +2507,12 @@ int main(int argc, char *argv[])
         g->load_level(req_name);
         req_name[0] = 0;
         g->draw(g->state == SCENE_STATE);
+        // don't try to catch up on the time spent loading
+        tick_accumulator = tick_ms;
+        frame_duration_ms = 0;
       }
 
-      Uint32 current_tick = SDL_GetTicks();
-      Uint32 physics_frame_time = current_tick - last_physics_tick_time;
-      bool physics_step = physics_frame_time >= settings.physics_update || g->no_delay; // if enough time has passed, we should do a physics step
-
-      if (physics_frame_time > 100)
+      if (frame_duration_ms > 100)
       {
         // Frame panic detection - tracks loops that take too long (>100ms).
         // Increments panic counters that trigger automatic disabling of CPU-intensive
@@ -2459,13 +2527,16 @@ int main(int argc, char *argv[])
           massive_frame_panic--;
       }
 
-      if (physics_step)
-      {
-        if (demo_man.current_state() == demo_manager::NORMAL)
-        {
-          net_receive();
-        }
-      }
+      // Never queue up more than a few ticks, otherwise a slow frame makes
+      // the next one slower still while the game tries to catch up.
+      tick_accumulator = Min(tick_accumulator + frame_duration_ms,
+                             tick_ms * MAX_TICKS_PER_FRAME);
+
+      bool physics_step = tick_accumulator >= tick_ms || g->no_delay;
+      if (demo_man.paused())
+        physics_step = demo_man.take_step();
+      else if (demo_man.fast_forwarding())
+        physics_step = true;
 
       // TEMPORARY FIX FOR HIGH-FRAMERATE MULTIPLAYER COMPATIBILITY
       // Certain inputs (e.g., pressing SPACEBAR to reset after death) modify the game's underlying state.
@@ -2473,12 +2544,20 @@ int main(int argc, char *argv[])
       // processes it correctly. It might have some second-order effects I don't understand yet.
       //
       // Optimally, we would separate mouse input and rendering from game steps and networking.
-      if (g->first_view->m_focus->aistate() == 3 || physics_step)
+      if (!physics_step && g->first_view->m_focus->aistate() == 3)
         if (demo_man.current_state() != demo_manager::PLAYING)
           g->get_input();
 
-      if (physics_step)
+      while (physics_step)
       {
+        if (demo_man.current_state() == demo_manager::NORMAL)
+        {
+          net_receive();
+        }
+
+        if (demo_man.current_state() != demo_manager::PLAYING)
+          g->get_input();
+
         if (demo_man.current_state() == demo_manager::NORMAL)
         {
           net_send();
@@ -2493,18 +2572,50 @@ int main(int argc, char *argv[])
         // process all the objects in the world
         g->step();
 
-        last_physics_tick_time = tick_start;
+        if (g->no_delay || demo_man.paused())
+        {
+          tick_accumulator = 0;
+          break;
+        }
+
+        // Demo fast forward: tick for most of a frame, then draw once
+        if (demo_man.fast_forwarding())
+        {
+          tick_accumulator = 0;
+          physics_step = SDL_GetTicks() - frame_start < DEMO_FAST_MS
+                         && !req_name[0] && !req_end && !g->done();
+          continue;
+        }
+        // Fast forward may have ended during this tick and left nothing
+        // accumulated; the Uint32 must not wrap below zero.
+        if (tick_accumulator < tick_ms)
+        {
+          tick_accumulator = 0;
+          break;
+        }
+        tick_accumulator -= tick_ms;
+
+        // a level load or exit request has to be handled before ticking on
+        physics_step = tick_accumulator >= tick_ms && !req_name[0] && !req_end && !g->done();
       }
 
+      // Objects only move while the level is being ticked; anything else
+      // is drawn exactly where it is.
+      if (g->state == RUN_STATE && !(dev & EDIT_MODE) && !g->no_delay
+          && !demo_man.fast_forwarding() && !demo_man.paused())
+        // the catch-up loop can stop early with more than a tick left over
+        g->frame_alpha = Max(0, Min(256, (int)(tick_accumulator * 256 / tick_ms)));
+      else
+        g->frame_alpha = 256;
+
       // see if a request for a level load was made during the last tick
-      if (!req_name[0])
+      if (!req_name[0] && !demo_man.seeking())
         g->update_screen(); // redraw the screen with any changes
-      
-      avg_ms = (avg_ms * 0.9f) + (frame_duration_ms * 0.1f);
 
-      last_tick_start = tick_start;
+      avg_ms = (avg_ms * 0.9f) + (frame_duration_ms * 0.1f);
     }
 
+    level_save_wait();
     net_uninit();
 
     if (net_crcs)
@@ -2560,6 +2671,7 @@ int main(int argc, char *argv[])
         printf("%s\n", lstring_value(end_msg->GetValue()));
     }
 
+    sampler_stop(); // before the symbols it refers to go away
     Lisp::Uninit();
 
     base->packet.packet_reset();
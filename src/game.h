@@ -96,6 +96,7 @@ public :
 	JCFont *ar_small_font;	//AR
 	JCFont *ar_big_font;	//AR
   int no_delay;
+  int frame_alpha;  // time since the last tick in 1/256ths of a tick, for interpolated drawing
 
   int key_down(int key) { return keymap[key/8]&(1<<(key%8)); }
   //AR x=1 -> key pressed, x=0 key released
@@ -165,7 +166,7 @@ public :
   void set_state(int new_state);
   int game_over();
   void grow_views(int amount);
-  void play_sound(int id, int vol, int32_t x, int32_t y);
+  void play_sound(int id, int vol, int32_t x, int32_t y, int pitch = 128);
   void request_level_load(char *name);
   void request_level_load(std::string name);//AR
   void request_end();
@@ -117,7 +117,6 @@ void Filter::PutImage(image *screen, image *im, ivec2 pos)
 
 ColorFilter::ColorFilter(palette *pal, int color_bits)
 {
-    int max = pal->pal_size();
     int mul = 1 << (8 - color_bits);
     m_size = 1 << color_bits;
     m_table = (uint8_t *)malloc(m_size * m_size * m_size);
@@ -127,23 +126,7 @@ ColorFilter::ColorFilter(palette *pal, int color_bits)
     for (int g = 0; g < m_size; g++)
     for (int b = 0; b < m_size; b++)
     {
-        int best = 256 * 256 * 3;
-        int color = 0;
-        uint8_t *pp = (uint8_t *)pal->addr();
-
-        for (int i = 0; i < max; i++)
-        {
-            int rd = *pp++ - r * mul,
-                gd = *pp++ - g * mul,
-                bd = *pp++ - b * mul;
-
-            int dist = rd * rd + bd * bd + gd * gd;
-            if (dist < best)
-            {
-                best = dist;
-                color = i;
-            }
-        }
+        int color = pal->find_closest(r * mul, g * mul, b * mul);
         m_table[(r * m_size + g) * m_size + b] = color;
     }
 }
@@ -158,6 +141,7 @@ ColorFilter::ColorFilter(spec_entry *e, bFILE *fp)
 
 ColorFilter::~ColorFilter()
 {
+    BlendTable::Forget(this);
     free(m_table);
 }
 
@@ -173,3 +157,59 @@ int ColorFilter::Write(bFILE *fp)
     return fp->write(m_table, bytes) == bytes;
 }
 
+
+// Fades use only a handful of distinct amounts (usually n/16), so a small
+// cache covers them. All tables are dropped when the palette changes.
+#define BLEND_CACHE_SIZE 32
+
+static BlendTable *blend_cache[BLEND_CACHE_SIZE];
+static int blend_cache_next = 0;
+static uint8_t blend_palette[256 * 3];
+
+BlendTable *BlendTable::Get(ColorFilter *f, palette *pal, int amount)
+{
+    size_t pal_bytes = Min(pal->pal_size(), 256) * 3;
+    if (memcmp(blend_palette, pal->addr(), pal_bytes))
+    {
+        memcpy(blend_palette, pal->addr(), pal_bytes);
+        for (int i = 0; i < BLEND_CACHE_SIZE; i++)
+            if (blend_cache[i])
+                blend_cache[i]->m_filter = NULL;
+    }
+
+    for (int i = 0; i < BLEND_CACHE_SIZE; i++)
+        if (blend_cache[i] && blend_cache[i]->m_filter == f
+             && blend_cache[i]->m_amount == amount)
+            return blend_cache[i];
+
+    BlendTable *t = blend_cache[blend_cache_next];
+    if (!t)
+        t = blend_cache[blend_cache_next] = new BlendTable;
+    blend_cache_next = (blend_cache_next + 1) % BLEND_CACHE_SIZE;
+
+    t->m_filter = f;
+    t->m_amount = amount;
+    memset(t->m_done, 0, sizeof(t->m_done));
+    return t;
+}
+
+void BlendTable::Forget(ColorFilter *f)
+{
+    for (int i = 0; i < BLEND_CACHE_SIZE; i++)
+        if (blend_cache[i] && blend_cache[i]->m_filter == f)
+            blend_cache[i]->m_filter = NULL;
+}
+
+void BlendTable::Fill(int bg, int fg)
+{
+    uint8_t *p1 = blend_palette + 3 * bg;
+    uint8_t *p2 = blend_palette + 3 * fg;
+
+    uint8_t r = ((((int)p1[0] - p2[0]) * m_amount) >> 16) + p2[0];
+    uint8_t g = ((((int)p1[1] - p2[1]) * m_amount) >> 16) + p2[1];
+    uint8_t b = ((((int)p1[2] - p2[2]) * m_amount) >> 16) + p2[2];
+
+    int i = (bg << 8) | fg;
+    m_table[i] = m_filter->Lookup(r >> 3, g >> 3, b >> 3);
+    m_done[i >> 3] |= 1 << (i & 7);
+}
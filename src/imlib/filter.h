@@ -55,4 +55,32 @@ private:
     uint8_t *m_table;
 };
 
+// Colour mixing table for one blend amount: maps a (background, foreground)
+// pair of palette entries to the entry a ColorFilter gives for their mix.
+// Tables are shared by all fades with the same palette, filter and amount,
+// and each entry is only computed the first time it is needed.
+class BlendTable
+{
+public:
+    // amount is the background weight in 16.16 fixed point
+    static BlendTable *Get(ColorFilter *f, palette *pal, int amount);
+    static void Forget(ColorFilter *f);
+
+    inline uint8_t Mix(int bg, int fg)
+    {
+        int i = (bg << 8) | fg;
+        if (!(m_done[i >> 3] & (1 << (i & 7))))
+            Fill(bg, fg);
+        return m_table[i];
+    }
+
+private:
+    void Fill(int bg, int fg);
+
+    ColorFilter *m_filter;
+    int m_amount;
+    uint8_t m_table[256 * 256];
+    uint8_t m_done[256 * 256 / 8];
+};
+
 #endif
\ No newline at end of file
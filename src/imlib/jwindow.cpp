@@ -22,6 +22,7 @@
 #include "event.h"
 #include "filter.h"
 #include "jwindow.h"
+#include "sampler.h"
 
 static int jw_left = 3, jw_right = 3, jw_top = 2, jw_bottom = 3;
 
@@ -307,6 +308,7 @@ Jwindow * WindowManager::CreateWindow(ivec2 pos, ivec2 size,
 
 void WindowManager::flush_screen()
 {
+    SampleScope sample(SAMPLE_FLUSH);
     ivec2 m1(0, 0);
  
     if (has_mouse())
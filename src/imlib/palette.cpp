@@ -31,6 +31,7 @@ palette::palette(bFILE *fp)
   set_all_unused();
   fp->read(pal,sizeof(color)*ncolors);
   bg=0;
+  cindex=NULL;
 }
 
 palette::palette(spec_entry *e, bFILE *fp)
@@ -42,6 +43,7 @@ palette::palette(spec_entry *e, bFILE *fp)
   set_all_unused();
   fp->read(pal,sizeof(color)*ncolors);
   bg=0;
+  cindex=NULL;
 }
 
 int palette::size()
@@ -55,19 +57,112 @@ int palette::write(bFILE *fp)
   return fp->write(pal,sizeof(color)*ncolors)==ncolors;
 }
 
+// Nearest colour index: the palette entries sorted along the colour axis
+// with the widest spread. A search starts where the query falls on that
+// axis and walks outwards, stopping on each side once the distance along
+// the axis alone is worse than the best match so far. Palettes are often
+// modified in place through addr(), so the index keeps a copy of the
+// colours it was built from and is rebuilt whenever they differ.
+struct color_index
+{
+  color built_from[256];
+  int ncolors,axis;
+  uint8_t key[256];             // axis value of each entry, ascending
+  uint8_t entry[256];           // palette index of each key
+};
+
+static void build_color_index(color_index *ci, color const *pal, int ncolors)
+{
+  memcpy(ci->built_from,pal,sizeof(color)*ncolors);
+  ci->ncolors=ncolors;
+
+  int lo[3]={ 255,255,255 },hi[3]={ 0,0,0 };
+  for (int i=0; i<ncolors; i++)
+  {
+    uint8_t const *c=&pal[i].red;
+    for (int k=0; k<3; k++)
+    {
+      lo[k]=Min(lo[k],(int)c[k]);
+      hi[k]=Max(hi[k],(int)c[k]);
+    }
+  }
+  ci->axis=0;
+  for (int k=1; k<3; k++)
+    if (hi[k]-lo[k]>hi[ci->axis]-lo[ci->axis])
+      ci->axis=k;
+
+  // counting sort keeps equal keys in palette order
+  int count[257];
+  memset(count,0,sizeof(count));
+  for (int i=0; i<ncolors; i++)
+    count[(&pal[i].red)[ci->axis]+1]++;
+  for (int v=0; v<256; v++)
+    count[v+1]+=count[v];
+  for (int i=0; i<ncolors; i++)
+  {
+    int v=(&pal[i].red)[ci->axis];
+    ci->key[count[v]]=v;
+    ci->entry[count[v]++]=i;
+  }
+}
+
 int palette::find_closest(uint8_t r, uint8_t g, uint8_t b)
 {
-   unsigned char *cl=(unsigned char *)addr();
-   int c=0,d=0x100000,i,nd;
-   for (i=0; i<256; i++)
-   {
-     nd=((int)r-(int)(*cl))*((int)r-(int)(*cl)); cl++;
-     nd+=((int)g-(int)(*cl))*((int)g-(int)(*cl)); cl++;
-     nd+=((int)b-(int)(*cl))*((int)b-(int)(*cl)); cl++;
-     if (nd<d)
-     { c=i; d=nd; }
-   }
-   return c;
+  int n=Min((int)ncolors,256);
+  if (!cindex)
+  {
+    cindex=new color_index;
+    build_color_index(cindex,pal,n);
+  } else if (cindex->ncolors!=n || memcmp(cindex->built_from,pal,sizeof(color)*n))
+    build_color_index(cindex,pal,n);
+
+  int q[3]={ r,g,b };
+  int qa=q[cindex->axis];
+
+  // first entry whose key is >= the query
+  int up=0,top=n;
+  while (up<top)
+  {
+    int mid=(up+top)/2;
+    if (cindex->key[mid]<qa)
+      up=mid+1;
+    else top=mid;
+  }
+  int down=up-1;
+
+  // Same result as a linear scan: on equal distance the lowest palette
+  // index wins, so only stop once the axis distance is strictly worse.
+  int c=0,d=0x100000;
+  while (up<n || down>=0)
+  {
+    int i;
+    if (down<0 || (up<n && cindex->key[up]-qa<=qa-cindex->key[down]))
+    {
+      int ad=cindex->key[up]-qa;
+      if (ad*ad>d)
+      {
+        up=n;
+        continue;
+      }
+      i=cindex->entry[up++];
+    } else
+    {
+      int ad=qa-cindex->key[down];
+      if (ad*ad>d)
+      {
+        down=-1;
+        continue;
+      }
+      i=cindex->entry[down--];
+    }
+
+    int nd=(r-(int)pal[i].red)*(r-(int)pal[i].red)
+          +(g-(int)pal[i].green)*(g-(int)pal[i].green)
+          +(b-(int)pal[i].blue)*(b-(int)pal[i].blue);
+    if (nd<d || (nd==d && i<c))
+    { c=i; d=nd; }
+  }
+  return c;
 }
 
 int palette::find_color(uint8_t r, uint8_t g, uint8_t b)
@@ -247,6 +342,7 @@ void palette::get(int x, unsigned char &red, unsigned char &green, unsigned char
 palette::~palette()
 { if (pal) free(pal);
   if (usd) free(usd);
+  delete cindex;
 }
 
 palette::palette(int number_colors)
@@ -256,6 +352,7 @@ palette::palette(int number_colors)
   bg=0;
   pal=(color *)malloc(ncolors*3);
   usd=(unsigned char *)malloc(ncolors/8+1);
+  cindex=NULL;
   defaults();
 }
 
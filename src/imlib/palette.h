@@ -25,12 +25,15 @@ struct color
   unsigned char red,green,blue;
 } ;
 
+struct color_index;
+
 class palette : public linked_node
 {
   color *pal;
   unsigned char *usd;           // bit array
   short ncolors;
   int bg;
+  color_index *cindex;          // built by find_closest, NULL until then
 public :
   palette(int number_colors=256);
   palette(spec_entry *e, bFILE *fp);
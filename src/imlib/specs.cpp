@@ -439,6 +439,67 @@ int jFILE::unbuffered_write(void const *buf, size_t count)
     return ret;
 }
 
+mem_file::mem_file()
+{
+  buf=NULL;
+  size=alloc=offset=0;
+}
+
+mem_file::~mem_file()
+{
+  flush_writes();
+  free(buf);
+}
+
+int mem_file::unbuffered_read(void *b, size_t count)
+{
+  if ((long)count>size-offset) count=size-offset;
+  memcpy(b,buf+offset,count);
+  offset+=count;
+  return count;
+}
+
+int mem_file::unbuffered_write(void const *b, size_t count)
+{
+  if (offset+(long)count>alloc)
+  {
+    long new_alloc=alloc ? alloc : 0x10000;
+    while (new_alloc<offset+(long)count) new_alloc*=2;
+    uint8_t *nb=(uint8_t *)realloc(buf,new_alloc);
+    if (!nb) return 0;
+    buf=nb;
+    alloc=new_alloc;
+  }
+  memcpy(buf+offset,b,count);
+  offset+=count;
+  if (offset>size) size=offset;
+  return count;
+}
+
+int mem_file::unbuffered_seek(long off, int whence)
+{
+  flush_writes();
+  switch (whence)
+  {
+    case SEEK_SET : offset=off; break;
+    case SEEK_CUR : offset+=off; break;
+    case SEEK_END : offset=size-off; break;
+  }
+  if (offset<0) offset=0;
+  if (offset>size) offset=size;
+  return 0;
+}
+
+uint8_t *mem_file::take(long &data_size)
+{
+  flush_writes();
+  uint8_t *ret=buf;
+  data_size=size;
+  buf=NULL;
+  size=alloc=offset=0;
+  return ret;
+}
+
 int jFILE::unbuffered_seek(long offset, int whence) // whence=SEEK_SET, SEEK_CUR, SEEK_END, ret=0=success
 {
   long ret;
@@ -151,6 +151,23 @@ public :
   virtual ~jFILE();
 } ;
 
+class mem_file : public bFILE     // collects whatever is written to it in memory
+{
+  uint8_t *buf;
+  long size,alloc,offset;
+
+public :
+  mem_file();
+  virtual int open_failure() { return 0; }
+  virtual int unbuffered_read(void *buf, size_t count);
+  virtual int unbuffered_write(void const *buf, size_t count);
+  virtual int unbuffered_seek(long offset, int whence);
+  virtual int unbuffered_tell() { return offset; }
+  virtual int file_size() { return size; }
+  uint8_t *take(long &size);    // hands the data over, to be free()d by the caller
+  virtual ~mem_file();
+} ;
+
 class spec_entry
 {
 public:
@@ -164,7 +164,8 @@ void TransImage::PutImageGeneric(image *screen, ivec2 pos, uint8_t color,
     }
 
     uint8_t *datap = ClipToLine(screen, pos1, pos2, pos, ysteps),
-            *screen_line, *blend_line = NULL, *paddr = NULL;
+            *screen_line, *blend_line = NULL;
+    BlendTable *mix = NULL;
     if (!datap)
         return; // if ClipToLine says nothing to draw, return
 
@@ -172,14 +173,14 @@ void TransImage::PutImageGeneric(image *screen, ivec2 pos, uint8_t color,
                               && pos.y + ysteps <= bpos.y + blend->Size().y),
               "Blend doesn't fit on TransImage");
 
-    if (N == FADE || N == FADE_TINT || N == BLEND)
-        paddr = (uint8_t *)pal->addr();
-
     if (N == FADE || N == FADE_TINT)
         mul = (amount << 16) / nframes;
     else if (N == BLEND)
         mul = ((16 - amount) << 16 / 16);
 
+    if (N == FADE || N == FADE_TINT || N == BLEND)
+        mix = BlendTable::Get(f, pal, mul);
+
     if (N == PREDATOR)
         ysteps = Min(ysteps, pos2.y - 1 - pos.y - 2);
 
@@ -252,17 +253,8 @@ void TransImage::PutImageGeneric(image *screen, ivec2 pos, uint8_t color,
                 uint8_t *sl3 = datap;
 
                 while (count--)
-                {
-                    uint8_t *p1 = paddr + 3 * *sl2++;
-                    uint8_t *p2 = paddr + 3 * (N == FADE_TINT ? tint[*sl3++]
-                                                              : *sl3++);
-
-                    uint8_t r = ((((int)p1[0] - p2[0]) * mul) >> 16) + p2[0];
-                    uint8_t g = ((((int)p1[1] - p2[1]) * mul) >> 16) + p2[1];
-                    uint8_t b = ((((int)p1[2] - p2[2]) * mul) >> 16) + p2[2];
-
-                    *sl++ = f->Lookup(r >> 3, g >> 3, b >> 3);
-                }
+                    *sl++ = mix->Mix(*sl2++, N == FADE_TINT ? tint[*sl3++]
+                                                            : *sl3++);
             }
 
             datap += todo;
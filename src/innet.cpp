@@ -23,6 +23,7 @@
 #include "dev.h"
 #include "timing.h"
 #include "net/netface.h"
+#include "nfserver.h"
 
 #if HAVE_NETWORK
 #include "net/tcpip.h"
@@ -32,6 +33,7 @@
 #include "net/ghandler.h"
 #include "net/gserver.h"
 #include "net/gclient.h"
+#include "net/netstat.h"
 #include "dprint.h"
 #include "netcfg.h"
 
@@ -61,6 +63,26 @@ join_struct *join_array = NULL; // Array of joining clients
 extern char const *get_login();
 extern void set_login(char const *name);
 
+// Lockstep rounds: each net_send() sends the local input for one and each
+// net_receive() plays the game state of one. The input is sent
+// input_delay - 1 rounds ahead of the one played next so it has time to
+// reach everybody. The server picks the delay from the lag it measures
+// and announces it with SCMD_NET_TIMING, so all players change it on the
+// same round. Rounds restart from the level's tick counter when it is
+// reloaded from the server, so everybody agrees on their numbers.
+#define DELAY_RAISE_TICKS 15 // at most one step up per this many ticks
+#define DELAY_LOWER_TICKS 45 // ticks the lag has to stay low to step down
+#define GIVE_UP_TIME 600.0   // seconds before offering to drop the slow players
+
+static int net_tick = 0;         // round the engine plays next
+static int awaiting_tick = 0;    // its game state was asked for
+static int last_sent_tick = -1;
+static int input_delay = 1, next_input_delay = 1;
+static net_packet held_input;    // waits for the next round when the delay drops
+static int server_tick_ms = 0;   // tick length the server plays at
+static int announced_delay = 0, announced_tick_ms = 0; // server only
+static int delay_raise_wait = 0, delay_lower_ticks = 0;
+
 int net_init(int argc, char **argv)
 {
   DEBUG_LOG("Initializing network system");
@@ -666,7 +688,7 @@ void net_reload()
       current_level = new level(&sd, fp, NET_STARTFILE);
       delete fp;
 
-      base->current_tick = (current_level->tick_counter() & 0xff);
+      net_reset_ticks();
 
       reload_end();
     }
@@ -768,7 +790,77 @@ void net_reload()
       the_game->reset_keymap();
 
       base->input_state = INPUT_COLLECTING;
+      net_reset_ticks();
+    }
+  }
+}
+
+void net_reset_ticks()
+{
+  net_tick = current_level ? current_level->tick_counter() : 0;
+  base->current_tick = net_tick & 0xff;
+  awaiting_tick = 0;
+  last_sent_tick = -1;
+  input_delay = next_input_delay = 1;
+  held_input.packet_reset();
+  announced_delay = 0;
+  delay_raise_wait = delay_lower_ticks = 0;
+}
+
+void net_set_timing(int delay, int tick_ms)
+{
+  next_input_delay = Min(Max(delay, 1), NET_MAX_DELAY);
+  server_tick_ms = tick_ms;
+}
+
+int net_tick_ms(int local_ms)
+{
+  return prot && net_server && server_tick_ms > 0 ? server_tick_ms : local_ms;
+}
+
+int net_input_held()
+{
+  return prot && last_sent_tick >= 0 && net_tick + next_input_delay - 1 <= last_sent_tick;
+}
+
+// Called by the server before its input for a round is sent. Raises the
+// input delay as soon as a client's lag needs it, lowers it once the lag
+// has stayed low for a while, one tick at a time.
+void net_add_timing(int tick_ms)
+{
+  if (!prot || net_server || !game_face || game_face->total_players() < 2)
+    return;
+
+  // The last change has not been played yet
+  if (announced_delay && announced_delay != next_input_delay)
+    return;
+
+  int delay = next_input_delay;
+  int want = ((int)netstat_worst_lag() + tick_ms - 1) / Max(tick_ms, 1);
+
+  if (delay_raise_wait > 0)
+    delay_raise_wait--;
+
+  if (want > delay && delay < NET_MAX_DELAY && !delay_raise_wait)
+    delay++;
+  else if (want < delay && delay > 1 && ++delay_lower_ticks >= DELAY_LOWER_TICKS)
+    delay--;
+
+  if (want >= delay)
+    delay_lower_ticks = 0;
+
+  if (delay != announced_delay || tick_ms != announced_tick_ms)
+  {
+    if (announced_delay && delay != announced_delay)
+    {
+      delay_raise_wait = DELAY_RAISE_TICKS;
+      delay_lower_ticks = 0;
     }
+    base->packet.write_uint8(SCMD_NET_TIMING);
+    base->packet.write_uint8(delay);
+    base->packet.write_uint16(tick_ms);
+    announced_delay = delay;
+    announced_tick_ms = tick_ms;
   }
 }
 
@@ -777,13 +869,50 @@ int client_number()
   return local_client_number;
 }
 
+// Send the local input in base->packet for round net_tick + input_delay - 1.
+// When the delay went up, the rounds skipped get an empty input; when it
+// went down, or nothing was played since the last call, the input is held
+// back and goes with the next one.
+static void send_delayed_input()
+{
+  net_packet *pack = &base->packet;
+  int tick = net_tick + input_delay - 1;
+
+  if (last_sent_tick >= 0 && tick <= last_sent_tick)
+  {
+    held_input.add_to_packet(pack->packet_data(), pack->packet_size());
+    pack->packet_reset();
+    return;
+  }
+
+  for (int i = last_sent_tick + 1; last_sent_tick >= 0 && i < tick; i++)
+  {
+    held_input.set_tick_received(i & 0xff);
+    game_face->send_engine_input(&held_input);
+    held_input.packet_reset();
+  }
+
+  if (held_input.packet_size())
+  {
+    held_input.add_to_packet(pack->packet_data(), pack->packet_size());
+    *pack = held_input;
+    held_input.packet_reset();
+  }
+
+  pack->set_tick_received(tick & 0xff);
+  game_face->send_engine_input(pack);
+  last_sent_tick = tick;
+}
+
 void send_local_request()
 {
   if (prot)
   {
-    DEBUG_LOG("Sending local request, tick: %d", current_level ? current_level->tick_counter() & 0xff : 0);
-    if (current_level)
-      base->current_tick = (current_level->tick_counter() & 0xff);
+    DEBUG_LOG("Sending local request, tick: %d", net_tick & 0xff);
+    input_delay = next_input_delay;
+    base->current_tick = net_tick & 0xff;
+    send_delayed_input();
+    awaiting_tick = 1;
     game_face->add_engine_input();
   }
   else
@@ -806,10 +935,10 @@ void kill_slackers()
 
 int get_inputs_from_server(unsigned char *buf)
 {
+  double stall_ms = 0;
   if (prot && base->input_state != INPUT_PROCESSING)
   {
-    time_marker start;
-    int total_retry = 0;
+    time_marker start, stall_start;
     Jwindow *abort = NULL;
 
     while (base->input_state != INPUT_PROCESSING)
@@ -823,7 +952,7 @@ int get_inputs_from_server(unsigned char *buf)
       service_net_request();
       
       time_marker now;
-      if (now.diff_time(&start) > 0.05)
+      if (now.diff_time(&start) > netstat_resend_timeout())
       {
         DEBUG_LOG("Missed packet, requesting resend");
         if (prot->debug_level(net_protocol::DB_IMPORTANT_EVENT))
@@ -831,18 +960,17 @@ int get_inputs_from_server(unsigned char *buf)
 
         game_face->input_missing();
         start.get_time();
+      }
 
-        total_retry++;
-        if (total_retry == 12000)
-        {
-          DEBUG_LOG("Connection appears dead, showing abort dialog");
-          abort = wm->CreateWindow(ivec2(0, yres / 2), ivec2(-1, wm->font()->Size().y * 4),
-                                   new info_field(0, 0, 0, symbol_str("waiting"),
-                                                  new button(0, wm->font()->Size().y + 5, ID_NET_DISCONNECT,
-                                                             symbol_str("slack"), NULL)),
-                                   symbol_str("Error"));
-          wm->flush_screen();
-        }
+      if (!abort && now.diff_time(&stall_start) > GIVE_UP_TIME)
+      {
+        DEBUG_LOG("Connection appears dead, showing abort dialog");
+        abort = wm->CreateWindow(ivec2(0, yres / 2), ivec2(-1, wm->font()->Size().y * 4),
+                                 new info_field(0, 0, 0, symbol_str("waiting"),
+                                                new button(0, wm->font()->Size().y + 5, ID_NET_DISCONNECT,
+                                                           symbol_str("slack"), NULL)),
+                                 symbol_str("Error"));
+        wm->flush_screen();
       }
       if (abort)
       {
@@ -865,6 +993,9 @@ int get_inputs_from_server(unsigned char *buf)
       }
     }
 
+    time_marker now;
+    stall_ms = now.diff_time(&stall_start) * 1000.0;
+
     if (abort)
     {
       DEBUG_LOG("Cleaning up abort dialog");
@@ -873,8 +1004,16 @@ int get_inputs_from_server(unsigned char *buf)
     }
   }
 
+  if (prot)
+    netstat_end_tick(base->current_tick, stall_ms, input_delay);
+
+  if (awaiting_tick)
+  {
+    net_tick++;
+    awaiting_tick = 0;
+  }
+
   DEBUG_LOG("Processing received input packet");
-  memcpy(base->last_packet.data, base->packet.data, base->packet.packet_size() + base->packet.packet_prefix_size());
 
   int size = base->packet.packet_size();
   memcpy(buf, base->packet.packet_data(), size);
@@ -271,7 +271,35 @@ foretile::foretile(bFILE *fp)
 
   points=new boundary(fp,"foretile boundry");
 
+  segs=NULL;
+  nsegs=seg_tl=seg_th=0;
+}
+
+// Points on the tile's edges are pushed one pixel out, so that boundaries
+// of neighbouring tiles overlap and nothing slips between them
+#define remapx(x) (x==0 ? -1 : x==tl-1 ? tl+1 : x)
+#define remapy(y) (y==0 ? -1 : y==th-1 ? th+1 : y)
 
+void foretile::make_segments(int tl, int th)
+{
+  free(segs);
+  nsegs=points->tot>1 ? points->tot-1 : 0;
+  segs=(tile_segment *)malloc(sizeof(tile_segment)*(nsegs ? nsegs : 1));
+  seg_tl=tl;
+  seg_th=th;
+
+  unsigned char *bdat=points->data;
+  for (int j=0; j<nsegs; j++,bdat+=2)
+  {
+    tile_segment &s=segs[j];
+    s.x1=remapx(bdat[0]);
+    s.y1=remapy(bdat[1]);
+    s.x2=remapx(bdat[2]);
+    s.y2=remapy(bdat[3]);
+    s.minx=Min(s.x1,s.x2); s.maxx=Max(s.x1,s.x2);
+    s.miny=Min(s.y1,s.y2); s.maxy=Max(s.y1,s.y2);
+    s.inside=points->inside[j] ? 1 : -1;
+  }
 }
 
 size_t figure::MemUsage()
@@ -40,6 +40,14 @@ public :
   ~backtile() { delete im; }
 } ;
 
+// A boundary line of a foretile, in pixels from the tile's corner
+struct tile_segment
+{
+  int16_t x1,y1,x2,y2;
+  int16_t minx,miny,maxx,maxy;
+  int8_t inside;             // 1 or -1, as setback_intersect wants it
+} ;
+
 class foretile
 {
 public :
@@ -54,7 +62,20 @@ public :
 
   foretile(bFILE *fp);
   int32_t size() { return im->Size().x*im->Size().y+4+2+1+points->size(); }
-  ~foretile() { delete im; delete points; delete micro_image; }
+  ~foretile() { delete im; delete points; free(segs); delete micro_image; }
+
+  // The boundary as segments, built on first use for this tile size
+  tile_segment *segments(int tl, int th, int &total)
+  {
+    if (!segs || seg_tl!=tl || seg_th!=th) make_segments(tl,th);
+    total=nsegs;
+    return segs;
+  }
+
+private :
+  void make_segments(int tl, int th);
+  tile_segment *segs;
+  int nsegs,seg_tl,seg_th;
 } ;
 
 class figure
@@ -15,10 +15,14 @@
 #include <string.h>
 #include <limits.h>
 #include <time.h>
+#include <vector>
+
 #ifdef HAVE_UNISTD_H
 # include <unistd.h>
 #endif
 
+#include <SDL.h>
+
 #include "common.h"
 
 #include "light.h"
@@ -38,8 +42,16 @@
 #include "profile.h"
 #include "sbar.h"
 #include "cop.h"
+#include "drawlist.h"
 #include "nfserver.h"
 #include "lisp_gc.h"
+#include "sampler.h"
+#include "netcfg.h"
+#include "timing.h"
+#include "sdlport/setup.h"
+#include "file_utils.h"
+
+extern Settings settings;
 
 level *current_level;
 
@@ -84,6 +96,8 @@ void level::load_fail()
   if (Name)      free(Name);     Name=NULL;
 
   first_active=NULL;
+  grid.clear();
+  activated.clear();
   view *f=player_list;
   for (; f; f=f->next)
     if (f->m_focus)
@@ -175,6 +189,22 @@ void level::next_focus()
     }            */
 }
 
+// True while a demo is recorded or played, or in a network game: then
+// every run must tick exactly the same objects in exactly the same order.
+static int replayed_game()
+{
+  return demo_man.current_state()!=demo_manager::NORMAL
+         || (main_net_cfg && (main_net_cfg->state==net_configuration::SERVER ||
+                              main_net_cfg->state==net_configuration::CLIENT));
+}
+
+// Demos, network games and the editor keep the plain list walk that
+// they were recorded and tested with.
+static int grid_allowed()
+{
+  return settings.spatial_index && !(dev & EDIT_MODE) && !replayed_game();
+}
+
 void level::unactivate_all()
 {
   first_active=NULL;
@@ -184,10 +214,51 @@ void level::unactivate_all()
   block_total=0;
   all_block_total=0;
 
+  int was_grid=grid_mode;
+  grid_mode=grid_allowed();
+  if (!grid_mode || !was_grid)
+    grid.clear();
+  activated.clear();
+
+  // Anything may have been moved since the last tick, active or not, so
+  // every object is checked against the cell it was indexed in
   for (; o; o=o->next)
+  {
     o->active=0;
+    o->active_slot=-1;
+    if (grid_mode)
+      grid.update(o);
+  }
+}
+
+game_object *level::first_near(int32_t x1, int32_t y1, int32_t x2, int32_t y2)
+{
+  if (!grid_mode)
+    return first;
+
+  if (!grid.built())
+    grid.rebuild(first);
+  grid.query(x1,y1,x2,y2,near_list);
+  near_pos=0;
+  return next_near(NULL);
+}
+
+game_object *level::next_near(game_object *o)
+{
+  if (!grid_mode)
+    return o->next;
+  return near_pos<near_list.size() ? near_list[near_pos++] : NULL;
 }
 
+void level::set_active(game_object *o)
+{
+  o->active=1;
+  if (grid_mode)
+  {
+    o->active_slot=activated.size();
+    activated.push_back(o);
+  }
+}
 
 void level::pull_actives(game_object *o, game_object *&last_active, int &t)
 {
@@ -197,7 +268,7 @@ void level::pull_actives(game_object *o, game_object *&last_active, int &t)
     game_object *other=o->get_object(i-1);
     if (!other->active)
     {
-      other->active=1;
+      set_active(other);
       if (other->can_block())              // if object can block other player, keep a list for fast testing
       {
     add_block(other);
@@ -220,8 +291,8 @@ int level::add_actives(int32_t x1, int32_t y1, int32_t x2, int32_t y2)
   if (first_active)
     for (last_active=first_active; last_active->next_active; last_active=last_active->next_active);
 
-  game_object *o=first;
-  for (; o; o=o->next)
+  game_object *o=first_near(x1,y1,x2,y2);
+  for (; o; o=next_near(o))
   {
     if (!o->active)
     {
@@ -239,7 +310,7 @@ int level::add_actives(int32_t x1, int32_t y1, int32_t x2, int32_t y2)
           add_all_block(o);
 
 
-    o->active=1;
+    set_active(o);
     t++;
     if (!first_active)
       first_active=o;
@@ -266,8 +337,21 @@ int level::add_drawables(int32_t x1, int32_t y1, int32_t x2, int32_t y2)
     for (last_active=first_active; last_active->next_active; last_active=last_active->next_active);
   } else ft=1;
 
-  game_object *o=first;
-  for (; o; o=o->next)
+  if (ft && grid_mode)
+  {
+    // The objects out of range are those we will not visit: clear them
+    // all now, catching up with what moved during the tick
+    for (size_t i=0; i<activated.size(); i++)
+    {
+      activated[i]->active=0;
+      activated[i]->active_slot=-1;
+      grid.update(activated[i]);
+    }
+    activated.clear();
+  }
+
+  game_object *o=first_near(x1,y1,x2,y2);
+  for (; o; o=next_near(o))
   {
     if (ft || !o->active)
     {
@@ -282,7 +366,7 @@ int level::add_drawables(int32_t x1, int32_t y1, int32_t x2, int32_t y2)
     else
     last_active->next_active=o;
     last_active=o;
-    o->active=1;
+    set_active(o);
       } else if (ft) o->active=0;  // if this is the first pass, then mark objects not in this ranges as not active
     }
   }
@@ -579,41 +663,217 @@ game_object *level::all_boundary_setback(game_object *subject, int32_t x1, int32
 
 //bFILE *rcheck=NULL,*rcheck_lp=NULL;
 
-void level::interpolate_draw_objects(view *v)
+void level::interpolate_draw_objects(view *v, int alpha)
 {
-  int32_t old_x,old_y;
   current_view=v;
 
+  // Move every active object part of the way from where it stood at the
+  // previous tick to where it is now, draw, then put everything back so the
+  // simulation never sees the blended positions. Objects that jumped further
+  // than a warp distance are drawn where they are.
+  static std::vector<ivec2> saved;
+  saved.clear();
+
   game_object *o=first_active;
   for (; o; o=o->next_active)
   {
-    old_x=o->x;
-    old_y=o->y;
-    o->x=(o->last_x+o->x)/2;
-    o->y=(o->last_y+o->y)/2;
-    o->last_x=old_x;
-    o->last_y=old_y;
+    saved.push_back(ivec2(o->x,o->y));
+    int32_t dx=o->x-o->last_x,dy=o->y-o->last_y;
+    if (abs(dx)<INTERPOLATE_WARP && abs(dy)<INTERPOLATE_WARP)
+    {
+      o->x=o->last_x+dx*alpha/256;
+      o->y=o->last_y+dy*alpha/256;
+    }
   }
 
+  draw_list.Begin();
   for (o=first_active; o; o=o->next_active)
     o->draw();
 
-  for (o=first_active; o; o=o->next_active)
+  size_t i=0;
+  for (o=first_active; o && i<saved.size(); o=o->next_active,i++)
   {
-    o->x=o->last_x;
-    o->y=o->last_y;
+    o->x=saved[i].x;
+    o->y=saved[i].y;
   }
+
+  draw_list.End();
 }
 
 bFILE *rcheck=NULL,*rcheck_lp=NULL;
 
 extern int sshot_fcount,screen_shot_on;
 
+// Runs one active object for this tick and returns the one after it in the
+// active list. With batched set, the AI function is called without the
+// per object profiling, the caller times the whole batch instead.
+game_object *level::tick_object(game_object *o, int batched)
+{
+  game_object *cur=o,  // NULL if the object deletes itself
+              *next;
+  o->last_x=o->x;
+  o->last_y=o->y;
+  view *c=o->controller();
+  if (!(dev&SUSPEND_MODE) || c)
+  {
+    o->set_flags(o->flags()&(0xff-FLAG_JUST_HIT-FLAG_JUST_BLOCKED));
+
+    if (c)
+    {
+      area_controller *a,*smallest=NULL;
+      int32_t smallest_size=0xffffffff;
+      for (a=area_list; a; a=a->next)
+        if (o->x>=a->x && o->y>=a->y && o->x<=a->x+a->w && o->y<=a->y+a->h)
+        {
+          int32_t size=a->w*a->h;
+          if (size<smallest_size)
+          {
+            smallest=a;
+            smallest_size=size;
+          }
+        }
+
+      if (c->local_player())
+      {
+        if (!shutdown_lighting)       // should we initiate a lighting shutdown?
+        {
+          if (massive_frame_panic>30)
+          {
+            shutdown_lighting=100;
+            shutdown_lighting_value=c->ambient;
+          }
+        } else if (massive_frame_panic)  // do we need brighten towards 63?
+        {
+          if (shutdown_lighting_value<63)
+            shutdown_lighting_value++;
+        } else if (shutdown_lighting>1)        // delay for some time before turning back on
+          shutdown_lighting--;
+        else if (shutdown_lighting_value!=c->ambient) // do we need to lower light toward real ambient?
+        {
+          if (abs(shutdown_lighting_value-c->ambient)<4)
+            shutdown_lighting_value=c->ambient;
+          else
+            if (shutdown_lighting_value<c->ambient)
+                shutdown_lighting_value+=4;
+          else if (shutdown_lighting_value>c->ambient)
+            shutdown_lighting_value-=4;
+        } else shutdown_lighting=0;                    // back to normal
+      }
+
+      if (smallest)
+        c->configure_for_area(smallest);
+
+
+      o->move(c->x_suggestion,c->y_suggestion,c->b1_suggestion|(c->b2_suggestion<<1)|
+          (c->b3_suggestion<<2));
+
+      if (o->otype!=current_start_type)
+      {
+        int32_t fmp=o->fmp();
+        int reduce=figures[o->otype]->morph_power;
+        if (reduce)
+        {
+          fmp-=reduce;
+          o->add_power(fmp>>16);
+          o->set_fmp(fmp&0xffff);
+          if (o->mp()<=0)
+          o->morph_into(current_start_type,NULL,-1,9);
+        }
+      }
+
+      next=o->next_active;
+    }
+    else if (!(batched ? o->think((LSymbol *)figures[o->otype]->get_fun(OFUN_AI))
+                       : o->decide()))  // if object returns 0, delete it... I don't like 0's :)
+    {
+      next=o->next_active;
+      delete_object(o);
+      cur=NULL;
+    } else
+      next=o->next_active;
+  } else
+    next=o->next_active;
+
+  LSpace::Tmp.Clear();
+
+  if (cur)
+  {
+    point_list *p=cur->current_figure()->hit;  // see if this character is on an attack frame
+    if (p && p->tot)
+      add_attacker(cur);               // if so add him to attack list for later collision detect
+
+    if (cur->hurtable())                    // add to target list if is hurtable
+      add_target(cur);
+  }
+  return next;
+}
+
+// Batched mode runs all the active objects of one type back to back, so
+// the type's AI function and data stay in the caches and its time can be
+// measured once per batch. The order is still fixed: types in the order
+// their first object appears in the active list, then the objects of each
+// type in list order. It differs from the classic order though, so it is
+// never used while a demo is recorded or played, or in a network game
+// where every peer must think in exactly the same order.
+static int batch_ai_allowed()
+{
+  return settings.batch_ai && !replayed_game();
+}
+
+void level::tick_batched()
+{
+  static std::vector<game_object *> batch;
+  static std::vector<int> type_count, types;
+
+  type_count.assign(total_objects,0);
+  types.clear();
+  int n=0;
+  for (game_object *o=first_active; o; o=o->next_active,n++)
+    if (!type_count[o->otype]++)
+      types.push_back(o->otype);
+
+  // Turn the counts into the start of each type's batch
+  int start=0;
+  for (size_t i=0; i<types.size(); i++)
+  {
+    int t=type_count[types[i]];
+    type_count[types[i]]=start;
+    start+=t;
+  }
+  batch.resize(n);
+  for (game_object *o=first_active; o; o=o->next_active)
+    batch[type_count[o->otype]++]=o;
+
+  // Objects only ever delete themselves while ticking, so the batch
+  // never holds a pointer to an object already gone when we reach it.
+  // The batch is fixed here: an object spawned during this tick is not
+  // ticked until the next one. The classic loop does the same, since
+  // add_object() only puts new objects on the level list and they join
+  // the active list at the next add_actives(); if that ever changes,
+  // new objects must be appended to the batch to keep both orders alike.
+  int i=0;
+  for (size_t j=0; j<types.size(); j++)
+  {
+    int end=type_count[types[j]];
+    if (profiling())
+    {
+      time_marker start;
+      for (; i<end; i++)
+        tick_object(batch[i],1);
+      time_marker now;
+      profile_add_time(types[j],now.diff_time(&start));
+    }
+    else
+      for (; i<end; i++)
+        tick_object(batch[i],1);
+  }
+}
+
 int level::tick()
 {
-  game_object *o,*l=NULL,  // l is last, used for delete
-              *cur;        // cur is current object, NULL if object deletes it's self
+  game_object *o;
   int ret=1;
+  SampleScope sample(SAMPLE_TICK);
 
   if (profiling())
     profile_reset();
@@ -647,113 +907,12 @@ int level::tick()
     }
   }*/
 
-  for (o=first_active; o; )
-  {
-    o->last_x=o->x;
-    o->last_y=o->y;
-    cur=o;
-    view *c=o->controller();
-    if (!(dev&SUSPEND_MODE) || c)
-    {
-      o->set_flags(o->flags()&(0xff-FLAG_JUST_HIT-FLAG_JUST_BLOCKED));
-
-      if (c)
-      {
-    area_controller *a,*smallest=NULL;
-    int32_t smallest_size=0xffffffff;
-    for (a=area_list; a; a=a->next)
-      if (o->x>=a->x && o->y>=a->y && o->x<=a->x+a->w && o->y<=a->y+a->h)
-      {
-        int32_t size=a->w*a->h;
-        if (size<smallest_size)
-        {
-          smallest=a;
-          smallest_size=size;
-        }
-      }
-
-    if (c->local_player())
-    {
-      if (!shutdown_lighting)       // should we initiate a lighting shutdown?
-      {
-        if (massive_frame_panic>30)
-        {
-          shutdown_lighting=100;
-          shutdown_lighting_value=c->ambient;
-        }
-      } else if (massive_frame_panic)  // do we need brighten towards 63?
-      {
-        if (shutdown_lighting_value<63)
-          shutdown_lighting_value++;
-      } else if (shutdown_lighting>1)        // delay for some time before turning back on
-        shutdown_lighting--;
-      else if (shutdown_lighting_value!=c->ambient) // do we need to lower light toward real ambient?
-      {
-        if (abs(shutdown_lighting_value-c->ambient)<4)
-          shutdown_lighting_value=c->ambient;
-        else
-          if (shutdown_lighting_value<c->ambient)
-              shutdown_lighting_value+=4;
-        else if (shutdown_lighting_value>c->ambient)
-          shutdown_lighting_value-=4;
-      } else shutdown_lighting=0;                    // back to normal
-    }
-
-    if (smallest)
-      c->configure_for_area(smallest);
-
-
-    o->move(c->x_suggestion,c->y_suggestion,c->b1_suggestion|(c->b2_suggestion<<1)|
-        (c->b3_suggestion<<2));
-
-    if (o->otype!=current_start_type)
-    {
-      int32_t fmp=o->fmp();
-      int reduce=figures[o->otype]->morph_power;
-      if (reduce)
-      {
-        fmp-=reduce;
-        o->add_power(fmp>>16);
-        o->set_fmp(fmp&0xffff);
-        if (o->mp()<=0)
-        o->morph_into(current_start_type,NULL,-1,9);
-      }
-    }
-
-    l=o;
-    o=o->next_active;
-      }
-      else if (!o->decide())      // if object returns 0, delete it... I don't like 0's :)
-      {
-    game_object *p=o;
-    o=o->next_active;
-    delete_object(p);
-    cur=NULL;
-      } else
-      {
-    o=o->next_active;
-    l=o;
-      }
-    } else
-    {
-      o=o->next_active;
-      l=o;
-    }
-
-    LSpace::Tmp.Clear();
-
-    if (cur)
-    {
-      point_list *p=cur->current_figure()->hit;  // see if this character is on an attack frame
-      if (p && p->tot)
-        add_attacker(cur);               // if so add him to attack list for later collision detect
-
-      if (cur->hurtable())                    // add to target list if is hurtable
-        add_target(cur);
-
-    }
+  if (batch_ai_allowed())
+    tick_batched();
+  else
+    for (o=first_active; o; )
+      o=tick_object(o,0);
 
-  }
   tick_panims();
 
   check_collisions();
@@ -805,8 +964,11 @@ void level::draw_objects(view *v)
       o->map_draw();
   } else
   {
+    // Run every draw function first, then rasterise what they asked for
+    draw_list.Begin();
     for (; o; o=o->next_active)
       o->draw();
+    draw_list.End();
   }
 
   LSpace::Tmp.Clear();
@@ -1283,6 +1445,7 @@ level::level(spec_directory *sd, bFILE *fp, char const *lev_name)
   all_block_list=NULL;
   all_block_list_size=all_block_total=0;
   first_name=NULL;
+  grid_mode=0;
 
   the_game->need_refresh();
 
@@ -1532,7 +1695,7 @@ void level::level_loaded_notify()
 }
 
 
-bFILE *level::create_dir(char *filename, int save_all,
+int level::create_dir(bFILE *fp, int save_all,
              object_node *save_list, object_node *exclude_list)
 {
   spec_directory sd;
@@ -1647,7 +1810,7 @@ bFILE *level::create_dir(char *filename, int save_all,
 
   sd.calc_offsets();
 
-  return sd.write(filename);
+  return sd.write(fp);
 }
 
 void scale_put(image *im, image *screen, int x, int y, short new_width, short new_height);
@@ -2211,48 +2374,138 @@ void level::load_cache_info(spec_directory *sd, bFILE *fp)
 }
 
 
-int level::save(char const *filename, int save_all)
+// Saves are copied into memory on the game thread, which only takes a
+// moment, then written out and synced by save_writer on its own thread.
+struct save_job
 {
-	//AR clisp.case 223 saves the game in game
+    char name[255];
+    int backup;           // copy the old file to levsave.bak first
+    int backup_failed;    // reported by the game thread, dprintf isn't thread safe
+    uint8_t *data;
+    long size;
+    void (*done)(char const *filename, int ok);
+    SDL_atomic_t finished;
+    int ok;
+};
+
+static save_job *save_in_flight = NULL;
+static SDL_Thread *save_thread = NULL;
 
-    char name[255]; //, bkname[255];
+static int backup_file(char const *name)
+{
+    FILE *fp = prefix_fopen( name, "rb" );    // does file already exist?
+    if( !fp )
+        return 1;
 
-    sprintf( name, "%s", filename );
-    // sprintf( bkname, "%slevsave.bak", get_save_filename_prefix() );
-    if( !save_all && DEFINEDP( symbol_value( l_keep_backup ) ) &&
-        symbol_value( l_keep_backup ) )   // make a backup
+    FILE *bk = prefix_fopen( "levsave.bak", "wb" );
+    if( bk )
     {
-        bFILE *fp = open_file( name, "rb" );    // does file already exist?
-        if( !fp->open_failure() )
-        {
-            // unlink( bkname );
-            bFILE *bk = open_file("levsave.bak", "wb");
-            if( bk->open_failure() )
-              dprintf("unable to open backup file levsave.bak\n");
-            else
-            {
-                uint8_t buf[0x1000];
-                int32_t size = fp->file_size();
-                int tr = 1;
-                while( size && tr )
-                {
-                    int tr = fp->read(buf,0x1000);
-                    if( tr )
-                    tr = bk->write(buf,tr);
-                    size -= tr;
-                }
-            }
-            delete bk;
-        }
-        delete fp;
+        static uint8_t buf[0x10000];
+        size_t tr;
+        while( ( tr = fread( buf, 1, sizeof(buf), fp ) ) > 0 )
+            if( fwrite( buf, 1, tr, bk ) != tr )
+                break;
+        fclose( bk );
+    }
+    fclose( fp );
+    return bk != NULL;
+}
+
+static int save_writer(void *arg)
+{
+    save_job *job = (save_job *)arg;
+
+    if( job->backup )
+        job->backup_failed = !backup_file( job->name );
+
+    FILE *fp = prefix_fopen( job->name, "wb" );
+    int ok = fp != NULL;
+    if( fp )
+    {
+        ok = fwrite( job->data, 1, job->size, fp ) == (size_t)job->size;
+        ok = fflush( fp ) == 0 && ok;
+#ifdef WIN32
+        _commit( _fileno( fp ) );
+#else
+        fsync( fileno( fp ) );
+#endif
+        ok = fclose( fp ) == 0 && ok;
+#if (defined(__MACH__) || !defined(__APPLE__)) && (!defined(WIN32))
+        chmod( job->name, S_IRWXU | S_IRWXG | S_IRWXO );
+#endif
+    }
+
+    job->ok = ok;
+    SDL_AtomicSet( &job->finished, 1 );
+    return 0;
+}
+
+int level_save_wait()
+{
+    if( !save_in_flight )
+        return 1;
+
+    save_job *job = save_in_flight;
+    if( save_thread )
+        SDL_WaitThread( save_thread, NULL );
+    save_in_flight = NULL;
+    save_thread = NULL;
+
+    if( job->backup_failed )
+        dprintf("unable to open backup file levsave.bak\n");
+    if( !job->ok )
+        dprintf( "Failed to save game to file: '%s'\n", job->name );
+    int ok = job->ok;
+    if( job->done )
+        job->done( job->name, ok );
+
+    free( job->data );
+    delete job;
+    return ok;
+}
+
+void level_save_poll()
+{
+    if( save_in_flight && SDL_AtomicGet( &save_in_flight->finished ) )
+        level_save_wait();
+}
+
+static void write_map(bFILE *fp, uint16_t const *map, int t)
+{
+    uint16_t buf[1024];
+    while( t )
+    {
+        int n = t < 1024 ? t : 1024;
+        for( int i = 0; i < n; i++ )
+            buf[i] = lstl( map[i] );    // convert to intel endianess
+        fp->write( (char *)buf, 2 * n );
+        map += n;
+        t -= n;
     }
+}
+
+int level::save(char const *filename, int save_all, void (*done)(char const *filename, int ok))
+{
+	//AR clisp.case 223 saves the game in game
+
+    // one save at a time, so they land on disk in order
+    level_save_wait();
+
+    save_job *job = new save_job;
+    snprintf( job->name, sizeof(job->name), "%s", filename );
+    job->backup = !save_all && DEFINEDP( symbol_value( l_keep_backup ) ) &&
+                  symbol_value( l_keep_backup );   // make a backup
+    job->backup_failed = 0;
+    job->done = done;
+    job->ok = 0;
+    SDL_AtomicSet( &job->finished, 0 );
 
     // if we are not doing a savegame then change the first_name to this name
     if( !save_all )
     {
         if( first_name )
             free(first_name);
-        first_name = strdup(name);
+        first_name = strdup(job->name);
     }
 
     object_node *players, *objs;
@@ -2263,102 +2516,68 @@ int level::save(char const *filename, int save_all)
 
     objs = make_not_list(players);     // negate the above list
 
-    bFILE *fp = create_dir( name, save_all, objs, players);
-    if( fp != NULL )
+    mem_file *fp = new mem_file;
+    if( !create_dir( fp, save_all, objs, players) )
     {
-        if( !fp->open_failure() )
-        {
-            if( first_name )
-            {
-                fp->write_uint8( strlen( first_name ) + 1 );
-                fp->write( first_name, strlen( first_name ) + 1 );
-            }
-            else
-            {
-                fp->write_uint8( 1 );
-                fp->write_uint8( 0 );
-            }
+        the_game->show_help( "Unable to open file for saving.\n" );
+        delete fp;
+        delete job;
+        delete_object_list(players);
+        delete_object_list(objs);
+        return 0;
+    }
 
-            fp->write_uint32( fg_width );
-            fp->write_uint32( fg_height );
+    if( first_name )
+    {
+        fp->write_uint8( strlen( first_name ) + 1 );
+        fp->write( first_name, strlen( first_name ) + 1 );
+    }
+    else
+    {
+        fp->write_uint8( 1 );
+        fp->write_uint8( 0 );
+    }
 
-            int t  = fg_width * fg_height;
-            uint16_t *rm = map_fg;
-            for (; t; t--,rm++)
-            {
-                uint16_t x = *rm;
-                x = lstl(x);            // convert to intel endianess
-                *rm = x;
-            }
+    fp->write_uint32( fg_width );
+    fp->write_uint32( fg_height );
+    write_map( fp, map_fg, fg_width * fg_height );
 
-            fp->write( (char *)map_fg, 2 * fg_width * fg_height );
-            t = fg_width * fg_height;
-            rm = map_fg;
-            for (; t; t--,rm++)
-            {
-                uint16_t x = *rm;
-                x = lstl( x );            // convert to intel endianess
-                *rm = x;
-            }
+    fp->write_uint32( bg_width );
+    fp->write_uint32( bg_height );
+    write_map( fp, map_bg, bg_width * bg_height );
 
-            fp->write_uint32( bg_width );
-            fp->write_uint32( bg_height );
-            t = bg_width * bg_height;
-            rm = map_bg;
+    write_options( fp );
+    write_objects( fp, objs );
+    write_lights( fp );
+    write_links( fp, objs, players );
+    if( save_all )
+    {
+        write_player_info( fp, objs );
+        write_thumb_nail( fp,main_screen );
+    }
 
-            for (; t; t--,rm++)
-            {
-                uint16_t x=*rm;
-                x = lstl( x );        // convert to intel endianess
-                *rm = x;
-            }
+    job->data = fp->take( job->size );
+    delete fp;
 
-            fp->write( (char *)map_bg, 2 * bg_width * bg_height );
-            rm = map_bg;
-            t = bg_width*bg_height;
+    delete_object_list(players);
+    delete_object_list(objs);
 
-            for (; t; t--,rm++)
-            {
-                uint16_t x = *rm;
-                x = lstl( x );        // convert to intel endianess
-                *rm = x;
-            }
+    write_cache_prof_info();
 
-            write_options( fp );
-            write_objects( fp, objs );
-            write_lights( fp );
-            write_links( fp, objs, players );
-            if( save_all )
-            {
-                write_player_info( fp, objs );
-                write_thumb_nail( fp,main_screen );
-            }
+    save_in_flight = job;
+    if( done )
+        save_thread = SDL_CreateThread( save_writer, "level save", job );
+    if( !save_thread )
+        save_writer( job );    // no thread to spare, write it right here
 
-            delete fp;
-#if (defined(__MACH__) || !defined(__APPLE__)) && (!defined(WIN32))
-            chmod( name, S_IRWXU | S_IRWXG | S_IRWXO );
-#endif
-            write_cache_prof_info();
-        }
-        else
-        {
-            the_game->show_help( "Unable to open file for saving\n" );
-            delete fp;
-            return 0;
-        }
-    }
-    else
+    if( done )
+        return 1;
+
+    if( !level_save_wait() )
     {
-        the_game->show_help( "Unable to open file for saving.\n" );
-        printf( "\nFailed to save game.\n" );
-        printf( "I was trying to save to file: '%s'\n", filename );
-        printf( "\nPlease send an email to:\n\ttrandor@labyrinth.net.au\nwith these details.\nThanks.\n" );
+        the_game->show_help( "Unable to open file for saving\n" );
         return 0;
     }
-
-    delete_object_list(players);
-    delete_object_list(objs);
-
     return 1;
 }
 
@@ -2379,6 +2598,7 @@ level::level(int width, int height, char const *name)
 
   all_block_list=NULL;
   all_block_list_size=all_block_total=0;
+  grid_mode=0;
 
   Name=NULL;
   first_name=NULL;
@@ -2421,11 +2641,13 @@ void level::add_object(game_object *new_guy)
   new_guy->next=NULL;
   if (figures[new_guy->otype]->get_cflag(CFLAG_ADD_FRONT))
   {
+    game_object *prev=first ? last : NULL;
     if (!first)
       first=new_guy;
     else
       last->next=new_guy;
     last=new_guy;
+    grid.insert(new_guy,prev,NULL);
   } else
   {
     if (!first)
@@ -2435,7 +2657,9 @@ void level::add_object(game_object *new_guy)
       new_guy->next=first;
       first=new_guy;
     }
+    grid.insert(new_guy,NULL,new_guy->next);
   }
+  if (grid_mode) new_guy->active=0;
 }
 
 void level::add_object_after(game_object *new_guy,game_object *who)
@@ -2447,6 +2671,8 @@ void level::add_object_after(game_object *new_guy,game_object *who)
     if (who==last) last=new_guy;
     new_guy->next=who->next;
     who->next=new_guy;
+    grid.insert(new_guy,who,new_guy->next);
+    if (grid_mode) new_guy->active=0;
   }
 }
 
@@ -2513,6 +2739,16 @@ void level::remove_object(game_object *who)
   }
   total_objs--;
 
+  grid.remove(who);
+  size_t slot=who->active_slot;
+  if (slot<activated.size() && activated[slot]==who)
+  {
+    activated[slot]=activated.back();
+    activated[slot]->active_slot=slot;
+    activated.pop_back();
+  }
+  who->active_slot=-1;
+
 
   if (first_active==who)
     first_active=who->next_active;
@@ -2573,6 +2809,8 @@ void level::to_front(game_object *o)  // move to end of list, so we are drawn la
     w->next=o->next;
   }
 
+  grid.remove(o);
+  grid.insert(o,last,NULL);
   last->next=o;
   o->next=NULL;
   last=o;
@@ -2591,6 +2829,8 @@ void level::to_back(game_object *o)   // to make the character drawn in back, pu
   w->next=o->next;
   o->next=first;
   first=o;
+  grid.remove(o);
+  grid.insert(o,NULL,o->next);
 }
 
 
@@ -2614,8 +2854,23 @@ game_object *level::find_object(int32_t x, int32_t y)
 
 int32_t last_tile_hit_x,last_tile_hit_y;
 
-#define remapx(x) (x==0 ? -1 : x==tl-1 ? tl+1 : x)
-#define remapy(y) (y==0 ? -1 : y==th-1 ? th+1 : y)
+// Whether a boundary inside the box can set back the end of the segment.
+// setback_intersect only moves it on an actual crossing, which lies in both
+// boxes and on the segment's line, so the box must overlap the segment's
+// box and have corners on both sides of (or on) its line.
+static inline int may_setback(int32_t x1, int32_t y1, int32_t x2, int32_t y2,
+                              int32_t bx1, int32_t by1, int32_t bx2, int32_t by2)
+{
+  if (Min(x1,x2)>bx2 || Max(x1,x2)<bx1 || Min(y1,y2)>by2 || Max(y1,y2)<by1)
+    return 0;
+
+  int64_t a=y2-y1,b=x1-x2,c=(int64_t)x2*y1-(int64_t)x1*y2;
+  int64_t s1=a*bx1+b*by1+c,s2=a*bx2+b*by1+c,
+          s3=a*bx1+b*by2+c,s4=a*bx2+b*by2+c;
+  if ((s1>0 && s2>0 && s3>0 && s4>0) || (s1<0 && s2<0 && s3<0 && s4<0))
+    return 0;
+  return 1;
+}
 
 void level::foreground_intersect(int32_t x1, int32_t y1, int32_t &x2, int32_t &y2)
 {
@@ -2626,11 +2881,8 @@ void level::foreground_intersect(int32_t x1, int32_t y1, int32_t &x2, int32_t &y
 
   int32_t tl=the_game->ftile_width(),th=the_game->ftile_height(),
     j,
-    xp1,yp1,xp2,yp2,    // starting and ending points of block line segment
     swap;               // temp var
   int32_t blockx1,blocky1,blockx2,blocky2,block,bx,by;
-  point_list *block_list;
-  unsigned char *bdat;
 
   blockx1=x1;
   blocky1=y1;
@@ -2651,45 +2903,37 @@ void level::foreground_intersect(int32_t x1, int32_t y1, int32_t &x2, int32_t &y
 
   if ((blockx1>blockx2) || (blocky1>blocky2)) return ;
 
-  // now check all the map positions this line could intersect
+  // now check all the map positions this line could intersect, in the
+  // same order as always since each hit shortens the line for the next
   for (bx=blockx1; bx<=blockx2; bx++)
   {
     for (by=blocky1; by<=blocky2; by++)
     {
+      int32_t xo=bx*tl,yo=by*th;
+      // boundaries stick out of their tile by one pixel
+      if (!may_setback(x1,y1,x2,y2,xo-1,yo-1,xo+tl+1,yo+th+1))
+        continue;
+
       block=the_game->GetMapFg(ivec2(bx, by));
       if (block>BLACK)        // don't check BLACK, should be no points in it
       {
         // now check the all the line segments in the block
-        foretile *f=the_game->get_fg(block);
-        block_list=f->points;
-        unsigned char total=block_list->tot;
-        bdat=block_list->data;
-        unsigned char *ins=f->points->inside;
-    int32_t xo=bx*tl,yo=by*th;
-        for (j=0; j<total-1; j++,ins++)
+        int total;
+        tile_segment *seg=the_game->get_fg(block)->segments(tl,th,total);
+        for (j=0; j<total; j++,seg++)
         {
-          // find the starting and ending points for this segment
-      xp1=xo+remapx(*bdat);
-      bdat++;
-
-      yp1=yo+remapy(*bdat);
-      bdat++;
-
-      xp2=xo+remapx(*bdat);
-      yp2=yo+remapy(bdat[1]);
-
-
-      int32_t ox2=x2,oy2=y2;
-          if (*ins)
-            setback_intersect(x1,y1,x2,y2,xp1,yp1,xp2,yp2,1);
-          else
-            setback_intersect(x1,y1,x2,y2,xp1,yp1,xp2,yp2,-1);
-      if (ox2!=x2 || oy2!=y2)
-      {
-        last_tile_hit_x=bx;
-        last_tile_hit_y=by;
-      }
-
+          if (!may_setback(x1,y1,x2,y2,xo+seg->minx,yo+seg->miny,
+                           xo+seg->maxx,yo+seg->maxy))
+            continue;
+
+          int32_t ox2=x2,oy2=y2;
+          setback_intersect(x1,y1,x2,y2,xo+seg->x1,yo+seg->y1,
+                            xo+seg->x2,yo+seg->y2,seg->inside);
+          if (ox2!=x2 || oy2!=y2)
+          {
+            last_tile_hit_x=bx;
+            last_tile_hit_y=by;
+          }
         }
       }
     }
@@ -2700,11 +2944,8 @@ void level::foreground_intersect(int32_t x1, int32_t y1, int32_t &x2, int32_t &y
 void level::vforeground_intersect(int32_t x1, int32_t y1, int32_t &y2)
 {
   int32_t tl=f_wid,th=f_hi,
-    j,
-    xp1,yp1,xp2,yp2;    // starting and ending points of block line segment temp var
+    j;
   int32_t blocky1,blocky2,block,bx,by,checkx;
-  point_list *block_list;
-  unsigned char *bdat;
 
   int y_addback;
   if (y1>y2)
@@ -2733,32 +2974,19 @@ void level::vforeground_intersect(int32_t x1, int32_t y1, int32_t &y2)
     block=the_game->GetMapFg(ivec2(bx, by));
 
     // now check the all the line segments in the block
-    foretile *f=the_game->get_fg(block);
-    block_list=f->points;
-
-    unsigned char total=block_list->tot;
-    bdat=block_list->data;
-    unsigned char *ins=f->points->inside;
+    int total;
+    tile_segment *seg=the_game->get_fg(block)->segments(tl,th,total);
 
-//    int32_t xo=bx*tl,yo=by*th;
-    for (j=0; j<total-1; j++,ins++)
+    for (j=0; j<total; j++,seg++)
     {
-      // find the starting and ending points for this segment
-      xp1=remapx(*bdat);
-      bdat++;
-
-      yp1=remapy(*bdat);
-      bdat++;
-
-      xp2=remapx(*bdat);
-      yp2=remapy(bdat[1]);
-
+      // the line is vertical, only segments spanning its x can stop it
+      if (checkx<seg->minx || checkx>seg->maxx ||
+          Min(y1,y2)>seg->maxy || Max(y1,y2)<seg->miny)
+        continue;
 
       int32_t oy2=y2;
-      if (*ins)
-        setback_intersect(checkx,y1,checkx,y2,xp1,yp1,xp2,yp2,1);
-      else
-        setback_intersect(checkx,y1,checkx,y2,xp1,yp1,xp2,yp2,-1);
+      setback_intersect(checkx,y1,checkx,y2,seg->x1,seg->y1,seg->x2,seg->y2,
+                        seg->inside);
       if (oy2!=y2)
       {
     last_tile_hit_x=bx;
@@ -18,6 +18,7 @@
 #include "id.h"
 
 #include <stdlib.h>
+#include <vector>
 #define ASPECT 4             // foreground scrolls 4 times faster than background
 
 
@@ -28,6 +29,9 @@
 #define ACTIVE_RIGHT (280+500)
 #define ACTIVE_TOP 200
 #define ACTIVE_BOTTOM (180+200)
+
+// objects moving further than this in one tick are not interpolated
+#define INTERPOLATE_WARP 256
 #define fgvalue(y) ((y) & 0x3fff)
 #define above_tile(y) ((y) & 0x4000)
 #define bgvalue(y) (y)
@@ -74,6 +78,17 @@ class level        // contain map info and objects
   void add_all_block(game_object *who);
   uint32_t ctick;
 
+  // With settings.spatial_index, activation asks grid for the objects near
+  // each view. Every object with active set is then in activated, at its
+  // active_slot, so that drawing can clear the flags by visiting only those.
+  object_grid grid;
+  int grid_mode;
+  std::vector<game_object *> activated,near_list;
+  size_t near_pos;
+  game_object *first_near(int32_t x1, int32_t y1, int32_t x2, int32_t y2);
+  game_object *next_near(game_object *o);
+  void set_active(game_object *o);
+
 public :
   char *original_name() { if (first_name) return first_name; else return Name; }
   uint32_t tick_counter() { return ctick; }
@@ -96,7 +111,10 @@ public :
   level(spec_directory *sd, bFILE *fp, char const *lev_name);
   void load_fail();
   level(int width, int height, char const *name);
-  int save(char const *filename, int save_all);  // save_all includes player and view information (1 = success)
+  // save_all includes player and view information (1 = success). With a done
+  // callback the file is written in the background and save returns as soon
+  // as the level is copied; done is called from level_save_poll() later.
+  int save(char const *filename, int save_all, void (*done)(char const *filename, int ok) = NULL);
   void set_name(char const *name) { Name=strcpy((char *)realloc(Name,strlen(name)+1),name); }
   void set_size(int w, int h);
   void remove_light(light_source *which);
@@ -127,9 +145,11 @@ public :
   void PutFg(ivec2 pos, uint16_t tile) { *(map_fg+pos.x+pos.y*fg_width)=tile; }
   void PutBg(ivec2 pos, uint16_t tile) { *(map_bg+pos.x+pos.y*bg_width)=tile; }
   void draw_objects(view *v);
-  void interpolate_draw_objects(view *v);
+  void interpolate_draw_objects(view *v, int alpha);  // alpha in 1/256ths of a tick
   void draw_areas(view *v);
   int tick();                                // returns false if character is dead
+  game_object *tick_object(game_object *o, int batched);
+  void tick_batched();
   void check_collisions();
   void wall_push();
   void add_object(game_object *new_guy);
@@ -187,7 +207,7 @@ public :
   game_object *get_random_start(int min_player_dist, view *exclude);
 //  game_object *find_enemy(game_object *exclude1, game_object *exclude2);
 
-  bFILE *create_dir(char *filename, int save_all,
+  int create_dir(bFILE *fp, int save_all,
             object_node *save_list, object_node *exclude_list);
   view *make_view_list(int nplayers);
   int32_t total_light_links(object_node *list);
@@ -205,6 +225,8 @@ public :
 
 extern level *current_level;
 void pull_actives(game_object *o, game_object *&last_active, int &t);
+void level_save_poll();   // reports a background save once it is on disk
+int level_save_wait();    // waits for a background save, returns 1 if it worked
 
 
 
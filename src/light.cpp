@@ -26,6 +26,7 @@
 #include "filter.h"
 #include "status.h"
 #include "dev.h"
+#include "sampler.h"
 
 light_source *first_light_source = NULL;
 uint8_t *white_light, *white_light_initial, *green_light, *trans_table;
@@ -810,6 +811,7 @@ inline void put_8line(uint8_t *in_line, uint8_t *out_line, uint8_t *remap, uint8
 
 void light_screen(image *sc, int32_t screenx, int32_t screeny, uint8_t *light_lookup, uint16_t ambient)
 {
+  SampleScope sample(SAMPLE_LIGHTING);
   int lx_run = 0, ly_run; // light block x & y run size in pixels ==  (1<<lx_run)
 
   if (shutdown_lighting && !disable_autolight)
@@ -1000,6 +1002,7 @@ void light_screen(image *sc, int32_t screenx, int32_t screeny, uint8_t *light_lo
 void double_light_screen(image *sc, int32_t screenx, int32_t screeny, uint8_t *light_lookup, uint16_t ambient,
                          image *out, int32_t out_x, int32_t out_y)
 {
+  SampleScope sample(SAMPLE_LIGHTING);
   if (sc->Size().x * 2 + out_x > out->Size().x ||
       sc->Size().y * 2 + out_y > out->Size().y)
     return; // screen was resized and small_render has not changed size yet
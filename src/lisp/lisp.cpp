@@ -17,6 +17,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdarg.h>
+#include <map>
 
 #include "common.h"
 
@@ -24,6 +25,8 @@
 
 #include "lisp.h"
 #include "lisp_gc.h"
+#include "lisp_aot.h"
+#include "lisp_lex.h"
 #include "symbols.h"
 
 #include "status.h"
@@ -31,6 +34,7 @@
 #include "dprint.h"
 #include "cache.h"
 #include "dev.h"
+#include "sampler.h"
 
 /* To bypass the whole garbage collection issue of lisp I am going to have
  * separate spaces where lisp objects can reside.  Compiled code and gloabal
@@ -46,6 +50,7 @@ bFILE *current_print_file = NULL;
 
 LSymbol *LSymbol::root = NULL;
 size_t LSymbol::count = 0;
+uint32_t LSymbol::cache_epoch = 1;
 
 int print_level = 0, trace_level = 0, trace_print_level = 1000;
 int total_user_functions;
@@ -292,10 +297,24 @@ LObjectVar *LObjectVar::Create(int index)
     return p;
 }
 
+LLocalVar *LLocalVar::Create(LSymbol *name, int slot)
+{
+    size_t size = Max(sizeof(LLocalVar), sizeof(LRedirect));
+
+    LLocalVar *p = (LLocalVar *)LSpace::Current->Alloc(size);
+    p->m_type = L_LOCAL_VAR;
+    p->m_name = name;
+    p->m_slot = slot;
+    return p;
+}
+
 LPointer *LPointer::Create(void *addr)
 {
     if (addr == NULL)
         return NULL;
+    if (((intptr_t)addr & 3) == 0)
+        return (LPointer *)((intptr_t)addr | 2);
+
     size_t size = Max(sizeof(LPointer), sizeof(LRedirect));
 
     LPointer *p = (LPointer *)LSpace::Current->Alloc(size);
@@ -349,6 +368,12 @@ LUserFunction *new_lisp_user_function(LList *arg_list, LList *block_list)
     lu->m_type = L_USER_FUNCTION;
     lu->arg_list = arg_list;
     lu->block_list = block_list;
+    lu->native = NULL;
+    lu->forms = NULL;
+    lu->lex_block = NULL;
+    lu->lex_locals = NULL;
+    lu->lex_slots = 0;
+    lu->lex_epoch = 0;
     return lu;
 }
 
@@ -399,6 +424,9 @@ LSymbol *new_lisp_symbol(char *name)
     s->m_name = LString::Create(name);
     s->m_value = l_undefined;
     s->m_function = l_undefined;
+    s->m_cache_epoch = 0;
+    s->m_objvar = -1;
+    s->m_lex = 0;
 #ifdef L_PROFILE
     s->time_taken = 0;
 #endif
@@ -407,6 +435,9 @@ LSymbol *new_lisp_symbol(char *name)
 
 LNumber *LNumber::Create(long num)
 {
+    if (lisp_fixnum_fits(num))
+        return (LNumber *)(((uintptr_t)(intptr_t)num << 1) | 1);
+
     size_t size = Max(sizeof(LNumber), sizeof(LRedirect));
 
     LNumber *n = (LNumber *)LSpace::Current->Alloc(size);
@@ -473,11 +504,16 @@ void *lpointer_value(void *lpointer)
     exit(0);
   }
 #endif
+  if (lisp_pointerp(lpointer))
+    return lisp_pointer_value(lpointer);
   return ((LPointer *)lpointer)->m_addr;
 }
 
 int32_t lnumber_value(void *lnumber)
 {
+    if (lisp_fixnump(lnumber))
+        return lisp_fixnum_value(lnumber);
+
     switch (item_type(lnumber))
     {
     case L_NUMBER:
@@ -551,7 +587,7 @@ long lfixed_point_value(void *c)
   switch (item_type(c))
   {
     case L_NUMBER :
-      return ((LNumber *)c)->m_num<<16; break;
+      return LNumber::GetValue(c)<<16; break;
     case L_FIXED_POINT :
       return (((LFixedPoint *)c)->m_fixed); break;
     default :
@@ -569,10 +605,10 @@ void *lisp_eq(void *n1, void *n2)
   if (!n1 && !n2) return true_symbol;
   else if ((n1 && !n2) || (n2 && !n1)) return NULL;
   {
-    int t1=*((ltype *)n1), t2=*((ltype *)n2);
+    int t1=item_type(n1), t2=item_type(n2);
     if (t1!=t2) return NULL;
     else if (t1==L_NUMBER)
-    { if (((LNumber *)n1)->m_num==((LNumber *)n2)->m_num)
+    { if (LNumber::GetValue(n1)==LNumber::GetValue(n2))
         return true_symbol;
       else return NULL;
     } else if (t1==L_CHARACTER)
@@ -584,7 +620,7 @@ void *lisp_eq(void *n1, void *n2)
     else if (n1==n2)
       return true_symbol;
     else if (t1==L_POINTER)
-      if (n1==n2) return true_symbol;
+      if (lpointer_value(n1)==lpointer_value(n2)) return true_symbol;
   }
   return NULL;
 }
@@ -607,6 +643,22 @@ LObject *LArray::Get(int x)
     return m_data[x];
 }
 
+LObject *lisp_setq(LSymbol *sym, LObject *set_to)
+{
+    if (sym->m_objvar >= 0)
+    {
+        l_obj_set(sym->m_objvar, set_to);
+        return sym->m_value;
+    }
+
+    if (item_type(sym->m_value) == L_NUMBER && item_type(set_to) == L_NUMBER
+         && sym->m_value != l_undefined)
+        sym->SetNumber(lnumber_value(set_to));
+    else
+        sym->SetValue(set_to);
+    return sym->m_value;
+}
+
 void *lisp_equal(void *n1, void *n2)
 {
     if(!n1 && !n2) // if both nil, then equal
@@ -632,7 +684,7 @@ void *lisp_equal(void *n1, void *n2)
             return NULL;
           n1=CDR(n1);
           n2=CDR(n2);
-          if (n1 && *((ltype *)n1)!=L_CONS_CELL)
+          if (n1 && item_type(n1)!=L_CONS_CELL)
             return lisp_equal(n1, n2);
         }
         if (n1 || n2)
@@ -820,6 +872,9 @@ LSymbol *LSymbol::FindOrCreate(char const *name)
     // If constant, set the value to ourself
     p->m_value = (name[0] == ':') ? p : l_undefined;
     p->m_function = l_undefined;
+    p->m_cache_epoch = 0;
+    p->m_objvar = -1;
+    p->m_lex = 0;
 #ifdef L_PROFILE
     p->time_taken = 0;
 #endif
@@ -921,7 +976,11 @@ void *pairlis(void *list1, void *list2, void *list3)
 
 void LSymbol::SetFunction(LObject *function)
 {
+    // Compiled functions evaluate the builtins inline
+    if (item_type(m_function) == L_SYS_FUNCTION)
+        lisp_aot_disable();
     m_function = function;
+    cache_epoch++;
 }
 
 LSymbol *add_sys_function(char const *name, short min_args, short max_args, short number)
@@ -933,7 +992,7 @@ LSymbol *add_sys_function(char const *name, short min_args, short max_args, shor
     lbreak("add_sys_fucntion -> symbol %s already has a function\n", name);
     exit(0);
   }
-  else s->m_function=new_lisp_sys_function(min_args, max_args, number);
+  else s->SetFunction(new_lisp_sys_function(min_args, max_args, number));
   return s;
 }
 
@@ -946,7 +1005,7 @@ LSymbol *add_c_object(void *symbol, int index)
     lbreak("add_c_object -> symbol %s already has a value\n", lstring_value(s->GetName()));
     exit(0);
   }
-  else s->m_value=LObjectVar::Create(index);
+  else s->SetValue(LObjectVar::Create(index));
   return NULL;
 }
 
@@ -960,7 +1019,7 @@ LSymbol *add_c_function(char const *name, short min_args, short max_args, short
     lbreak("add_sys_fucntion -> symbol %s already has a function\n", name);
     exit(0);
   }
-  else s->m_function=new_lisp_c_function(min_args, max_args, number);
+  else s->SetFunction(new_lisp_c_function(min_args, max_args, number));
   return s;
 }
 
@@ -974,7 +1033,7 @@ LSymbol *add_c_bool_fun(char const *name, short min_args, short max_args, short
     lbreak("add_sys_fucntion -> symbol %s already has a function\n", name);
     exit(0);
   }
-  else s->m_function=new_lisp_c_bool(min_args, max_args, number);
+  else s->SetFunction(new_lisp_c_bool(min_args, max_args, number));
   return s;
 }
 
@@ -989,7 +1048,7 @@ LSymbol *add_lisp_function(char const *name, short min_args, short max_args, sho
     lbreak("add_sys_fucntion -> symbol %s already has a function\n", name);
     exit(0);
   }
-  else s->m_function=new_user_lisp_function(min_args, max_args, number);
+  else s->SetFunction(new_user_lisp_function(min_args, max_args, number));
   return s;
 }
 
@@ -1076,9 +1135,19 @@ void push_onto_list(void *object, void *&list)
 
 void *comp_optimize(void *list);
 
+// Nesting of Compile() calls, only whole top-level forms get scanned
+static int compile_depth = 0;
+
+struct CompileDepth
+{
+    CompileDepth() { compile_depth++; }
+    ~CompileDepth() { compile_depth--; }
+};
+
 LObject *LObject::Compile(char const *&code)
 {
     LObject *ret = NULL;
+    CompileDepth depth;
 
     if (!read_ltoken(code, n))
         lerror(NULL, "unexpected end of program");
@@ -1176,9 +1245,9 @@ LObject *LObject::Compile(char const *&code)
     lerror(code, "mismatched )");
   else if (isdigit(n[0]) || (n[0]=='-' && isdigit(n[1])))
   {
-    LNumber *num = LNumber::Create(0);
-    sscanf(n, "%ld", &num->m_num);
-    ret=num;
+    long num = 0;
+    sscanf(n, "%ld", &num);
+    ret = LNumber::Create(num);
   } else if (n[0]=='"')
   {
     ret = LString::Create(str_token_len(code));
@@ -1229,6 +1298,9 @@ LObject *LObject::Compile(char const *&code)
   } else {
     ret = LSymbol::FindOrCreate(n);
   }
+
+  if (compile_depth == 1 && lisp_lex_enabled)
+    lisp_lex_toplevel(ret);
   return ret;
 }
 
@@ -1295,7 +1367,7 @@ void LObject::Print()
         }
         break;
     case L_NUMBER:
-        sprintf(buf, "%ld", ((LNumber *)this)->m_num);
+        sprintf(buf, "%ld", LNumber::GetValue(this));
         lprint_string(buf);
         break;
     case L_SYMBOL:
@@ -1371,6 +1443,9 @@ void LObject::Print()
         lprint_string("GC_reference->");
         ((LRedirect *)this)->m_ref->Print();
         break;
+    case L_LOCAL_VAR:
+        ((LLocalVar *)this)->m_name->Print();
+        break;
     default:
         dprintf("Shouldn't happen\n");
     }
@@ -1397,10 +1472,20 @@ LObject *LSymbol::EvalFunction(void *arg_list)
     PtrRef ref2(fun);
     PtrRef ref3(arg_list);
 
-    // make sure the arguments given to the function are the correct number
-    ltype t = item_type(fun);
+    if (m_cache_epoch != cache_epoch)
+    {
+        m_cache_type = item_type(fun);
+        m_cache_checked = false;
+        m_cache_epoch = cache_epoch;
+    }
+    ltype t = m_cache_type;
 
 #ifdef TYPE_CHECKING
+    // Same call site as last time: the arity was already checked
+    if (m_cache_checked && m_cache_args == arg_list)
+        goto checked;
+
+    // make sure the arguments given to the function are the correct number
     switch (t)
     {
     case L_SYS_FUNCTION:
@@ -1440,6 +1525,17 @@ LObject *LSymbol::EvalFunction(void *arg_list)
             exit(0);
         }
     }
+
+    // Lists in the temporary space get reused without a GC, never
+    // remember them
+    if ((uint8_t *)arg_list < LSpace::Tmp.m_data
+         || (uint8_t *)arg_list >= LSpace::Tmp.m_data + LSpace::Tmp.m_size)
+    {
+        m_cache_args = (LObject *)arg_list;
+        m_cache_checked = true;
+    }
+
+checked:
 #endif
 
 #ifdef L_PROFILE
@@ -1880,11 +1976,11 @@ LObject *LSysFunction::EvalFunction(LList *arg_list)
             }
             else if (first)
             {
-                quot = ((LNumber *)i)->m_num;
+                quot = LNumber::GetValue(i);
                 first = 0;
             }
             else
-                quot /= ((LNumber *)i)->m_num;
+                quot /= LNumber::GetValue(i);
             arg_list = (LList *)CDR(arg_list);
         }
         ret = LNumber::Create(quot);
@@ -1921,25 +2017,13 @@ LObject *LSysFunction::EvalFunction(LList *arg_list)
         PtrRef r1(set_to), r2(i);
         i = CAR(arg_list);
 
-        ltype x = item_type(set_to);
         switch (item_type(i))
         {
         case L_SYMBOL:
-            switch (item_type(((LSymbol *)i)->m_value))
-            {
-            case L_NUMBER:
-                if (x == L_NUMBER && ((LSymbol *)i)->m_value != l_undefined)
-                    ((LSymbol *)i)->SetNumber(lnumber_value(set_to));
-                else
-                    ((LSymbol *)i)->SetValue((LNumber *)set_to);
-                break;
-            case L_OBJECT_VAR:
-                l_obj_set(((LObjectVar *)(((LSymbol *)i)->m_value))->m_index, set_to);
-                break;
-            default:
-                ((LSymbol *)i)->SetValue((LObject *)set_to);
-            }
-            ret = ((LSymbol *)i)->m_value;
+            ret = lisp_setq((LSymbol *)i, set_to);
+            break;
+        case L_LOCAL_VAR:
+            ret = lisp_lex_slot(i) = set_to;
             break;
         case L_CONS_CELL:   // this better be an 'aref'
         {
@@ -2062,6 +2146,14 @@ LObject *LSysFunction::EvalFunction(LList *arg_list)
         while (var_list)
         {
             LObject *var_name = CAR(CAR(var_list)), *tmp;
+            // Lexical locals have a slot of their own, nothing to save
+            if (item_type(var_name) == L_LOCAL_VAR)
+            {
+                tmp = CAR(CDR(CAR(var_list)))->Eval();
+                lisp_lex_slot(var_name) = tmp;
+                var_list = CDR(var_list);
+                continue;
+            }
 #ifdef TYPE_CHECKING
             if (item_type(var_name) != L_SYMBOL)
             {
@@ -2090,7 +2182,8 @@ LObject *LSysFunction::EvalFunction(LList *arg_list)
         while (var_list)
         {
             LObject *var_name = CAR(CAR(var_list));
-            ((LSymbol *)var_name)->SetValue((LObject *)l_user_stack.sdata[cur_stack++]);
+            if (item_type(var_name) != L_LOCAL_VAR)
+                ((LSymbol *)var_name)->SetValue((LObject *)l_user_stack.sdata[cur_stack++]);
             var_list = CDR(var_list);
         }
         l_user_stack.m_size = stack_start; // restore the stack
@@ -2118,6 +2211,10 @@ LObject *LSysFunction::EvalFunction(LList *arg_list)
         LObject *block_list = CDR(CDR(arg_list));
 
         LUserFunction *ufun = new_lisp_user_function((LList *)lcar(lcdr(arg_list)), (LList *)block_list);
+        PtrRef r2(ufun);
+        lisp_aot_attach(symbol, ufun);
+        if (lisp_lex_enabled)
+            lisp_lex_attach(ufun);
         symbol->SetFunction(ufun);
         ret = symbol;
         break;
@@ -2196,7 +2293,7 @@ LObject *LSysFunction::EvalFunction(LList *arg_list)
             lbreak(" is not number type\n");
             exit(0);
         }
-        ret = LChar::Create(((LNumber *)i)->m_num);
+        ret = LChar::Create(LNumber::GetValue(i));
         break;
     }
     case SYS_FUNC_COND:
@@ -2467,7 +2564,7 @@ LObject *LSysFunction::EvalFunction(LList *arg_list)
             case L_SYMBOL:
             {
                 LObject *tmp = LNumber::Create(x);
-                ((LSymbol *)sym)->m_value = tmp;
+                ((LSymbol *)sym)->SetValue(tmp);
                 break;
             }
             case L_CONS_CELL:
@@ -2484,7 +2581,7 @@ LObject *LSysFunction::EvalFunction(LList *arg_list)
 #endif
                 x = lnumber_value(CAR(CDR(sym))->Eval());
                 LObject *tmp = LNumber::Create(x);
-                ((LSymbol *)sym)->m_value = tmp;
+                ((LSymbol *)sym)->SetValue(tmp);
                 break;
             }
             default:
@@ -2676,7 +2773,7 @@ LObject *LSysFunction::EvalFunction(LList *arg_list)
     case SYS_FUNC_EQ0:
     {
         LObject *v = CAR(arg_list)->Eval();
-        if (item_type(v) != L_NUMBER || (((LNumber *)v)->m_num != 0))
+        if (item_type(v) != L_NUMBER || (LNumber::GetValue(v) != 0))
             ret = NULL;
         else
             ret = true_symbol;
@@ -2952,6 +3049,9 @@ LObject *LSymbol::EvalUserFunction(LList *arg_list)
         exit(0);
     }
 #endif
+
+    SampleScope sample((uintptr_t)this);
+
 #ifdef L_PROFILE
     time_marker start;
 #endif
@@ -2966,10 +3066,29 @@ LObject *LSymbol::EvalUserFunction(LList *arg_list)
     }
 #endif
 
+    // Functions with lexical locals have a faster path, see lisp_lex.h
+    LList *lex_block = fun->lex_block;
+    if (lex_block && fun->lex_epoch != lisp_lex_epoch)
+        lex_block = lisp_lex_check(fun);
+    if (lex_block)
+    {
+        ret = lisp_lex_call(fun->arg_list, arg_list, lex_block, fun->lex_slots);
+#ifdef L_PROFILE
+        time_marker end;
+        time_taken += end.diff_time(&start);
+#endif
+        return ret;
+    }
+
     LList *fun_arg_list = fun->arg_list;
     LList *block_list = fun->block_list;
     PtrRef r9(block_list), r10(fun_arg_list);
 
+    // Tracing needs every form to go through Eval()
+    LispAotFunction native = lisp_aot_enabled && !trace_level ? fun->native : NULL;
+    LArray *forms = fun->forms;
+    PtrRef r11(forms);
+
     // mark the start start, so we can restore when done
     long stack_start = l_user_stack.m_size;
 
@@ -3016,7 +3135,9 @@ LObject *LSymbol::EvalUserFunction(LList *arg_list)
     }
 
     // now evaluate the function block
-    while (block_list)
+    if (native)
+        ret = native(forms);
+    else while (block_list)
     {
         ret = CAR(block_list)->Eval();
         block_list = (LList *)CDR(block_list);
@@ -3030,7 +3151,7 @@ LObject *LSymbol::EvalUserFunction(LList *arg_list)
 
 #ifdef L_PROFILE
     time_marker end;
-    sym->time_taken += end.diff_time(&start);
+    time_taken += end.diff_time(&start);
 #endif
 
     return ret;
@@ -3078,12 +3199,13 @@ LObject *LObject::Eval()
         case L_SYMBOL:
             if (this == true_symbol)
                 ret = this;
+            else if (((LSymbol *)this)->m_objvar >= 0)
+                ret = (LObject *)l_obj_get(((LSymbol *)this)->m_objvar);
             else
-            {
-                ret = ((LSymbol *)this)->GetValue();
-                if (item_type(ret) == L_OBJECT_VAR)
-                    ret = (LObject *)l_obj_get(((LObjectVar *)ret)->m_index);
-            }
+                ret = ((LSymbol *)this)->m_value;
+            break;
+        case L_LOCAL_VAR:
+            ret = lisp_lex_slot(this);
             break;
         case L_CONS_CELL:
             ret = ((LSymbol *)CAR(this))->EvalFunction(CDR(this));
@@ -3151,6 +3273,130 @@ void Lisp::Uninit()
     LSymbol::count = 0;
 }
 
+LArray *Lisp::saved_globals = NULL;
+static std::map<LSymbol *, size_t> saved_slots; // index in saved_globals
+
+// Lists, arrays and strings can be changed in place, so they are copied
+// rather than shared with the live value. Anything else is kept as is.
+static LObject *CopyGlobal(LObject *x)
+{
+    if (!x || lisp_immediatep(x))
+        return x;
+
+    PtrRef r1(x);
+    switch (item_type(x))
+    {
+    case L_CONS_CELL:
+    {
+        LList *first = NULL, *last = NULL;
+        PtrRef r2(first), r3(last);
+        for (; x && item_type(x) == L_CONS_CELL; x = CDR(x))
+        {
+            LObject *car = CopyGlobal(CAR(x));
+            PtrRef r4(car);
+            LList *c = LList::Create();
+            c->m_car = car;
+            if (last)
+                last->m_cdr = c;
+            else
+                first = c;
+            last = c;
+        }
+        if (x)
+        {
+            LObject *rest = CopyGlobal(x);
+            last->m_cdr = rest;
+        }
+        return first;
+    }
+    case L_1D_ARRAY:
+    {
+        size_t len = ((LArray *)x)->m_len;
+        LArray *a = LArray::Create(len, NULL);
+        PtrRef r2(a);
+        for (size_t i = 0; i < len; i++)
+        {
+            LObject *v = CopyGlobal(((LArray *)x)->GetData()[i]);
+            a->GetData()[i] = v;
+        }
+        return a;
+    }
+    case L_STRING:
+    {
+        LString *s = LString::Create((int)strlen(lstring_value(x)) + 1);
+        strcpy(s->GetString(), lstring_value(x));
+        return s;
+    }
+    default:
+        return x;
+    }
+}
+
+static void CountSymbols(LSymbol *root, size_t &count)
+{
+    if (root)
+    {
+        CountSymbols(root->m_left, count);
+        count++;
+        CountSymbols(root->m_right, count);
+    }
+}
+
+// Symbols are not allocated in a Lisp space and never move, so they can be
+// used as keys. The array they index does move when a copy triggers a GC.
+static void SaveSymbols(LSymbol *root, LArray *const &saved)
+{
+    if (!root)
+        return;
+
+    SaveSymbols(root->m_left, saved);
+    size_t n = saved_slots.size();
+    LObject *v = CopyGlobal(root->m_value);
+    saved->GetData()[n] = v;
+    saved_slots[root] = n;
+    SaveSymbols(root->m_right, saved);
+}
+
+void Lisp::SaveGlobals()
+{
+    LSpace *sp = LSpace::Current;
+    LSpace::Current = &LSpace::Perm;
+
+    size_t count = 0;
+    CountSymbols(LSymbol::root, count);
+    saved_globals = NULL;
+    saved_slots.clear();
+    saved_globals = LArray::Create(count, NULL);
+    SaveSymbols(LSymbol::root, saved_globals);
+
+    LSpace::Current = sp;
+}
+
+static void RestoreSymbols(LSymbol *root, LArray *const &saved)
+{
+    if (!root)
+        return;
+
+    RestoreSymbols(root->m_left, saved);
+    std::map<LSymbol *, size_t>::iterator it = saved_slots.find(root);
+    if (it == saved_slots.end())
+        root->SetValue(l_undefined); // did not exist yet
+    else
+        root->SetValue(CopyGlobal(saved->GetData()[it->second]));
+    RestoreSymbols(root->m_right, saved);
+}
+
+void Lisp::RestoreGlobals()
+{
+    if (!saved_globals)
+        return;
+
+    LSpace *sp = LSpace::Current;
+    LSpace::Current = &LSpace::Perm;
+    RestoreSymbols(LSymbol::root, saved_globals);
+    LSpace::Current = sp;
+}
+
 void LSpace::Clear()
 {
     m_free = m_data;
@@ -3179,10 +3425,22 @@ void LSymbol::SetNumber(long num)
         exit(0);
     }
 #endif
-    if (m_value != l_undefined && item_type(m_value) == L_NUMBER)
+    // A number that does not fit in a fixnum needs a cell, which must not
+    // be in the temporary space: reuse the one the symbol already has, or
+    // make a new one in the permanent space.
+    if (lisp_fixnum_fits(num))
+        m_value = LNumber::Create(num);
+    else if (m_value != l_undefined && item_type(m_value) == L_NUMBER
+              && !lisp_fixnump(m_value))
         ((LNumber *)m_value)->m_num = num;
     else
+    {
+        LSpace *sp = LSpace::Current;
+        LSpace::Current = &LSpace::Perm;
         m_value = LNumber::Create(num);
+        LSpace::Current = sp;
+    }
+    m_objvar = -1;
 }
 
 void LSymbol::SetValue(LObject *val)
@@ -3196,6 +3454,7 @@ void LSymbol::SetValue(LObject *val)
     }
 #endif
     m_value = val;
+    m_objvar = item_type(val) == L_OBJECT_VAR ? ((LObjectVar *)val)->m_index : -1;
 }
 
 LObject *LSymbol::GetFunction()
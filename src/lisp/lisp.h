@@ -48,6 +48,7 @@ enum
     L_1D_ARRAY,
     L_FIXED_POINT,
     L_COLLECTED_OBJECT,
+    L_LOCAL_VAR,
 };
 
 // FIXME: switch this to uint8_t one day? it still breaks stuff
@@ -93,6 +94,18 @@ struct LObjectVar : LObject
     int m_index;
 };
 
+struct LSymbol;
+
+struct LLocalVar : LObject
+{
+    /* Factories */
+    static LLocalVar *Create(LSymbol *name, int slot);
+
+    /* Members */
+    LSymbol *m_name; // symbols never move, no need to collect it
+    int m_slot;
+};
+
 struct LList : LObject
 {
     /* Factories */
@@ -111,6 +124,9 @@ struct LNumber : LObject
     /* Factories */
     static LNumber *Create(long num);
 
+    /* Methods */
+    static long GetValue(void const *x); // x may be a fixnum
+
     /* Members */
     long m_num;
 };
@@ -163,9 +179,20 @@ struct LSymbol : LObject
     LString *m_name;
     LSymbol *m_left, *m_right; // tree structure
 
+    // Call cache for EvalFunction, valid while m_cache_epoch == cache_epoch:
+    // the kind of m_function and the last argument list that passed the
+    // arity check. Object variables are resolved in SetValue.
+    uint32_t m_cache_epoch;
+    ltype m_cache_type;
+    bool m_cache_checked;
+    LObject *m_cache_args;
+    int m_objvar; // index if m_value is an LObjectVar, -1 otherwise
+    uint8_t m_lex; // LEX_FREE and LEX_LOCAL, see lisp_lex.h
+
     /* Static members */
     static LSymbol *root;
     static size_t count;
+    static uint32_t cache_epoch; // bumped by SetFunction() and GC
 };
 
 struct LSysFunction : LObject
@@ -178,9 +205,20 @@ struct LSysFunction : LObject
     short fun_number;
 };
 
+struct LArray;
+
 struct LUserFunction : LObject
 {
     LList *arg_list, *block_list;
+
+    // Compiled body and the forms it refers to, see lisp_aot.h
+    LObject *(*native)(LArray *const &forms);
+    LArray *forms;
+
+    // Body with lexical locals and its frame size, see lisp_lex.h
+    LList *lex_block, *lex_locals;
+    int lex_slots;
+    uint32_t lex_epoch;
 };
 
 struct LArray : LObject
@@ -240,7 +278,14 @@ public:
     // Collect temporary or permanent spaces
     static void CollectSpace(LSpace *which_space, int grow);
 
+    // Set aside a copy of every global variable's value, and put the copy
+    // back later, so that a demo can be replayed from the same Lisp state
+    static void SaveGlobals();
+    static void RestoreGlobals();
+
 private:
+    static LArray *saved_globals; // one value per symbol, in Perm space
+
     static LArray *CollectArray(LArray *x);
     static LList *CollectList(LList *x);
     static LObject *CollectObject(LObject *x);
@@ -271,7 +316,43 @@ static inline bool ptr_is_null(void *ptr)
 }
 #endif
 
-static inline ltype item_type(void *x) { if (!ptr_is_null(x)) return *(ltype *)x; return L_CONS_CELL; }
+/*
+ * Small integers and C pointers are not allocated in a Lisp space: they are
+ * stored directly in the LObject pointer. Cells are always allocated on an
+ * intptr_t boundary, so their low two bits are free to tell them apart:
+ *   ...xx1  fixnum, the value is the pointer shifted right by one
+ *   ...x10  pointer, the address with bit 1 set
+ *   ...x00  regular cell (or NULL)
+ * Numbers that do not fit and unaligned addresses still get a cell, so
+ * code must go through item_type() and the lnumber_value() family rather
+ * than dereferencing LNumber or LPointer objects directly.
+ */
+static inline bool lisp_fixnump(void const *x) { return ((intptr_t)x & 1) != 0; }
+static inline bool lisp_pointerp(void const *x) { return ((intptr_t)x & 3) == 2; }
+static inline bool lisp_immediatep(void const *x) { return ((intptr_t)x & 3) != 0; }
+
+static inline bool lisp_fixnum_fits(long num)
+{
+    return ((intptr_t)((uintptr_t)(intptr_t)num << 1) >> 1) == num;
+}
+static inline long lisp_fixnum_value(void const *x) { return (long)((intptr_t)x >> 1); }
+static inline void *lisp_pointer_value(void const *x) { return (void *)((intptr_t)x & ~(intptr_t)2); }
+
+static inline ltype item_type(void *x)
+{
+    if (lisp_immediatep(x))
+        return lisp_fixnump(x) ? L_NUMBER : L_POINTER;
+    if (!ptr_is_null(x))
+        return *(ltype *)x;
+    return L_CONS_CELL;
+}
+
+inline long LNumber::GetValue(void const *x)
+{
+    if (lisp_fixnump(x))
+        return lisp_fixnum_value(x);
+    return ((LNumber const *)x)->m_num;
+}
 
 void perm_space();
 void tmp_space();
@@ -282,6 +363,7 @@ void *lisp_atom(void *i);
 LObject *lcdr(void *c);
 LObject *lcar(void *c);
 void *lisp_eq(void *n1, void *n2);
+LObject *lisp_setq(LSymbol *sym, LObject *set_to);
 void *lisp_equal(void *n1, void *n2);
 void *eval_block(void *list);
 void resize_tmp(size_t new_size);
@@ -304,7 +386,7 @@ LUserFunction *new_lisp_user_function(LList *arg_list, LList *block_list);
 
 LSysFunction *new_user_lisp_function(int min_args, int max_args, int fun_number);
 
-int end_of_program(char *s);
+int end_of_program(char const *s);
 
 void *nth(int num, void *list);
 int32_t lisp_atan2(int32_t dy, int32_t dx);
@@ -0,0 +1,188 @@
+/*
+ *  Abuse - dark 2D side-scrolling platform game
+ *  Copyright (c) 1995 Crack dot Com
+ *  Copyright (c) 2005-2011 Sam Hocevar <sam@hocevar.net>
+ *
+ *  This software was released into the Public Domain. As with most public
+ *  domain software, no warranty is made or implied by Crack dot Com, by
+ *  Jonathan Clark, or by Sam Hocevar.
+ */
+
+#if defined HAVE_CONFIG_H
+#   include "config.h"
+#endif
+
+#include <stdio.h>
+#include <string.h>
+
+#include "common.h"
+
+#include "lisp.h"
+#include "lisp_gc.h"
+#include "lisp_aot.h"
+#include "dprint.h"
+
+bool lisp_aot_enabled = false;
+static LispAotTable const *aot_table = NULL;
+static int aot_attached = 0;
+
+void lisp_aot_register(LispAotTable const *table)
+{
+    aot_table = table;
+    for (int i = 0; table->symbol_names[i]; i++)
+        table->symbols[i] = LSymbol::FindOrCreate(table->symbol_names[i]);
+    lisp_aot_enabled = table->entries[0].name != NULL;
+}
+
+void lisp_aot_disable()
+{
+    if (lisp_aot_enabled && aot_attached)
+        dprintf("Lisp: builtin redefined, compiled functions disabled\n");
+    lisp_aot_enabled = false;
+}
+
+//
+// The hash covers everything the generated code relies on: the argument
+// names, which are bound dynamically, and the exact shape of the body.
+//
+static uint32_t hash_bytes(uint32_t h, void const *data, size_t len)
+{
+    uint8_t const *p = (uint8_t const *)data;
+    while (len--)
+    {
+        h ^= *p++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static uint32_t hash_object(uint32_t h, LObject *x)
+{
+    while (x && item_type(x) == L_CONS_CELL)
+    {
+        h = hash_bytes(h, "(", 1);
+        h = hash_object(h, CAR(x));
+        x = CDR(x);
+    }
+
+    char buf[32];
+    switch (item_type(x))
+    {
+    case L_CONS_CELL: // end of a proper list
+        return hash_bytes(h, ")", 1);
+    case L_NUMBER:
+        sprintf(buf, "N%ld", LNumber::GetValue(x));
+        h = hash_bytes(h, buf, strlen(buf));
+        break;
+    case L_SYMBOL:
+        h = hash_bytes(h, "S", 1);
+        h = hash_bytes(h, lstring_value(((LSymbol *)x)->GetName()),
+                       strlen(lstring_value(((LSymbol *)x)->GetName())) + 1);
+        break;
+    case L_STRING:
+        h = hash_bytes(h, "Q", 1);
+        h = hash_bytes(h, lstring_value(x), strlen(lstring_value(x)) + 1);
+        break;
+    case L_CHARACTER:
+        sprintf(buf, "C%d", ((LChar *)x)->GetValue());
+        h = hash_bytes(h, buf, strlen(buf));
+        break;
+    case L_FIXED_POINT:
+        sprintf(buf, "F%ld", lfixed_point_value(x));
+        h = hash_bytes(h, buf, strlen(buf));
+        break;
+    default:
+    {
+        // Should not appear in source code; never match anything
+        uint8_t t = item_type(x);
+        h = hash_bytes(h, "?", 1);
+        h = hash_bytes(h, &t, 1);
+        h = hash_bytes(h, &x, sizeof(x));
+        break;
+    }
+    }
+    return hash_bytes(h, ".)", 2); // improper list tail
+}
+
+uint32_t lisp_aot_hash(LObject *arg_list, LObject *block_list)
+{
+    uint32_t h = 2166136261u;
+    h = hash_object(h, arg_list);
+    h = hash_object(h, block_list);
+    return h;
+}
+
+//
+// Every heap cell of a body (list cells, strings, characters, numbers too
+// big for a fixnum) gets an index in walk order. The compiler and the
+// runtime both use this function, so the indices always agree. If out is
+// NULL, only count them.
+//
+size_t lisp_aot_walk(LObject *x, LObject **out)
+{
+    size_t n = 0;
+
+    while (x && !lisp_immediatep(x))
+    {
+        ltype t = item_type(x);
+        if (t == L_SYMBOL)
+            break;
+        if (out)
+            out[n] = x;
+        n++;
+        if (t != L_CONS_CELL)
+            break;
+        n += lisp_aot_walk(CAR(x), out ? out + n : NULL);
+        x = CDR(x);
+    }
+
+    return n;
+}
+
+void lisp_aot_attach(LSymbol *name, LUserFunction *&fun)
+{
+    fun->native = NULL;
+    fun->forms = NULL;
+
+    if (!lisp_aot_enabled)
+        return;
+
+    char const *st = lstring_value(name->GetName());
+    uint32_t hash = lisp_aot_hash(fun->arg_list, fun->block_list);
+    LispAotEntry const *e;
+    for (e = aot_table->entries; e->name; e++)
+        if (e->hash == hash && !strcmp(e->name, st))
+            break;
+    if (!e->name)
+        return;
+
+    // This may collect garbage and move fun, which the caller protects
+    size_t n = lisp_aot_walk(fun->block_list, NULL);
+    LArray *forms = LArray::Create(Max(n, (size_t)1), NULL);
+    lisp_aot_walk(fun->block_list, forms->GetData());
+
+    fun->forms = forms;
+    fun->native = e->fun;
+    aot_attached++;
+}
+
+long lisp_aot_slash_arg(LObject *x)
+{
+    if (item_type(x) != L_NUMBER)
+    {
+        x->Print();
+        lbreak("/ only defined for numbers, cannot divide ");
+        exit(0);
+    }
+    return LNumber::GetValue(x);
+}
+
+int32_t lisp_aot_mod(int32_t x, int32_t y)
+{
+    if (y == 0)
+    {
+        lbreak("mod: division by zero\n");
+        y = 1;
+    }
+    return x % y;
+}
@@ -0,0 +1,114 @@
+/*
+ *  Abuse - dark 2D side-scrolling platform game
+ *  Copyright (c) 1995 Crack dot Com
+ *  Copyright (c) 2005-2011 Sam Hocevar <sam@hocevar.net>
+ *
+ *  This software was released into the Public Domain. As with most public
+ *  domain software, no warranty is made or implied by Crack dot Com, by
+ *  Jonathan Clark, or by Sam Hocevar.
+ */
+
+#ifndef __LISP_AOT_HPP_
+#define __LISP_AOT_HPP_
+
+#include "lisp.h"
+#include "lisp_gc.h"
+#include "lisp_opt.h"
+
+/*
+ * Ahead-of-time compiled Lisp functions.
+ *
+ * abuse-lispc reads the game's .lsp files at build time and translates the
+ * body of each defun into a C++ function. When a defun is evaluated at
+ * runtime, its argument list and body are hashed and, if a compiled body
+ * with the same name and hash was registered, it is attached to the new
+ * LUserFunction. Anything else (a mod, a function redefined from the
+ * console, a different version of the file) keeps being interpreted.
+ *
+ * Compiled bodies still bind their arguments through the symbols, exactly
+ * like EvalUserFunction does, and fall back to Eval() for any form they
+ * do not know how to translate. The forms they need at runtime (strings,
+ * quoted lists, calls to hand back to the interpreter...) are found by
+ * walking the body in a fixed order, see lisp_aot_walk().
+ */
+
+typedef LObject *(*LispAotFunction)(LArray *const &forms);
+
+struct LispAotEntry
+{
+    char const *name;
+    uint32_t hash;
+    LispAotFunction fun;
+};
+
+struct LispAotTable
+{
+    LispAotEntry const *entries;        // terminated by a NULL name
+    char const *const *symbol_names;    // terminated by NULL
+    LSymbol **symbols;                  // filled by lisp_aot_register()
+};
+
+// Generated by abuse-lispc, or empty when the tool could not be run
+extern LispAotTable const lisp_aot_table;
+
+void lisp_aot_register(LispAotTable const *table);
+void lisp_aot_attach(LSymbol *name, LUserFunction *&fun);
+void lisp_aot_disable();
+extern bool lisp_aot_enabled;
+
+uint32_t lisp_aot_hash(LObject *arg_list, LObject *block_list);
+size_t lisp_aot_walk(LObject *x, LObject **out);
+
+/*
+ * Helpers used by the generated code. They do what the matching case of
+ * LObject::Eval or LSysFunction::EvalFunction does with a value that has
+ * already been evaluated.
+ */
+static inline LObject *lisp_aot_value(LSymbol *s)
+{
+    if (s == true_symbol)
+        return s;
+    if (s->m_objvar >= 0)
+        return (LObject *)l_obj_get(s->m_objvar);
+    return s->m_value;
+}
+
+static inline LObject *lisp_aot_bool(bool x)
+{
+    return x ? true_symbol : NULL;
+}
+
+static inline bool lisp_aot_cfun(LObject *fun, int args)
+{
+    ltype t = item_type(fun);
+    if (t != L_C_FUNCTION && t != L_C_BOOL)
+        return false;
+    LSysFunction *f = (LSysFunction *)fun;
+    return f->min_args == -1 || (args >= f->min_args
+                                  && (f->max_args == -1 || args <= f->max_args));
+}
+
+// The caller stores the value in last->m_car afterwards, so that it is
+// not held unprotected across the allocation.
+static inline void lisp_aot_append(LList *&first, LList *&last)
+{
+    LList *tmp = LList::Create();
+    if (first)
+        last->m_cdr = tmp;
+    else
+        first = tmp;
+    last = tmp;
+}
+
+static inline LObject *lisp_aot_ccall(LObject *fun, LList *args)
+{
+    long ret = c_caller(((LSysFunction *)fun)->fun_number, args);
+    if (item_type(fun) == L_C_FUNCTION)
+        return LNumber::Create(ret);
+    return ret ? true_symbol : NULL;
+}
+
+long lisp_aot_slash_arg(LObject *x);
+int32_t lisp_aot_mod(int32_t x, int32_t y);
+
+#endif
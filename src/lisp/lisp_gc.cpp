@@ -32,7 +32,8 @@
 */
 
 // Stack where user programs can push data and have it GCed - these are the values I need to keep
-GrowStack<void> l_user_stack(150);
+// Lexical functions keep their whole frame there, see lisp_lex.h
+GrowStack<void> l_user_stack(1000);
 
 // Stack of user pointers - these are the pointers that need to be updated if values move
 GrowStack<void *> PtrRef::stack(1500);
@@ -83,6 +84,11 @@ LObject *Lisp::CollectObject(LObject *x)
 {
     LObject *ret = x;
 
+    // Fixnums and pointers live in the reference itself, and their bits
+    // may well look like an address inside the space being collected.
+    if (lisp_immediatep(x))
+        return x;
+
     maxgcdepth = Max(maxgcdepth, ++gcdepth);
 
     if ((uint8_t *)x >= cstart && (uint8_t *)x < cend)
@@ -105,7 +111,17 @@ LObject *Lisp::CollectObject(LObject *x)
             LUserFunction *fun = (LUserFunction *)x;
             LList *arg = (LList *)CollectObject(fun->arg_list);
             LList *block = (LList *)CollectObject(fun->block_list);
-            ret = new_lisp_user_function(arg, block);
+            LArray *forms = (LArray *)CollectObject(fun->forms);
+            LList *lex_block = (LList *)CollectObject(fun->lex_block);
+            LList *lex_locals = (LList *)CollectObject(fun->lex_locals);
+            LUserFunction *ufun = new_lisp_user_function(arg, block);
+            ufun->native = fun->native;
+            ufun->forms = forms;
+            ufun->lex_block = lex_block;
+            ufun->lex_locals = lex_locals;
+            ufun->lex_slots = fun->lex_slots;
+            ufun->lex_epoch = fun->lex_epoch;
+            ret = ufun;
             break;
         }
         case L_STRING:
@@ -144,6 +160,10 @@ LObject *Lisp::CollectObject(LObject *x)
         case L_OBJECT_VAR:
             ret = LObjectVar::Create(((LObjectVar *)x)->m_index);
             break;
+        case L_LOCAL_VAR:
+            ret = LLocalVar::Create(((LLocalVar *)x)->m_name,
+                                    ((LLocalVar *)x)->m_slot);
+            break;
         case L_COLLECTED_OBJECT:
             ret = ((LRedirect *)x)->m_ref;
             break;
@@ -223,6 +243,10 @@ void Lisp::CollectSpace(LSpace *which_space, int grow)
 
     CollectSymbols(LSymbol::root);
     CollectStacks();
+    saved_globals = (LArray *)CollectObject(saved_globals);
+
+    // Cached argument lists may have moved
+    LSymbol::cache_epoch++;
 
     free(which_space->m_data);
     which_space->m_data = new_data;
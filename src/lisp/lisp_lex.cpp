@@ -0,0 +1,521 @@
+/*
+ *  Abuse - dark 2D side-scrolling platform game
+ *  Copyright (c) 1995 Crack dot Com
+ *  Copyright (c) 2005-2011 Sam Hocevar <sam@hocevar.net>
+ *
+ *  This software was released into the Public Domain. As with most public
+ *  domain software, no warranty is made or implied by Crack dot Com, by
+ *  Jonathan Clark, or by Sam Hocevar.
+ */
+
+#if defined HAVE_CONFIG_H
+#   include "config.h"
+#endif
+
+#include <stdio.h>
+#include <vector>
+
+#include "common.h"
+
+#include "lisp.h"
+#include "lisp_gc.h"
+#include "lisp_opt.h"
+#include "lisp_lex.h"
+#include "symbols.h"
+
+bool lisp_lex_enabled = false;
+uint32_t lisp_lex_epoch = 1;
+long lisp_lex_frame = 0;
+
+static LSymbol *defun_symbol = NULL;
+
+static void mark_free(LSymbol *sym)
+{
+    if (sym->m_lex & LEX_FREE)
+        return;
+    sym->m_lex |= LEX_FREE;
+    if (sym->m_lex & LEX_LOCAL)
+        lisp_lex_epoch++; // some function must go back to dynamic binding
+}
+
+// Every symbol anywhere in x, quoted or not, may be looked up by name
+static void mark_all_free(LObject *x)
+{
+    while (x && item_type(x) == L_CONS_CELL)
+    {
+        mark_all_free(CAR(x));
+        x = CDR(x);
+    }
+    if (x && item_type(x) == L_SYMBOL)
+        mark_free((LSymbol *)x);
+}
+
+static void mark_tree_free(LSymbol *root)
+{
+    if (!root)
+        return;
+    root->m_lex |= LEX_FREE;
+    mark_tree_free(root->m_left);
+    mark_tree_free(root->m_right);
+}
+
+void lisp_lex_enable()
+{
+    // Symbols the engine already knows may be read from C at any time
+    mark_tree_free(LSymbol::root);
+    defun_symbol = LSymbol::FindOrCreate("defun");
+    lisp_lex_enabled = true;
+}
+
+//
+// Walks a function body. The first pass only looks: it marks free symbols
+// and finds out whether every form is understood. The second pass returns
+// a copy where locals are replaced with LLocalVar objects. Both go through
+// the same code so that the scopes always agree.
+//
+class LexCompiler
+{
+public:
+    LexCompiler(bool rewrite) : m_rewrite(rewrite), m_ok(true), m_slots(0) { }
+
+    bool Bind(LObject *arg_list);
+    LObject *Body(LObject *block_list) { return Map(block_list, &LexCompiler::Form); }
+
+    bool m_rewrite, m_ok;
+    int m_slots;
+    std::vector<LSymbol *> m_locals;
+
+private:
+    typedef LObject *(LexCompiler::*Walker)(LObject *);
+
+    int AddLocal(LObject *x);
+    int Lookup(LSymbol *sym);
+    void Reject(LObject *x);
+    LObject *Cons(LObject *car, LObject *cdr);
+    LObject *Map(LObject *list, Walker f);
+
+    LObject *Form(LObject *x);
+    LObject *Forms(LObject *x) { return Map(x, &LexCompiler::Form); }
+    LObject *Symbol(LObject *x);
+    LObject *Call(LObject *x);
+    LObject *Let(LObject *x);
+    LObject *LetVar(LObject *x);
+    LObject *Setq(LObject *x);
+    LObject *IfProgn(LObject *x, bool first, bool second);
+    LObject *Cond(LObject *x);
+    LObject *Select(LObject *x);
+
+    std::vector<std::pair<LSymbol *, int> > m_scope;
+};
+
+int LexCompiler::AddLocal(LObject *x)
+{
+    if (item_type(x) != L_SYMBOL || x == true_symbol)
+    {
+        Reject(x);
+        return -1;
+    }
+    m_scope.push_back(std::make_pair((LSymbol *)x, m_slots));
+    m_locals.push_back((LSymbol *)x);
+    return m_slots++;
+}
+
+int LexCompiler::Lookup(LSymbol *sym)
+{
+    for (size_t i = m_scope.size(); i--; )
+        if (m_scope[i].first == sym)
+            return m_scope[i].second;
+    return -1;
+}
+
+void LexCompiler::Reject(LObject *x)
+{
+    m_ok = false;
+    mark_all_free(x);
+}
+
+LObject *LexCompiler::Cons(LObject *car, LObject *cdr)
+{
+    PtrRef r1(car), r2(cdr);
+    LList *c = LList::Create();
+    c->m_car = car;
+    c->m_cdr = cdr;
+    return c;
+}
+
+LObject *LexCompiler::Map(LObject *list, Walker f)
+{
+    LObject *orig = list, *first = NULL, *last = NULL, *tmp = NULL;
+    PtrRef r1(orig), r2(list), r3(first), r4(last), r5(tmp);
+
+    for (; list; list = CDR(list))
+    {
+        if (item_type(list) != L_CONS_CELL)
+        {
+            Reject(list);
+            break;
+        }
+        tmp = (this->*f)(CAR(list));
+        if (!m_rewrite)
+            continue;
+        tmp = Cons(tmp, NULL);
+        if (last)
+            CDR(last) = tmp;
+        else
+            first = tmp;
+        last = tmp;
+    }
+
+    return m_rewrite ? first : orig;
+}
+
+bool LexCompiler::Bind(LObject *arg_list)
+{
+    for (; arg_list; arg_list = CDR(arg_list))
+    {
+        if (item_type(arg_list) != L_CONS_CELL)
+        {
+            Reject(arg_list);
+            return false;
+        }
+        if (AddLocal(CAR(arg_list)) < 0)
+            return false;
+    }
+    return true;
+}
+
+LObject *LexCompiler::Form(LObject *x)
+{
+    switch (item_type(x))
+    {
+    case L_SYMBOL:
+        return Symbol(x);
+    case L_CONS_CELL:
+        return x ? Call(x) : x;
+    default:
+        return x; // numbers, strings... evaluate to themselves
+    }
+}
+
+LObject *LexCompiler::Symbol(LObject *x)
+{
+    if (x == true_symbol)
+        return x;
+
+    int slot = Lookup((LSymbol *)x);
+    if (slot < 0)
+    {
+        mark_free((LSymbol *)x);
+        return x;
+    }
+    return m_rewrite ? LLocalVar::Create((LSymbol *)x, slot) : x;
+}
+
+LObject *LexCompiler::Call(LObject *x)
+{
+    LObject *head = CAR(x);
+    if (item_type(head) != L_SYMBOL)
+    {
+        Reject(x);
+        return x;
+    }
+
+    LObject *fun = ((LSymbol *)head)->m_function;
+    if (item_type(fun) == L_SYS_FUNCTION)
+    {
+        switch (((LSysFunction *)fun)->fun_number)
+        {
+        case SYS_FUNC_QUOTE:
+            // Quoted data may well end up in an eval
+            mark_all_free(x);
+            return x;
+        case SYS_FUNC_LET:
+            return Let(x);
+        case SYS_FUNC_SETQ:
+        case SYS_FUNC_SETF:
+            return Setq(x);
+        case SYS_FUNC_IF_1PROGN:
+            return IfProgn(x, true, false);
+        case SYS_FUNC_IF_2PROGN:
+            return IfProgn(x, false, true);
+        case SYS_FUNC_IF_12PROGN:
+            return IfProgn(x, true, true);
+        case SYS_FUNC_COND:
+            return Cond(x);
+        case SYS_FUNC_SELECT:
+            return Select(x);
+        // These bind symbols themselves, evaluate code built at runtime
+        // or let other functions look at their arguments
+        case SYS_FUNC_DEFUN:
+        case SYS_FUNC_FOR:
+        case SYS_FUNC_DO:
+        case SYS_FUNC_EVAL:
+        case SYS_FUNC_BACKQUOTE:
+        case SYS_FUNC_COMMA:
+        case SYS_FUNC_ENUM:
+        case SYS_FUNC_FUNCTION:
+        case SYS_FUNC_MAPCAR:
+        case SYS_FUNC_FUNCALL:
+        case SYS_FUNC_TRACE:
+        case SYS_FUNC_UNTRACE:
+        case SYS_FUNC_BREAK:
+        case SYS_FUNC_LOAD:
+        case SYS_FUNC_LOCAL_LOAD:
+        case SYS_FUNC_COMPILE_FILE:
+            Reject(x);
+            return x;
+        default:
+            break;
+        }
+    }
+
+    // Anything else evaluates all of its arguments
+    PtrRef r1(head);
+    LObject *args = Forms(CDR(x));
+    return m_rewrite ? Cons(head, args) : x;
+}
+
+// (let ((var init)...) body...), each init sees the variables before it
+LObject *LexCompiler::Let(LObject *x)
+{
+    LObject *head = CAR(x), *args = CDR(x);
+    if (!args || item_type(args) != L_CONS_CELL)
+    {
+        Reject(x);
+        return x;
+    }
+
+    size_t depth = m_scope.size();
+    LObject *vars = NULL, *body = NULL;
+    PtrRef r1(x), r2(head), r3(args), r4(vars), r5(body);
+    vars = Map(CAR(args), &LexCompiler::LetVar);
+    body = Forms(CDR(args));
+    m_scope.resize(depth);
+
+    if (!m_rewrite)
+        return x;
+    return Cons(head, Cons(vars, body));
+}
+
+LObject *LexCompiler::LetVar(LObject *x)
+{
+    if (!x || item_type(x) != L_CONS_CELL || !CDR(x)
+         || item_type(CDR(x)) != L_CONS_CELL || CDR(CDR(x)))
+    {
+        Reject(x);
+        return x;
+    }
+
+    LObject *name = CAR(x), *init = NULL;
+    PtrRef r1(name), r2(init);
+    init = Form(CAR(CDR(x)));
+    int slot = AddLocal(name);
+
+    if (!m_rewrite)
+        return x;
+    name = LLocalVar::Create((LSymbol *)name, slot);
+    return Cons(name, Cons(init, NULL));
+}
+
+// (setq place value), where place is a symbol, (car x), (cdr x) or (aref a i)
+LObject *LexCompiler::Setq(LObject *x)
+{
+    LObject *head = CAR(x), *place = NULL, *value = NULL;
+    PtrRef r1(x), r2(head), r3(place), r4(value);
+
+    if (!CDR(x) || !CDR(CDR(x)) || CDR(CDR(CDR(x))))
+    {
+        Reject(x);
+        return x;
+    }
+    place = CAR(CDR(x));
+    switch (item_type(place))
+    {
+    case L_SYMBOL:
+        place = Symbol(place);
+        break;
+    case L_CONS_CELL:
+        if (place && (CAR(place) == car_symbol || CAR(place) == cdr_symbol
+                       || CAR(place) == aref_symbol))
+        {
+            LObject *args = Forms(CDR(place));
+            place = m_rewrite ? Cons(CAR(place), args) : place;
+            break;
+        }
+        // fall through
+    default:
+        Reject(x);
+        return x;
+    }
+    value = Form(CAR(CDR(CDR(x))));
+
+    if (!m_rewrite)
+        return x;
+    return Cons(head, Cons(place, Cons(value, NULL)));
+}
+
+// (if-1progn test (then...) else), (if-2progn test then (else...)) and
+// (if-12progn test (then...) (else...)) as built by comp_optimize()
+LObject *LexCompiler::IfProgn(LObject *x, bool first, bool second)
+{
+    LObject *head = CAR(x), *test = NULL, *a = NULL, *b = NULL;
+    PtrRef r1(x), r2(head), r3(test), r4(a), r5(b);
+
+    if (!CDR(x) || !CDR(CDR(x)) || !CDR(CDR(CDR(x)))
+         || CDR(CDR(CDR(CDR(x)))))
+    {
+        Reject(x);
+        return x;
+    }
+    test = Form(CAR(CDR(x)));
+    a = CAR(CDR(CDR(x)));
+    a = first ? Forms(a) : Form(a);
+    b = CAR(CDR(CDR(CDR(x))));
+    b = second ? Forms(b) : Form(b);
+
+    if (!m_rewrite)
+        return x;
+    return Cons(head, Cons(test, Cons(a, Cons(b, NULL))));
+}
+
+// (cond ((test value)...)), the whole clause list is the first argument
+LObject *LexCompiler::Cond(LObject *x)
+{
+    if (!CDR(x) || CDR(CDR(x)))
+    {
+        Reject(x);
+        return x;
+    }
+
+    LObject *head = CAR(x), *clauses = NULL;
+    PtrRef r1(head), r2(clauses);
+    clauses = Map(CAR(CDR(x)), &LexCompiler::Forms);
+
+    if (!m_rewrite)
+        return x;
+    return Cons(head, Cons(clauses, NULL));
+}
+
+// (select value (key forms...)...), keys are evaluated too
+LObject *LexCompiler::Select(LObject *x)
+{
+    if (!CDR(x))
+    {
+        Reject(x);
+        return x;
+    }
+
+    LObject *head = CAR(x), *value = NULL, *clauses = NULL;
+    PtrRef r1(x), r2(head), r3(value), r4(clauses);
+    value = Form(CAR(CDR(x)));
+    clauses = Map(CDR(CDR(x)), &LexCompiler::Forms);
+
+    if (!m_rewrite)
+        return x;
+    return Cons(head, Cons(value, clauses));
+}
+
+void lisp_lex_toplevel(LObject *form)
+{
+    // Functions are looked at when DEFUN evaluates them
+    if (item_type(form) == L_CONS_CELL && form
+         && CAR(form) == defun_symbol)
+        return;
+    mark_all_free(form);
+}
+
+void lisp_lex_attach(LUserFunction *&fun)
+{
+    fun->lex_block = NULL;
+
+    LexCompiler scan(false);
+    if (scan.Bind(fun->arg_list))
+        scan.Body(fun->block_list);
+    else
+        mark_all_free(fun->block_list);
+    size_t args = fun->arg_list ? fun->arg_list->GetLength() : 0;
+
+    // Compiled functions bind through the symbols, but their free symbols
+    // still had to be marked above
+    if (!scan.m_ok || fun->native)
+        return;
+
+    for (size_t i = 0; i < scan.m_locals.size(); i++)
+    {
+        LSymbol *sym = scan.m_locals[i];
+        if ((sym->m_lex & LEX_FREE) || sym->m_objvar >= 0
+             || lstring_value(sym->GetName())[0] == ':')
+            return;
+        for (size_t j = 0; j < i && i < args; j++)
+            if (scan.m_locals[j] == sym)
+                return; // the same argument twice
+    }
+
+    LObject *locals = NULL, *block = NULL;
+    PtrRef r1(locals), r2(block);
+    for (size_t i = 0; i < scan.m_locals.size(); i++)
+    {
+        scan.m_locals[i]->m_lex |= LEX_LOCAL;
+        LList *c = LList::Create();
+        c->m_car = scan.m_locals[i];
+        c->m_cdr = locals;
+        locals = c;
+    }
+
+    LexCompiler rewrite(true);
+    rewrite.Bind(fun->arg_list);
+    block = rewrite.Body(fun->block_list);
+
+    fun->lex_block = (LList *)block;
+    fun->lex_locals = (LList *)locals;
+    fun->lex_slots = rewrite.m_slots;
+    fun->lex_epoch = lisp_lex_epoch;
+}
+
+LList *lisp_lex_check(LUserFunction *fun)
+{
+    for (LObject *l = fun->lex_locals; l; l = CDR(l))
+        if (((LSymbol *)CAR(l))->m_lex & LEX_FREE)
+        {
+            fun->lex_block = NULL; // for good, the symbol stays free
+            return NULL;
+        }
+
+    fun->lex_epoch = lisp_lex_epoch;
+    return fun->lex_block;
+}
+
+/* PtrRef check: OK */
+LObject *lisp_lex_call(LList *fun_arg_list, LList *arg_list,
+                       LList *block, int slots)
+{
+    LObject *ret = NULL;
+    PtrRef r1(fun_arg_list), r2(arg_list), r3(block);
+
+    // Arguments are evaluated in the caller's frame
+    long frame = l_user_stack.m_size;
+    int args = 0;
+    for (; fun_arg_list; fun_arg_list = (LList *)CDR(fun_arg_list), args++)
+    {
+        if (!arg_list)
+        {
+            lbreak("too few parameter to function\n");
+            exit(0);
+        }
+        l_user_stack.push(CAR(arg_list)->Eval());
+        arg_list = (LList *)CDR(arg_list);
+    }
+    // Extra arguments are ignored and never evaluated, as in
+    // EvalUserFunction
+    for (; args < slots; args++)
+        l_user_stack.push(NULL);
+
+    long old_frame = lisp_lex_frame;
+    lisp_lex_frame = frame;
+    for (; block; block = (LList *)CDR(block))
+        ret = CAR(block)->Eval();
+    lisp_lex_frame = old_frame;
+
+    l_user_stack.m_size = frame;
+    return ret;
+}
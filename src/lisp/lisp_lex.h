@@ -0,0 +1,63 @@
+/*
+ *  Abuse - dark 2D side-scrolling platform game
+ *  Copyright (c) 1995 Crack dot Com
+ *  Copyright (c) 2005-2011 Sam Hocevar <sam@hocevar.net>
+ *
+ *  This software was released into the Public Domain. As with most public
+ *  domain software, no warranty is made or implied by Crack dot Com, by
+ *  Jonathan Clark, or by Sam Hocevar.
+ */
+
+#ifndef __LISP_LEX_HPP_
+#define __LISP_LEX_HPP_
+
+#include "lisp.h"
+#include "lisp_gc.h"
+
+/*
+ * Lexical local variables.
+ *
+ * Abuse Lisp binds function arguments and let variables dynamically: the
+ * old symbol values are saved on l_user_stack, the new ones stored in the
+ * symbols and everything is put back on return. Most functions never let
+ * anybody else see their locals, so when a defun is evaluated its body is
+ * checked and, if it only uses forms we understand, a copy is made where
+ * every reference to an argument or let variable is an LLocalVar: an index
+ * into a frame of slots on l_user_stack.
+ *
+ * A symbol may only become a local if no code read so far uses it freely
+ * (outside of a function binding it), and was not known to the engine
+ * when lexical mode was turned on. If such a use shows up later, from a
+ * new defun, a level or the console, the functions relying on that symbol
+ * go back to dynamic binding before their next call.
+ */
+
+enum
+{
+    LEX_FREE = 1,  // referenced outside of a binding, must stay dynamic
+    LEX_LOCAL = 2, // used as a local by at least one function
+};
+
+void lisp_lex_enable();
+extern bool lisp_lex_enabled;
+
+// Called by the reader on each top-level form and by DEFUN on new functions
+void lisp_lex_toplevel(LObject *form);
+void lisp_lex_attach(LUserFunction *&fun);
+
+// Returns the function's lexical body if it is still valid, NULL otherwise
+LList *lisp_lex_check(LUserFunction *fun);
+LObject *lisp_lex_call(LList *fun_arg_list, LList *arg_list,
+                       LList *block, int slots);
+
+extern uint32_t lisp_lex_epoch; // bumped when a local becomes free
+extern long lisp_lex_frame;     // l_user_stack index of the current frame
+
+static inline LObject *&lisp_lex_slot(LObject *x)
+{
+    return *(LObject **)&l_user_stack.sdata[lisp_lex_frame
+                                            + ((LLocalVar *)x)->m_slot];
+}
+
+#endif
+
@@ -32,6 +32,8 @@
 #include "dev.h"
 #include "id.h"
 #include "demo.h"
+#include "level.h"
+#include "loadgame.h"
 
 //AR
 #include "sdlport/setup.h"
@@ -158,8 +160,31 @@ void get_savegame_name(char *buf)  // buf should be at least 50 bytes
   } else dprintf("Warning unable to open lastsave.lsp for writing\n"); */
 }
 
+// called once a background save is on disk, or failed to get there
+void save_game_done(char const *filename, int ok)
+{
+    if (!ok)
+        the_game->show_help("Unable to open file for saving\n");
+}
+
+void quick_save_done(char const *filename, int ok)
+{
+    if (!ok)
+    {
+        save_game_done(filename, ok);
+        return;
+    }
+
+    the_game->show_help("Station secured!");
+    cache.sfx(1031)->play(127);//id 1031 should be save05.wav
+    settings.quick_load = get_save_filename_prefix() ? get_save_filename_prefix() : "";
+    settings.quick_load += filename;
+}
+
 int show_load_icon()
 {
+    level_save_wait();
+
     int i;
     for( i = 0; i < MAX_SAVE_GAMES; i++ )
     {
@@ -193,6 +218,8 @@ int load_game(int show_all, char const *title)   // return 0 if the player escap
 
     image *first=NULL;
 
+    level_save_wait(); // the thumbnails should include a save still being written
+
     for (start_num=0; start_num<MAX_SAVE_GAMES; start_num++)
     {
         char name[255];
@@ -17,5 +17,7 @@ void get_savegame_name(char *buf);  // buf should be at least 50 bytes
 void last_savegame_name(char *buf);
 void load_number_icons();
 int get_save_spot();
+void save_game_done(char const *filename, int ok);
+void quick_save_done(char const *filename, int ok);
 
 #endif
@@ -41,11 +41,129 @@ typedef unsigned short ushort;
 
 file_manager *fman = NULL;
 
+// A small LZ77 coder in the spirit of LZF, for blocks of up to NFS_BLOCK
+// bytes. A control byte below 32 starts a run of ctrl + 1 literals; any
+// other is a copy of (ctrl >> 5) + 2 bytes (7 means an extra length byte
+// follows) from ((ctrl & 31) << 8 | next byte) + 1 bytes back.
+#define PACK_HASH_BITS 12
+
+static int pack_literals(uint8_t const *in, int len, uint8_t *out, int op, int out_max)
+{
+  while (len)
+  {
+    int n = len > 32 ? 32 : len;
+    if (op + 1 + n > out_max)
+      return -1;
+    out[op++] = n - 1;
+    memcpy(out + op, in, n);
+    op += n;
+    in += n;
+    len -= n;
+  }
+  return op;
+}
+
+// returns the packed size, or -1 if it would not fit in out_max bytes
+static int pack_block(uint8_t const *in, int len, uint8_t *out, int out_max)
+{
+  uint16_t table[1 << PACK_HASH_BITS]; // positions + 1, 0 is empty
+  memset(table, 0, sizeof(table));
+
+  int ip = 0, op = 0, lit = 0;
+  while (ip + 2 < len)
+  {
+    uint32_t h = (uint32_t)(in[ip] << 16 | in[ip + 1] << 8 | in[ip + 2]) * 2654435761u >> (32 - PACK_HASH_BITS);
+    int ref = table[h] - 1;
+    table[h] = ip + 1;
+
+    int off = ip - ref - 1;
+    if (ref < 0 || off >= 8192 || memcmp(in + ref, in + ip, 3))
+    {
+      ip++;
+      continue;
+    }
+
+    int most = len - ip < 264 ? len - ip : 264, n = 3;
+    while (n < most && in[ref + n] == in[ip + n])
+      n++;
+
+    op = pack_literals(in + lit, ip - lit, out, op, out_max);
+    if (op < 0 || op + 3 > out_max)
+      return -1;
+    if (n - 2 < 7)
+      out[op++] = (n - 2) << 5 | off >> 8;
+    else
+    {
+      out[op++] = 7 << 5 | off >> 8;
+      out[op++] = n - 2 - 7;
+    }
+    out[op++] = off & 0xff;
+
+    ip += n;
+    lit = ip;
+  }
+  return pack_literals(in + lit, len - lit, out, op, out_max);
+}
+
+// returns the unpacked size, or -1 if the data is damaged
+static int unpack_block(uint8_t const *in, int len, uint8_t *out, int out_max)
+{
+  int ip = 0, op = 0;
+  while (ip < len)
+  {
+    int ctrl = in[ip++];
+    if (ctrl < 32)
+    {
+      int n = ctrl + 1;
+      if (ip + n > len || op + n > out_max)
+        return -1;
+      memcpy(out + op, in + ip, n);
+      ip += n;
+      op += n;
+    }
+    else
+    {
+      int n = (ctrl >> 5) + 2;
+      if (n == 7 + 2)
+      {
+        if (ip >= len)
+          return -1;
+        n += in[ip++];
+      }
+      if (ip >= len)
+        return -1;
+      int ref = op - (((ctrl & 31) << 8 | in[ip++]) + 1);
+      if (ref < 0 || op + n > out_max)
+        return -1;
+      while (n--)
+        out[op++] = out[ref++];
+    }
+  }
+  return op;
+}
+
+// sockets may hand back less than asked for, keep reading until it's all here
+static int read_all(net_socket *sock, void *buf, int size)
+{
+  uint8_t *b = (uint8_t *)buf;
+  while (size > 0)
+  {
+    int got = sock->read(b, size);
+    if (got <= 0)
+      return 0;
+    b += got;
+    size -= got;
+  }
+  return 1;
+}
+
 file_manager::file_manager(int argc, char **argv, net_protocol *proto) : proto(proto)
 {
   default_fs = NULL;
   no_security = 0;
   nfs_list = NULL;
+  remote_list = NULL;
+  packed_reads = 0;
 
   int i;
   for (i = 1; i < argc; i++)
@@ -54,6 +172,8 @@ file_manager::file_manager(int argc, char **argv, net_protocol *proto) : proto(p
       fprintf(stderr, "Warning : Security measures bypassed (-bastard)\n");
       no_security = 1;
     }
+    else if (!strcmp(argv[i], "-compress")) // the file server must understand NFCMD_READ_PACKED
+      packed_reads = 1;
 }
 
 void file_manager::process_net()
@@ -100,6 +220,7 @@ int file_manager::process_nfs_command(nfs_client *c)
   switch (cmd)
   {
   case NFCMD_READ:
+  case NFCMD_READ_PACKED:
   {
     int32_t size;
     if (c->sock->read( /* client_read_size */ &size, sizeof(size)) != sizeof(size))
@@ -107,6 +228,7 @@ int file_manager::process_nfs_command(nfs_client *c)
     size = lltl(size);
 
     c->size_to_read = size;
+    c->packed = cmd == NFCMD_READ_PACKED;
     return c->send_read();
   }
   break;
@@ -153,20 +275,50 @@ int file_manager::nfs_client::send_read() // return 0 if failure on socket, not
     // first make sure the socket isn't 'full'
     if (sock->ready_to_write())
     {
-      char buf[READ_PACKET_SIZE];
-      short read_total;
-      short actual;
+      uint8_t buf[NFS_BLOCK + 4], raw[NFS_BLOCK];
+      int most = packed ? NFS_BLOCK : READ_PACKET_SIZE - 2;
+      int read_total;
+      int actual;
 
       do
       {
-        read_total = size_to_read > (READ_PACKET_SIZE - 2) ? (READ_PACKET_SIZE - 2) : size_to_read;
+        read_total = size_to_read > most ? most : size_to_read;
 
-        actual = read(file_fd, buf + 2, read_total);
-        ushort tmp = lstl(actual);
-        memcpy(buf, &tmp, sizeof(tmp));
+        int len;
+        if (packed) // the high bit of the size says the block is compressed
+        {
+          actual = read(file_fd, raw, read_total);
+          if (actual < 0)
+            actual = 0;
+          int packed_size = actual ? pack_block(raw, actual, buf + 4, actual - 1) : -1;
+          if (packed_size > 0)
+          {
+            ushort tmp = lstl(0x8000 | packed_size);
+            memcpy(buf, &tmp, sizeof(tmp));
+            tmp = lstl(actual);
+            memcpy(buf + 2, &tmp, sizeof(tmp));
+            len = packed_size + 4;
+          }
+          else
+          {
+            ushort tmp = lstl(actual);
+            memcpy(buf, &tmp, sizeof(tmp));
+            memcpy(buf + 2, raw, actual);
+            len = actual + 2;
+          }
+        }
+        else
+        {
+          actual = read(file_fd, buf + 2, read_total);
+          if (actual < 0)
+            actual = 0;
+          ushort tmp = lstl(actual);
+          memcpy(buf, &tmp, sizeof(tmp));
+          len = actual + 2;
+        }
 
-        int write_amount = sock->write( /* server_read_data */ buf, actual + 2);
-        if (write_amount != actual + 2)
+        int write_amount = sock->write( /* server_read_data */ buf, len);
+        if (write_amount != len)
         {
           fprintf(stderr, "write failed\n");
           return 0;
@@ -236,7 +388,7 @@ void file_manager::secure_filename(char *filename, char *mode)
   }
 }
 
-file_manager::nfs_client::nfs_client(net_socket *sock, int file_fd, nfs_client *next) : sock(sock), file_fd(file_fd), next(next), size_to_read(0)
+file_manager::nfs_client::nfs_client(net_socket *sock, int file_fd, nfs_client *next) : sock(sock), file_fd(file_fd), next(next), size_to_read(0), packed(0)
 {
   sock->read_selectable();
 }
@@ -340,10 +492,17 @@ void file_manager::remote_file::r_close(char const *reason)
   }
 }
 
-file_manager::remote_file::remote_file(net_socket *sock, char const *filename, char const *mode, remote_file *Next) : sock(sock)
+file_manager::remote_file::remote_file(net_socket *sock, char const *filename, char const *mode, int packed, remote_file *Next) : sock(sock), packed(packed)
 {
   next = Next;
   open_local = 0;
+  size = 0;
+  eof = 0;
+  pos = asked = 0;
+  window = NFS_MIN_WINDOW;
+  reply_got = 0;
+  replies = 0;
+  block_pos = block_len = 0;
 
   uint8_t sizes[3] = {CLIENT_NFS, static_cast<uint8_t>(strlen(filename) + 1), static_cast<uint8_t>(strlen(mode) + 1)};
 
@@ -363,8 +522,14 @@ file_manager::remote_file::remote_file(net_socket *sock, char const *filename, c
     return;
   }
 
+  // ask for the start of the file right away, it arrives behind the size
+  if (strchr(mode, 'r'))
+    request(NFS_MIN_WINDOW);
+  if (!sock)
+    return;
+
   int32_t remote_file_fd;
-  if (sock->read( /* server_nfs_fd */ &remote_file_fd, sizeof(remote_file_fd)) != sizeof(remote_file_fd))
+  if (!read_all( /* server_nfs_fd */ sock, &remote_file_fd, sizeof(remote_file_fd)))
   {
     r_close("could not read remote fd");
     return;
@@ -376,117 +541,204 @@ file_manager::remote_file::remote_file(net_socket *sock, char const *filename, c
     return;
   }
 
-  if (sock->read( /* server_nfs_filesize */ &size, sizeof(size)) != sizeof(size))
+  if (!read_all( /* server_nfs_filesize */ sock, &size, sizeof(size)))
   {
     r_close("could not read remote filesize");
     return;
   }
 
   size = lltl(size);
+  request_more();
 }
 
-int file_manager::remote_file::unbuffered_read(void *buffer, size_t count)
+void file_manager::remote_file::request(int32_t count)
 {
-  if (sock && count)
+  uint8_t cmd = packed ? NFCMD_READ_PACKED : NFCMD_READ;
+  if (sock->write( /* client_nfs_command */ &cmd, sizeof(cmd)) != sizeof(cmd))
   {
-    uint8_t cmd = NFCMD_READ;
-    if (sock->write( /* client_nfs_command */ &cmd, sizeof(cmd)) != sizeof(cmd))
-    {
-      r_close("read : could not send command");
-      return 0;
-    }
+    r_close("read : could not send command");
+    return;
+  }
 
-    int32_t rsize = lltl(count);
-    if (sock->write( /* client_read_size */ &rsize, sizeof(rsize)) != sizeof(rsize))
-    {
-      r_close("read : could not send size");
-      return 0;
-    }
+  int32_t rsize = lltl(count);
+  if (sock->write( /* client_read_size */ &rsize, sizeof(rsize)) != sizeof(rsize))
+  {
+    r_close("read : could not send size");
+    return;
+  }
 
-    int32_t total_read = 0;
-    char buf[READ_PACKET_SIZE];
+  reply_size[replies++] = count;
+  asked += count;
+  window = window * 2 > NFS_MAX_WINDOW ? NFS_MAX_WINDOW : window * 2;
+}
 
-    ushort packet_size;
-    do
-    {
-      if (sock->read( /* server_read_size */ &packet_size, sizeof(packet_size)) != sizeof(packet_size))
-      {
-        fprintf(stderr, "could not read packet size\n");
-        return 0;
-      }
+void file_manager::remote_file::request_more() // keep reads in flight while the caller works
+{
+  while (sock && !eof && replies < NFS_REQUESTS && asked < size && asked - pos < NFS_READ_AHEAD)
+    request(size - asked < window ? size - asked : window);
+}
 
-      packet_size = lstl(packet_size);
+int file_manager::remote_file::receive_block() // return 0 if the connection broke
+{
+  if (!replies)
+    return 0;
 
-      ushort size_read = sock->read( /* server_read_data */ buf, packet_size);
+  ushort packet_size, raw_size;
+  if (!read_all( /* server_read_size */ sock, &packet_size, sizeof(packet_size)))
+    return 0;
+  packet_size = lstl(packet_size);
 
-      if (size_read != packet_size)
-      {
-        if (sock->read( /* server_read_data */ buf + 2 + size_read, packet_size - size_read) != packet_size - size_read)
-        {
-          fprintf(stderr, "incomplete packet\n");
-          return 0;
-        }
-      }
+  if (packet_size & 0x8000)
+  {
+    uint8_t buf[NFS_BLOCK];
+    packet_size &= 0x7fff;
+    if (!packed || packet_size > NFS_BLOCK)
+      return 0;
+    if (!read_all( /* server_read_size */ sock, &raw_size, sizeof(raw_size)))
+      return 0;
+    raw_size = lstl(raw_size);
+    if (!read_all( /* server_read_data */ sock, buf, packet_size))
+      return 0;
+    if (unpack_block(buf, packet_size, block, NFS_BLOCK) != raw_size)
+      return 0;
+  }
+  else
+  {
+    raw_size = packet_size;
+    if (raw_size > NFS_BLOCK || !read_all( /* server_read_data */ sock, block, raw_size))
+      return 0;
+  }
 
-      memcpy(buffer, buf, packet_size);
-      buffer = (void *)(((char *)buffer) + packet_size);
+  // a reply ends once it is filled, or with a short block at the end of the file
+  int32_t left = reply_size[0] - reply_got;
+  int32_t most = packed ? NFS_BLOCK : READ_PACKET_SIZE - 2;
+  if (most > left)
+    most = left;
+  if (raw_size > most)
+    return 0;
 
-      total_read += packet_size;
-      count -= packet_size;
-    } while (packet_size == READ_PACKET_SIZE - 2 && count);
-    return total_read;
+  reply_got += raw_size;
+  if (raw_size < most)
+    eof = 1;
+  if (raw_size < most || reply_got == reply_size[0])
+  {
+    replies--;
+    memmove(reply_size, reply_size + 1, replies * sizeof(reply_size[0]));
+    reply_got = 0;
   }
-  return 0;
+
+  block_pos = 0;
+  block_len = raw_size;
+  return 1;
 }
 
-int32_t file_manager::remote_file::unbuffered_tell() // ask server where the offset of the file pointer is
+int file_manager::remote_file::unbuffered_read(void *buffer, size_t count)
 {
-  if (sock)
+  int32_t total_read = 0;
+  uint8_t *out = (uint8_t *)buffer;
+
+  while (sock && count)
   {
-    uint8_t cmd = NFCMD_TELL;
-    if (sock->write( /* client_nfs_command */ &cmd, sizeof(cmd)) != sizeof(cmd))
+    if (block_pos < block_len)
     {
-      r_close("tell : could not send command");
-      return 0;
+      int32_t n = block_len - block_pos;
+      if ((size_t)n > count)
+        n = count;
+      memcpy(out, block + block_pos, n);
+      block_pos += n;
+      pos += n;
+      out += n;
+      total_read += n;
+      count -= n;
+      continue;
     }
 
-    int32_t offset;
-    if (sock->read( /* server_tell_response */ &offset, sizeof(offset)) != sizeof(offset))
+    request_more();
+    if (!sock || !replies) // end of file
+      break;
+    if (!receive_block())
     {
-      r_close("tell : could not read offset");
-      return 0;
+      r_close("read : lost the connection");
+      break;
     }
-    return lltl(offset);
   }
-  return 0;
+
+  request_more();
+  return total_read;
+}
+
+int32_t file_manager::remote_file::unbuffered_tell() // we keep track of where the caller is
+{
+  return pos;
 }
 
 int32_t file_manager::remote_file::unbuffered_seek(int32_t offset) // tell server to seek to a spot in a file
 {
-  if (sock)
+  if (!sock)
+    return 0;
+
+  // a short hop forward is already on its way, skip through it
+  if (offset >= pos && offset <= asked)
   {
-    uint8_t cmd = NFCMD_SEEK;
-    if (sock->write( /* client_nfs_command */ &cmd, sizeof(cmd)) != sizeof(cmd))
+    while (pos < offset)
     {
-      r_close("seek : could not send command");
-      return 0;
+      if (block_pos < block_len)
+      {
+        int32_t n = block_len - block_pos;
+        if (n > offset - pos)
+          n = offset - pos;
+        block_pos += n;
+        pos += n;
+      }
+      else if (!replies)
+        break;
+      else if (!receive_block())
+      {
+        r_close("seek : lost the connection");
+        return 0;
+      }
     }
-
-    int32_t off = lltl(offset);
-    if (sock->write( /* client_seek_offset */ &off, sizeof(off)) != sizeof(off))
+    if (pos == offset)
     {
-      r_close("seek : could not send offset");
-      return 0;
+      request_more();
+      return pos;
     }
+  }
 
-    if (sock->read( /* server_seek_response */ &offset, sizeof(offset)) != sizeof(offset))
+  // otherwise let the reads in flight land before moving the server
+  while (replies)
+    if (!receive_block())
     {
-      r_close("seek : could not read offset");
+      r_close("seek : lost the connection");
       return 0;
     }
-    return lltl(offset);
+
+  uint8_t cmd = NFCMD_SEEK;
+  if (sock->write( /* client_nfs_command */ &cmd, sizeof(cmd)) != sizeof(cmd))
+  {
+    r_close("seek : could not send command");
+    return 0;
   }
-  return 0;
+
+  int32_t off = lltl(offset);
+  if (sock->write( /* client_seek_offset */ &off, sizeof(off)) != sizeof(off))
+  {
+    r_close("seek : could not send offset");
+    return 0;
+  }
+
+  if (!read_all( /* server_seek_response */ sock, &offset, sizeof(offset)))
+  {
+    r_close("seek : could not read offset");
+    return 0;
+  }
+
+  pos = asked = lltl(offset);
+  block_pos = block_len = 0;
+  eof = 0;
+  window = NFS_MIN_WINDOW;
+  request_more();
+  return pos;
 }
 
 file_manager::remote_file::~remote_file()
@@ -523,7 +775,7 @@ int file_manager::rf_open_file(char const *&filename, char const *mode)
       return -1;
     }
 
-    remote_file *rf = new remote_file(sock, filename, mode, remote_list);
+    remote_file *rf = new remote_file(sock, filename, mode, packed_reads, remote_list);
     if (rf->open_failure())
     {
       delete rf;
@@ -578,9 +830,9 @@ int file_manager::rf_open_file(char const *&filename, char const *mode)
 file_manager::remote_file *file_manager::find_rf(int fd)
 {
   remote_file *r = remote_list;
-  for (; r && r->sock->get_fd() != fd; r = r->next)
+  for (; r && r->fd() != fd; r = r->next)
   {
-    if (r->sock->get_fd() == -1)
+    if (r->fd() == -1)
     {
       fprintf(stderr, "bad sock\n");
     }
@@ -622,8 +874,11 @@ int file_manager::rf_read(int fd, void *buffer, size_t count)
 int file_manager::rf_close(int fd)
 {
   remote_file *rf = remote_list, *last = NULL;
-  while (rf && rf->sock->get_fd() != fd)
+  while (rf && rf->fd() != fd)
+  {
+    last = rf;
     rf = rf->next;
+  }
   if (rf)
   {
     if (last)
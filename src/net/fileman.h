@@ -8,11 +8,21 @@
 #include <stdlib.h>
 #include <string.h>
 
+// Remote reads are pipelined: a client keeps up to NFS_REQUESTS reads in
+// flight, each window doubling from NFS_MIN_WINDOW to NFS_MAX_WINDOW while
+// the file is read in order, so a transfer streams instead of paying one
+// round trip per buffer. Compressed replies come in blocks of NFS_BLOCK.
+#define NFS_BLOCK      4096
+#define NFS_MIN_WINDOW 8192
+#define NFS_MAX_WINDOW 65536
+#define NFS_READ_AHEAD 131072
+#define NFS_REQUESTS   8
 
 class file_manager
 {
   net_address *default_fs;
   int no_security;
+  int packed_reads;
 
   class nfs_client
   {
@@ -23,6 +33,7 @@ class file_manager
     nfs_client *next;
     int32_t size_to_read;
     int32_t size;
+    int packed;          // the reply being sent is compressed
     nfs_client(net_socket *sock, int file_fd, nfs_client *next);
     int send_read();     // flushes as much of size_to_read as possible
     ~nfs_client();
@@ -37,7 +48,21 @@ class file_manager
     int32_t size;   // server tells us the size of the file when we open it
     int open_local;
     remote_file *next;
-    remote_file(net_socket *sock, char const *filename, char const *mode, remote_file *Next);
+    remote_file(net_socket *sock, char const *filename, char const *mode, int packed, remote_file *Next);
+
+    int packed;                        // ask for compressed replies
+    int eof;                           // a reply came back short
+    int32_t pos, asked;                // offsets of the caller and of the last byte asked for
+    int32_t window;
+    int32_t reply_size[NFS_REQUESTS];  // reads still in flight, oldest first
+    int32_t reply_got;
+    int replies;
+    uint8_t block[NFS_BLOCK];          // the last block received, from block_pos on
+    int block_pos, block_len;
+
+    void request(int32_t count);
+    void request_more();
+    int receive_block();
 
     int unbuffered_read(void *buffer, size_t count);
     int unbuffered_write(void const *buf, size_t count) { return 0; } // not supported
@@ -29,6 +29,7 @@
 #include "gclient.h"
 #include "netface.h"
 #include "timing.h"
+#include "netstat.h"
 
 extern base_memory_struct *base;
 extern net_socket *comm_sock, *game_sock;
@@ -47,6 +48,7 @@ int game_client::process_server_command()
     DEBUG_LOG("Failed to read command byte from server");
     return 0;
   }
+  netstat_bytes_in(1);
 
   DEBUG_LOG("Received command %d from server", cmd);
 
@@ -71,31 +73,21 @@ int game_client::process_server_command()
       DEBUG_LOG("Failed to read tick number for resend request");
       return 0;
     }
+    netstat_bytes_in(1);
+    netstat_resend_served(0); // the server is client 0
 
-    fprintf(stderr, "request for resend tick %d (game cur=%d, pack=%d, last=%d)\n",
-            tick, base->current_tick, base->packet.tick_received(), base->last_packet.tick_received());
-
-    // Only resend if we have the requested tick and haven't sent new input
-    if (tick == base->packet.tick_received() && !wait_local_input)
+    // Only resend if we still have our input for that tick
+    int slot = tick & (NET_TICK_RING - 1);
+    if (sent_tick[slot] == tick)
     {
-      DEBUG_LOG("Resending packet %d to server", base->packet.tick_received());
-      net_packet *pack = &base->packet;
+      DEBUG_LOG("Resending packet %d to server", tick);
+      net_packet *pack = &sent[slot];
       game_sock->write( /* client_input_data */ pack->data, pack->packet_size() + pack->packet_prefix_size(), server_data_port);
-
-      // Add artificial delay after resend
-      {
-        time_marker now, start;
-        while (now.diff_time(&start) < 3.0)
-          now.get_time();
-      }
-    }
-    else if (tick == base->last_packet.tick_received())
-    {
-      DEBUG_LOG("Resending last packet to server");
+      netstat_bytes_out(pack->packet_size() + pack->packet_prefix_size());
     }
     else
     {
-      DEBUG_LOG("Skipping resend - tick mismatch or new input pending");
+      DEBUG_LOG("Skipping resend - input for tick %d not sent yet or gone", tick);
     }
     return 1;
   }
@@ -128,6 +120,7 @@ int game_client::process_net()
     net_packet tmp;
 
     int bytes_received = game_sock->read( /* server_game_state */ tmp.data, PACKET_MAX_SIZE);
+    netstat_bytes_in(bytes_received);
     DEBUG_LOG("Received %d bytes of game data", bytes_received);
 
     if (bytes_received == tmp.packet_size() + tmp.packet_prefix_size())
@@ -135,13 +128,23 @@ int game_client::process_net()
       uint16_t rec_crc = tmp.get_checksum();
       if (rec_crc == tmp.calc_checksum())
       {
-        if (base->current_tick == tmp.tick_received())
+        uint8_t ahead = tmp.tick_received() - base->current_tick;
+        if (!ahead && base->input_state == INPUT_COLLECTING)
         {
           DEBUG_LOG("Valid game packet received for current tick %d", base->current_tick);
           base->packet = tmp;
-          wait_local_input = 1;
+          netstat_state_received(tmp.tick_received());
           base->input_state = INPUT_PROCESSING;
         }
+        else if (ahead && ahead < NET_TICK_RING)
+        {
+          DEBUG_LOG("Keeping game packet for tick %d, engine is at %d",
+                    tmp.tick_received(), base->current_tick);
+          int slot = tmp.tick_received() & (NET_TICK_RING - 1);
+          early[slot] = tmp;
+          early_tick[slot] = tmp.tick_received();
+          netstat_state_received(tmp.tick_received());
+        }
         else
         {
           DEBUG_LOG("Received stale packet - got tick %d, expected %d",
@@ -173,7 +176,6 @@ int game_client::process_net()
       start_running = 0;
       strcpy(lsf, "abuse.lsp");
 
-      wait_local_input = 1;
       base->input_state = INPUT_PROCESSING;
       return 0;
     }
@@ -188,7 +190,15 @@ game_client::game_client(net_socket *client_sock, net_address *server_addr) : cl
   DEBUG_LOG("Creating new game client");
   server_data_port = server_addr->copy();
   client_sock->read_selectable();
-  wait_local_input = 1;
+  reset_ticks();
+}
+
+// Drop the inputs and game states kept from before a reload
+void game_client::reset_ticks()
+{
+  for (int i = 0; i < NET_TICK_RING; i++)
+    sent_tick[i] = early_tick[i] = -1;
+  netstat_reset_ticks();
 }
 
 // Called when input from server is missing/late
@@ -197,10 +207,10 @@ int game_client::input_missing()
   DEBUG_LOG("Handling missing input");
 
   if (prot->debug_level(net_protocol::DB_IMPORTANT_EVENT))
-    fprintf(stderr, "(resending %d)\n", base->packet.tick_received());
+    fprintf(stderr, "(resending %d)\n", base->current_tick);
 
   uint8_t cmd = CLCMD_REQUEST_RESEND;
-  uint8_t tick = base->packet.tick_received();
+  uint8_t tick = base->current_tick;
 
   // Send resend request to server
   if (client_sock->write( /* client_command */ &cmd, 1) != 1 ||
@@ -209,29 +219,52 @@ int game_client::input_missing()
     DEBUG_LOG("Failed to send resend request");
     return 0;
   }
+  netstat_bytes_out(2);
+  netstat_resend_requested();
 
   DEBUG_LOG("Sent resend request for tick %d", tick);
   return 1;
 }
 
-// Add local input to be sent to server
-void game_client::add_engine_input()
+// Send local input for a tick to the server
+void game_client::send_engine_input(net_packet *pack)
 {
   if (base->input_state == INPUT_RELOAD)
   {
-    DEBUG_LOG("Skipping input collection - reload in progress");
+    DEBUG_LOG("Skipping input - reload in progress");
     return;
   }
-  DEBUG_LOG("Adding engine input for tick %d", base->current_tick);
 
-  net_packet *pack = &base->packet;
-  base->input_state = INPUT_COLLECTING;
-  wait_local_input = 0;
-  pack->set_tick_received(base->current_tick);
+  DEBUG_LOG("Sending input packet (tick %d) to server", pack->tick_received());
+  int slot = pack->tick_received() & (NET_TICK_RING - 1);
+  sent[slot] = *pack;
+  sent_tick[slot] = pack->tick_received();
+  pack = &sent[slot];
   pack->calc_checksum();
 
-  DEBUG_LOG("Sending input packet (tick %d) to server", base->current_tick);
   game_sock->write( /* client_input_data */ pack->data, pack->packet_size() + pack->packet_prefix_size(), server_data_port);
+  netstat_bytes_out(pack->packet_size() + pack->packet_prefix_size());
+  netstat_input_sent(pack->tick_received());
+}
+
+// Wait for the game state of base->current_tick, unless it already came in
+void game_client::add_engine_input()
+{
+  if (base->input_state == INPUT_RELOAD)
+  {
+    DEBUG_LOG("Skipping input collection - reload in progress");
+    return;
+  }
+
+  int slot = base->current_tick & (NET_TICK_RING - 1);
+  if (early_tick[slot] == base->current_tick)
+  {
+    base->packet = early[slot];
+    early_tick[slot] = -1;
+    base->input_state = INPUT_PROCESSING;
+  }
+  else
+    base->input_state = INPUT_COLLECTING;
 }
 
 // Notify server that level reload is complete
@@ -260,11 +293,18 @@ int game_client::start_reload()
     return 0;
   }
 
-  if (client_sock->read( /* server_reload_ack */ &cmd, 1) != 1)
+  // The server may still be asking for inputs from before the reload
+  uint8_t tick;
+  do
   {
-    DEBUG_LOG("Failed to receive reload acknowledgement");
-    return 0;
-  }
+    if (client_sock->read( /* server_reload_ack */ &cmd, 1) != 1 ||
+        (cmd == SRVCMD_REQUEST_RESEND && client_sock->read( /* server_resend_request_tick */ &tick, 1) != 1))
+    {
+      DEBUG_LOG("Failed to receive reload acknowledgement");
+      return 0;
+    }
+  } while (cmd != SRVCMD_RELOAD_START_OK);
+  reset_ticks();
 
   DEBUG_LOG("Reload process initiated successfully");
   return 1;
@@ -24,10 +24,17 @@ class game_client : public game_handler
 {
 private:
   net_socket *client_sock;       // Socket for reliable TCP communication with server
-  int wait_local_input;          // Flag indicating if waiting for local player input
   int process_server_command();  // Processes control commands from server
   net_address *server_data_port; // Server's address/port for game state data
 
+  // Our inputs may be sent a few ticks ahead, and game states can arrive
+  // before the engine needs them; both are kept by tick slot, -1 if empty
+  net_packet sent[NET_TICK_RING];
+  int sent_tick[NET_TICK_RING];
+  net_packet early[NET_TICK_RING];
+  int early_tick[NET_TICK_RING];
+  void reset_ticks();
+
 public:
   // Constructor - initializes client connection to server
   game_client(net_socket *client_sock, net_address *server_addr);
@@ -38,7 +45,10 @@ public:
   // Called when expected input from server hasn't arrived
   int input_missing();
 
-  // Adds local player's input to be sent to server
+  // Sends local player's input for a tick to the server
+  void send_engine_input(net_packet *pack);
+
+  // Waits for the game state of the tick the engine plays next
   void add_engine_input();
 
   // Initiates level reload process with server
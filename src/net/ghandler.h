@@ -14,6 +14,7 @@ class game_handler     // game_client and game_serevr are derived from here
 {
   public :
   virtual int process_net()      { return 1; }     // return 0 if net-shutdown need to happen
+  virtual void send_engine_input(net_packet *pack) { ; } // input for tick pack->tick_received()
   virtual void add_engine_input() { base->input_state=INPUT_PROCESSING; }
   virtual int input_missing()    { return 1; }  // request input re-send  ( return 0 if net-shutdown needs to happen)
   virtual int start_reload()      { return 1; }
@@ -22,6 +23,7 @@ class game_handler     // game_client and game_serevr are derived from here
   virtual int kill_slackers()     { return 1; }
   virtual int quit()              { return 1; }  // should disconnect from everone and close all sockets
   virtual void game_start_wait()  { ; }
+  virtual int total_players()     { return 1; }
   virtual ~game_handler()         { ; }
 } ;
 
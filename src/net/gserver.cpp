@@ -28,6 +28,7 @@
 #include "gserver.h"
 #include "netface.h"
 #include "timing.h"
+#include "netstat.h"
 #include "netcfg.h"
 #include "id.h"
 #include "jwindow.h"
@@ -46,8 +47,9 @@ game_server::game_server()
 {
   DEBUG_LOG("Initializing game server");
   player_list = NULL;
-  waiting_server_input = 1;
   reload_state = 0;
+  total_deleted = 0;
+  reset_ticks();
 }
 
 int game_server::total_players()
@@ -118,114 +120,229 @@ game_server::player_client::~player_client()
   delete data_address;
 }
 
-// Check if all players have submitted input for current tick
+// Forget every tick collected or sent, the engine's next input opens one again
+void game_server::reset_ticks()
+{
+  next_tick = -1;
+  got_server_input = 0;
+  for (int i = 0; i < NET_TICK_RING; i++)
+    slot_tick[i] = sent_tick[i] = -1;
+  for (player_client *c = player_list; c; c = c->next)
+    c->got_input = 0;
+  netstat_reset_ticks();
+}
+
+// Returns the slot collecting a tick, -1 if its game state was already sent
+// or it is too far ahead
+int game_server::open_slot(int tick)
+{
+  if (next_tick < 0 || (uint8_t)(tick - next_tick) >= NET_TICK_RING)
+    return -1;
+
+  int slot = tick & (NET_TICK_RING - 1);
+  if (slot_tick[slot] != tick)
+  {
+    slot_tick[slot] = tick;
+    got_server_input &= ~(1u << slot);
+    for (player_client *c = player_list; c; c = c->next)
+      c->got_input &= ~(1u << slot);
+  }
+  return slot;
+}
+
+int game_server::missing_input(player_client *c, int tick)
+{
+  int slot = tick & (NET_TICK_RING - 1);
+  return c->has_joined() && !c->delete_me() &&
+         (slot_tick[slot] != tick || !(c->got_input & (1u << slot)));
+}
+
+// Remove the clients that left, then send out every tick we have all inputs
+// for, in order
 void game_server::check_collection_complete()
 {
   DEBUG_LOG("Checking input collection status");
 
-  player_client *c;
-  int got_all = waiting_server_input == 0;
-  int add_deletes = 0;
-
-  // Check for deleted clients and missing input
-  for (c = player_list; c && got_all; c = c->next)
+  player_client *c, *last = NULL;
+  for (c = player_list; c;)
   {
     if (c->delete_me())
     {
-      add_deletes = 1;
-      DEBUG_LOG("Client %d marked for deletion", c->client_id);
+      DEBUG_LOG("Removing client %d", c->client_id);
+      if (total_deleted < MAX_JOINERS)
+        deleted[total_deleted++] = c->client_id;
+      netstat_client_gone(c->client_id);
+
+      if (c->wait_reload())
+      {
+        c->set_wait_reload(0);
+        check_reload_wait();
+      }
+
+      if (last)
+        last->next = c->next;
+      else
+        player_list = c->next;
+      player_client *d = c;
+      c = c->next;
+      delete d;
     }
-    else if (c->has_joined() && c->wait_input())
+    else
     {
-      got_all = 0;
-      DEBUG_LOG("Still waiting for input from client %d", c->client_id);
+      last = c;
+      c = c->next;
     }
   }
 
-  if (got_all)
+  while (next_tick >= 0)
   {
-    DEBUG_LOG("All clients have submitted input, moving on");
-  }
+    int slot = next_tick & (NET_TICK_RING - 1);
+    if (slot_tick[slot] != next_tick || !(got_server_input & (1u << slot)))
+      return;
 
-  // Remove deleted clients
-  if (add_deletes)
-  {
-    DEBUG_LOG("Processing client deletions");
-    player_client *last = NULL;
-    for (c = player_list; c;)
+    for (c = player_list; c; c = c->next)
     {
-      if (c->delete_me())
+      if (missing_input(c, next_tick))
       {
-        base->packet.write_uint8(SCMD_DELETE_CLIENT);
-        base->packet.write_uint8(c->client_id);
-        DEBUG_LOG("Removing client %d", c->client_id);
-
-        if (c->wait_reload())
-        {
-          c->set_wait_reload(0);
-          check_reload_wait();
-        }
-
-        if (last)
-          last->next = c->next;
-        else
-          player_list = c->next;
-        player_client *d = c;
-        c = c->next;
-        delete d;
-      }
-      else
-      {
-        last = c;
-        c = c->next;
+        DEBUG_LOG("Still waiting for input from client %d", c->client_id);
+        return;
       }
     }
+
+    send_game_state(next_tick);
+    next_tick = (next_tick + 1) & 0xff;
+  }
+}
+
+// Put together the inputs for a tick and send them to every client, and to
+// the engine if it is waiting for them
+void game_server::send_game_state(int tick)
+{
+  DEBUG_LOG("Got all inputs for tick %d, broadcasting game state", tick);
+  int slot = tick & (NET_TICK_RING - 1);
+  net_packet *pack = &sent[slot];
+  player_client *c;
+
+  *pack = server_input[slot];
+  for (c = player_list; c; c = c->next)
+  {
+    if (c->has_joined())
+      pack->add_to_packet(c->input[slot].packet_data(), c->input[slot].packet_size());
   }
 
-  // If we have all inputs, send packet to all clients
-  if (got_all)
+  for (int i = 0; i < total_deleted; i++)
   {
-    DEBUG_LOG("Got all client inputs, broadcasting game state");
-    base->packet.calc_checksum();
+    pack->write_uint8(SCMD_DELETE_CLIENT);
+    pack->write_uint8(deleted[i]);
+  }
+  total_deleted = 0;
 
-    for (c = player_list; c; c = c->next)
+  pack->set_tick_received(tick);
+  pack->calc_checksum();
+  sent_tick[slot] = tick;
+  slot_tick[slot] = -1;
+
+  for (c = player_list; c; c = c->next)
+  {
+    if (c->has_joined())
     {
-      if (c->has_joined())
-      {
-        c->set_wait_input(1);
-        game_sock->write( /* server_game_state */ base->packet.data,
-                                 base->packet.packet_size() + base->packet.packet_prefix_size(),
-                                 c->data_address);
-        DEBUG_LOG("Sent state to client %d", c->client_id);
-      }
+      game_sock->write( /* server_game_state */ pack->data,
+                               pack->packet_size() + pack->packet_prefix_size(),
+                               c->data_address);
+      DEBUG_LOG("Sent state to client %d", c->client_id);
+      netstat_bytes_out(pack->packet_size() + pack->packet_prefix_size());
     }
+  }
+  netstat_broadcast();
 
+  if (base->input_state == INPUT_COLLECTING && base->current_tick == tick)
+  {
+    base->packet = *pack;
     base->input_state = INPUT_PROCESSING; // tell engine to start processing
-    game_sock->read_unselectable();       // don't listen to this socket until we are prepared to read next tick's game data
-    waiting_server_input = 1;
-    DEBUG_LOG("Processing state complete");
   }
 }
 
-// Add server's own input to the game state
-void game_server::add_engine_input()
+// Send a game state again to a client that did not get it
+void game_server::resend_game_state(int tick, player_client *c)
+{
+  int slot = tick & (NET_TICK_RING - 1);
+  if (sent_tick[slot] != tick)
+  {
+    DEBUG_LOG("Tick %d not resent to client %d, it is gone", tick, c->client_id);
+    return;
+  }
+
+  net_packet *pack = &sent[slot];
+  game_sock->write( /* server_game_state */ pack->data,
+                           pack->packet_size() + pack->packet_prefix_size(),
+                           c->data_address);
+  netstat_bytes_out(pack->packet_size() + pack->packet_prefix_size());
+}
+
+// Add the server's own input for a tick, which may be ahead of the one the
+// engine plays next
+void game_server::send_engine_input(net_packet *pack)
 {
-  DEBUG_LOG("Adding server engine input for tick %d", base->current_tick);
-  waiting_server_input = 0;
-  base->input_state = INPUT_COLLECTING;
-  base->packet.set_tick_received(base->current_tick);
-  game_sock->read_selectable(); // we can listen for game data now that we have server input
+  DEBUG_LOG("Adding server engine input for tick %d", pack->tick_received());
+  if (next_tick < 0)
+  {
+    next_tick = pack->tick_received();
+
+    // Clients that sent their input while we were not ready have to send it again
+    uint8_t cmd[2] = { SRVCMD_REQUEST_RESEND, (uint8_t)next_tick };
+    for (player_client *c = player_list; c; c = c->next)
+    {
+      if (c->has_joined() && !c->delete_me() && c->comm->write( /* server_command */ cmd, 2) != 2)
+        c->set_delete_me(1);
+    }
+  }
+
+  int slot = open_slot(pack->tick_received());
+  if (slot < 0)
+  {
+    DEBUG_LOG("Server input for tick %d is out of the window", pack->tick_received());
+    return;
+  }
+  server_input[slot] = *pack;
+  got_server_input |= 1u << slot;
+  netstat_input_sent(pack->tick_received());
   check_collection_complete();
 }
 
+// The engine has sent its input and now waits for the game state of
+// base->current_tick, which may have been sent already
+void game_server::add_engine_input()
+{
+  int slot = base->current_tick & (NET_TICK_RING - 1);
+  if (sent_tick[slot] == base->current_tick)
+  {
+    base->packet = sent[slot];
+    base->input_state = INPUT_PROCESSING;
+  }
+  else
+    base->input_state = INPUT_COLLECTING;
+}
+
 // Add input from a client to the game state
-void game_server::add_client_input(char *buf, int size, player_client *c)
+void game_server::add_client_input(net_packet *pack, player_client *c)
 {
-  if (c->wait_input()) // don't add if we already have it
+  int tick = pack->tick_received();
+  int slot = open_slot(tick);
+
+  if (slot < 0)
+  {
+    // The client probably missed the game state and sent its input again
+    DEBUG_LOG("Input from client %d for tick %d already sent", c->client_id, tick);
+    if (next_tick >= 0 && (uint8_t)(next_tick - tick) <= NET_TICK_RING)
+      resend_game_state(tick, c);
+  }
+  else if (!(c->got_input & (1u << slot))) // don't add if we already have it
   {
-    DEBUG_LOG("Adding input from client %d, size %d bytes", c->client_id, size);
-    base->packet.add_to_packet(buf, size);
-    c->set_wait_input(0);
+    DEBUG_LOG("Adding input from client %d for tick %d, size %d bytes", c->client_id,
+              tick, pack->packet_size());
+    c->input[slot] = *pack;
+    c->got_input |= 1u << slot;
+    netstat_client_input(c->client_id, tick);
     check_collection_complete();
   }
   else
@@ -260,6 +377,7 @@ int game_server::process_client_command(player_client *c)
     DEBUG_LOG("Failed to read command from client %d", c->client_id);
     return 0;
   }
+  netstat_bytes_in(1);
 
   DEBUG_LOG("Processing command %d from client %d", cmd, c->client_id);
 
@@ -273,20 +391,25 @@ int game_server::process_client_command(player_client *c)
       DEBUG_LOG("Failed to read tick for resend request");
       return 0;
     }
+    netstat_bytes_in(1);
+    netstat_resend_served(c->client_id);
 
     DEBUG_LOG("Client %d requested resend of tick %d", c->client_id, tick);
 
-    if (tick == base->last_packet.tick_received())
+    int slot = tick & (NET_TICK_RING - 1);
+    if (sent_tick[slot] == tick)
     {
-      DEBUG_LOG("Resending last packet to client %d", c->client_id);
-      net_packet *pack = &base->last_packet;
-      game_sock->write( /* server_game_state */ pack->data,
-                               pack->packet_size() + pack->packet_prefix_size(),
-                               c->data_address);
-    } else {
-      DEBUG_LOG("Tick not resent - requested:%d current:%d packet:%d last_packet:%d",
-                tick, base->current_tick, base->packet.tick_received(),
-                base->last_packet.tick_received());
+      DEBUG_LOG("Resending tick %d to client %d", tick, c->client_id);
+      resend_game_state(tick, c);
+    }
+    else if (!reload_state && open_slot(tick) >= 0 && missing_input(c, tick))
+    {
+      // The game state is late because we never got the client's input
+      DEBUG_LOG("Asking client %d for its input for tick %d", c->client_id, tick);
+      uint8_t cmd[2] = { SRVCMD_REQUEST_RESEND, tick };
+      if (c->comm->write( /* server_command */ cmd, 2) != 2)
+        return 0;
+      netstat_bytes_out(2);
     }
     return 1;
   }
@@ -328,9 +451,7 @@ int game_server::process_client_command(player_client *c)
   {
     DEBUG_LOG("Client %d requesting disconnect", c->client_id);
     c->comm->write( /* server_disconnect_ack */ &cmd, 1);
-    c->set_delete_me(1);
-    if (base->input_state == INPUT_COLLECTING)
-      check_collection_complete();
+    c->set_delete_me(1); // removed by process_net() once it is done with the list
   }
   break;
   }
@@ -344,14 +465,14 @@ int game_server::process_net()
   int ret = 0;
 
   // Handle incoming game data
-  if ((base->input_state == INPUT_COLLECTING || base->input_state == INPUT_RELOAD) &&
-      game_sock->ready_to_read())
+  if (game_sock->ready_to_read())
   {
     DEBUG_LOG("Game data available");
     net_packet tmp;
     net_packet *use = &tmp;
     net_address *from;
     int bytes_received = game_sock->read( /* client_input_data */ use->data, PACKET_MAX_SIZE, &from);
+    netstat_bytes_in(bytes_received);
 
     if (from && bytes_received)
     {
@@ -371,26 +492,8 @@ int game_server::process_net()
 
           if (found)
           {
-            if (base->current_tick == use->tick_received())
-            {
-              DEBUG_LOG("Valid game data from client %d for current tick (%d)", found->client_id, base->current_tick);
-
-              if (base->input_state != INPUT_RELOAD)
-                add_client_input((char *)use->packet_data(), use->packet_size(), found);
-            }
-            else if (use->tick_received() == base->last_packet.tick_received())
-            {
-              DEBUG_LOG("Received stale data from client %d, resending last packet", found->client_id);
-              net_packet *pack = &base->last_packet;
-              game_sock->write( /* server_game_state */ pack->data,
-                                       pack->packet_size() + pack->packet_prefix_size(),
-                                       found->data_address);
-            }
-            else
-            {
-              DEBUG_LOG("Received out of sequence data from client %d (got %d, expected %d)",
-                        found->client_id, use->tick_received(), base->current_tick);
-            }
+            if (base->input_state != INPUT_RELOAD)
+              add_client_input(use, found);
           }
           else
           {
@@ -449,9 +552,24 @@ int game_server::process_net()
   return 1;
 }
 
+// Ask the clients we are still waiting on to send their input again
 int game_server::input_missing()
 {
   DEBUG_LOG("Server requesting input resend");
+  if (reload_state || next_tick < 0)
+    return 1;
+
+  uint8_t cmd[2] = { SRVCMD_REQUEST_RESEND, (uint8_t)next_tick };
+  for (player_client *c = player_list; c; c = c->next)
+  {
+    if (missing_input(c, next_tick))
+    {
+      if (c->comm->write( /* server_command */ cmd, 2) != 2)
+        c->set_delete_me(1);
+      else
+        netstat_bytes_out(2);
+    }
+  }
   return 1;
 }
 
@@ -497,6 +615,7 @@ int game_server::start_reload()
   DEBUG_LOG("Starting level reload");
   player_client *c = player_list;
   reload_state = 1;
+  reset_ticks();
   prot->select();
 
   for (; c; c = c->next)
@@ -596,6 +715,11 @@ int game_server::add_client(int type, net_socket *sock, net_address *from)
           if (j->client_id == i)
             f = -1;
         }
+        for (int k = 0; k < total_deleted; k++)
+        {
+          if (deleted[k] == i)
+            f = -1;
+        }
       }
     }
 
@@ -641,7 +765,7 @@ int game_server::kill_slackers()
   player_client *c = player_list;
   for (; c; c = c->next)
   {
-    if (c->wait_input())
+    if (next_tick >= 0 && missing_input(c, next_tick))
     {
       DEBUG_LOG("Marking non-responsive client %d for deletion", c->client_id);
       c->set_delete_me(1);
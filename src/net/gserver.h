@@ -13,7 +13,6 @@ class game_server : public game_handler
     unsigned char flags;
     enum { Has_joined=1,
        Wait_reload=2,
-       Wait_input=4,
        Need_reload_start_ok=8,
        Delete_me=16 };
     int get_flag(int flag)         { return flags&flag; }
@@ -23,9 +22,6 @@ class game_server : public game_handler
     int has_joined() { return get_flag(Has_joined); }
     void set_has_joined(int x) { set_flag(Has_joined,x); }
 
-    int wait_input() { return get_flag(Wait_input); }
-    void set_wait_input(int x) { set_flag(Wait_input,x); }
-
     int wait_reload() { return get_flag(Wait_reload); }
     void set_wait_reload(int x) { set_flag(Wait_reload,x); }
 
@@ -39,28 +35,47 @@ class game_server : public game_handler
     net_socket *comm;
     net_address *data_address;
     player_client *next;
+    net_packet input[NET_TICK_RING]; // inputs sent ahead, by tick slot
+    unsigned got_input;              // slots of input[] holding this client's input
     player_client(int client_id, net_socket *comm, net_address *data_address, player_client *next) :
       client_id(client_id), comm(comm), data_address(data_address), next(next)
       {
     flags=0;
-    set_wait_input(1);
+    got_input=0;
     comm->read_selectable();
       };
     ~player_client();
   } ;
 
   player_client *player_list;
-  int waiting_server_input, reload_state;
+  int reload_state;
+
+  // Inputs are collected for up to NET_TICK_RING ticks ahead of next_tick,
+  // the oldest tick not sent yet; -1 until the engine sends its first one.
+  int next_tick;
+  int slot_tick[NET_TICK_RING];        // tick collected in each slot, -1 if none
+  net_packet server_input[NET_TICK_RING];
+  unsigned got_server_input;
+  net_packet sent[NET_TICK_RING];      // last game states, to answer resend requests
+  int sent_tick[NET_TICK_RING];
+  uint8_t deleted[MAX_JOINERS];        // clients to remove in the next game state
+  int total_deleted;
 
-  void add_client_input(char *buf, int size, player_client *c);
+  int open_slot(int tick);
+  int missing_input(player_client *c, int tick);
+  void reset_ticks();
+  void send_game_state(int tick);
+  void resend_game_state(int tick, player_client *c);
+  void add_client_input(net_packet *pack, player_client *c);
   void check_collection_complete();
   void check_reload_wait();
   int process_client_command(player_client *c);
   int isa_client(int client_id);
   public :
   virtual void game_start_wait();
-  int total_players();
+  virtual int total_players();
   int process_net();
+  void send_engine_input(net_packet *pack);
   void add_engine_input();
   int input_missing();
   virtual int start_reload();
@@ -17,6 +17,8 @@
 #define READ_PACKET_SIZE 1024 // this is a file service packet (tcp/spx)
 #define NET_CRC_FILENAME "#net_crc"
 #define NET_STARTFILE "netstart.spe"
+#define NET_TICK_RING 16 // ticks of game data the drivers keep, must be a power of 2
+#define NET_MAX_DELAY 8  // most ticks a player's input may be sent ahead
 
 #include <string.h>
 
@@ -43,7 +45,8 @@ enum
   NFCMD_SEND_INPUT,
   NFCMD_INPUT_MISSING, // when engine is waiting for input and suspects packets are missing
   NFCMD_KILL_SLACKERS, // when the user decides the clients are taking too long to respond
-  EGCMD_DIE
+  EGCMD_DIE,
+  NFCMD_READ_PACKED    // like NFCMD_READ, but blocks of the reply may be compressed
 };
 
 // client commands
@@ -104,7 +107,8 @@ enum
   SCMD_EXT_KEYPRESS,   // Extended key press
   SCMD_EXT_KEYRELEASE, // Extended key release
   SCMD_CHAT_KEYPRESS,  // Chat input
-  SCMD_SYNC            // Synchronization check
+  SCMD_SYNC,           // Synchronization check
+  SCMD_NET_TIMING      // Input delay and tick length chosen by the server
 };
 
 struct join_struct
@@ -178,8 +182,7 @@ struct net_packet
 
 struct base_memory_struct
 {
-  net_packet packet, // current tick data
-      last_packet;   // last tick data (in case a client misses input, we can resend)
+  net_packet packet; // current tick data
 
   int16_t mem_lock;
   int16_t calc_crcs;
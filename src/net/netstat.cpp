@@ -0,0 +1,238 @@
+/*
+ *  Abuse - dark 2D side-scrolling platform game
+ *  Copyright (c) 1995 Crack dot Com
+ *  Copyright (c) 2005-2011 Sam Hocevar <sam@hocevar.net>
+ *
+ *  This software was released into the Public Domain. As with most public
+ *  domain software, no warranty is made or implied by Crack dot Com, by
+ *  Jonathan Clark, or by Sam Hocevar.
+ */
+
+#if defined HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <map>
+
+#include "common.h"
+
+#include "netstat.h"
+#include "timing.h"
+#include "dprint.h"
+#include "file_utils.h"
+
+#define NETSTAT_SMOOTH 0.1 // weight of the newest sample in the averages
+#define JITTER_SMOOTH 0.25 // the jitter has to follow sudden changes faster
+
+#define MIN_TIMEOUT 0.02
+#define MAX_TIMEOUT 0.5
+#define FIRST_TIMEOUT 0.05 // until there is a round trip to go by
+
+struct client_stats
+{
+  double lag_ms;        // smoothed
+  double jitter_ms;
+  int samples;
+  int resends;          // asked the server to send a packet again
+  int slowest;          // ticks this client was the last to send its input
+};
+
+int netstat_overlay=0;
+
+static std::map<int,client_stats> clients;
+static int tick_in,tick_out,tick_resends;     // during the current tick
+static double avg_in,avg_out,avg_stall,max_stall;
+static double rtt_ms,rtt_jitter;
+static int rtt_samples,total_resends,ticks,delay;
+static time_marker tick_time[256],run_start;  // when we sent our input
+static bool tick_timed[256];
+static int last_client=-1;
+static FILE *csv=NULL;
+
+static double smooth(double avg, double x)
+{
+  return ticks ? avg+(x-avg)*NETSTAT_SMOOTH : x;
+}
+
+static double ms_since(time_marker *start)
+{
+  time_marker now;
+  return now.diff_time(start)*1000.0;
+}
+
+// Same estimators as TCP's retransmission timer
+static void add_sample(double &mean, double &jitter, int &samples, double ms)
+{
+  if (samples++)
+  {
+    jitter+=(fabs(ms-mean)-jitter)*JITTER_SMOOTH;
+    mean+=(ms-mean)*NETSTAT_SMOOTH;
+  }
+  else
+  {
+    mean=ms;
+    jitter=ms/2;
+  }
+}
+
+void netstat_bytes_in(int bytes)  { if (bytes>0) tick_in+=bytes; }
+void netstat_bytes_out(int bytes) { if (bytes>0) tick_out+=bytes; }
+
+void netstat_resend_requested()
+{
+  tick_resends++;
+}
+
+void netstat_resend_served(int client_id)
+{
+  clients[client_id].resends++;
+  tick_resends++;
+}
+
+void netstat_input_sent(int tick)
+{
+  tick_time[tick&0xff].get_time();
+  tick_timed[tick&0xff]=true;
+}
+
+void netstat_state_received(int tick)
+{
+  if (!tick_timed[tick&0xff])
+    return;
+  tick_timed[tick&0xff]=false;
+  add_sample(rtt_ms,rtt_jitter,rtt_samples,ms_since(&tick_time[tick&0xff]));
+}
+
+void netstat_broadcast()
+{
+  if (last_client>=0)
+    clients[last_client].slowest++;
+  last_client=-1;
+}
+
+void netstat_client_input(int client_id, int tick)
+{
+  client_stats &c=clients[client_id];
+  if (tick_timed[tick&0xff])
+  {
+    double ms=ms_since(&tick_time[tick&0xff]);
+    add_sample(c.lag_ms,c.jitter_ms,c.samples,ms>0 ? ms : 0); // or it runs ahead of us
+  }
+  last_client=client_id;
+}
+
+void netstat_reset_ticks()
+{
+  memset(tick_timed,0,sizeof(tick_timed));
+}
+
+double netstat_worst_lag()
+{
+  double worst=0;
+  std::map<int,client_stats>::iterator it;
+  for (it=clients.begin(); it!=clients.end(); ++it)
+    if (it->second.samples && it->second.lag_ms+2*it->second.jitter_ms>worst)
+      worst=it->second.lag_ms+2*it->second.jitter_ms;
+  return worst;
+}
+
+double netstat_resend_timeout()
+{
+  double ms=rtt_samples ? rtt_ms+4*rtt_jitter : 0;
+  std::map<int,client_stats>::iterator it;
+  for (it=clients.begin(); it!=clients.end(); ++it)
+    if (it->second.samples && it->second.lag_ms+4*it->second.jitter_ms>ms)
+      ms=it->second.lag_ms+4*it->second.jitter_ms;
+
+  if (!ms)
+    return FIRST_TIMEOUT;
+  return ms/1000.0<MIN_TIMEOUT ? MIN_TIMEOUT : ms/1000.0>MAX_TIMEOUT ? MAX_TIMEOUT : ms/1000.0;
+}
+
+void netstat_client_gone(int client_id)
+{
+  clients.erase(client_id);
+  if (last_client==client_id)
+    last_client=-1;
+}
+
+void netstat_end_tick(int tick, double stall_ms, int input_delay)
+{
+  delay=input_delay;
+  if (!ticks)
+    run_start.get_time();
+
+  avg_in=smooth(avg_in,tick_in);
+  avg_out=smooth(avg_out,tick_out);
+  avg_stall=smooth(avg_stall,stall_ms);
+  if (stall_ms>max_stall)
+    max_stall=stall_ms;
+  total_resends+=tick_resends;
+
+  if (csv)
+  {
+    fprintf(csv,"%d,%d,%d,%d,%.1f,%d,%.1f,%.1f,%d,",tick,(int)ms_since(&run_start),
+            tick_in,tick_out,stall_ms,tick_resends,rtt_ms,rtt_jitter,delay);
+    std::map<int,client_stats>::iterator it;
+    for (it=clients.begin(); it!=clients.end(); ++it)
+      fprintf(csv,"%s%d=%.1f",it==clients.begin() ? "" : " ",it->first,it->second.lag_ms);
+    fputc('\n',csv);
+  }
+
+  ticks++;
+  tick_in=tick_out=tick_resends=0;
+}
+
+void netstat_csv_toggle(char const *filename)
+{
+  if (csv)
+  {
+    fclose(csv);
+    csv=NULL;
+    dprintf("netstat: log closed\n");
+    return;
+  }
+
+  char name[512];
+  char const *prefix=get_save_filename_prefix();
+  snprintf(name,sizeof(name),"%s%s",prefix ? prefix : "",
+           filename && filename[0] ? filename : "netstat.csv");
+  csv=fopen(name,"w");
+  if (!csv)
+  {
+    dprintf("netstat: cannot write %s\n",name);
+    return;
+  }
+  fprintf(csv,"tick,ms,bytes_in,bytes_out,stall_ms,resends,rtt_ms,jitter_ms,delay,client_lag_ms\n");
+  dprintf("netstat: logging to %s\n",name);
+}
+
+char const *netstat_line(int n)
+{
+  static char line[80];
+  switch (n)
+  {
+    case 0 :
+      snprintf(line,sizeof(line),"net in %d out %d B/tick",(int)avg_in,(int)avg_out);
+      return line;
+    case 1 :
+      snprintf(line,sizeof(line),"rtt %.0f+-%.0f ms stall %.0f/%.0f ms",rtt_ms,rtt_jitter,
+               avg_stall,max_stall);
+      return line;
+    case 2 :
+      snprintf(line,sizeof(line),"resends %d input delay %d",total_resends,delay);
+      return line;
+  }
+
+  std::map<int,client_stats>::iterator it=clients.begin();
+  for (n-=3; n>0 && it!=clients.end(); n--)
+    ++it;
+  if (it==clients.end())
+    return NULL;
+  snprintf(line,sizeof(line),"#%d lag %.0f+-%.0f ms slowest %d resends %d",it->first,
+           it->second.lag_ms,it->second.jitter_ms,it->second.slowest,it->second.resends);
+  return line;
+}
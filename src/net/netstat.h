@@ -0,0 +1,49 @@
+/*
+ *  Abuse - dark 2D side-scrolling platform game
+ *  Copyright (c) 1995 Crack dot Com
+ *  Copyright (c) 2005-2011 Sam Hocevar <sam@hocevar.net>
+ *
+ *  This software was released into the Public Domain. As with most public
+ *  domain software, no warranty is made or implied by Crack dot Com, by
+ *  Jonathan Clark, or by Sam Hocevar.
+ */
+
+#ifndef __NETSTAT_HPP_
+#define __NETSTAT_HPP_
+
+// Network game counters. The game handlers report the traffic and the
+// timing of each tick's packets; the engine closes a tick once it has its
+// inputs. What was seen can be drawn over the game and logged as CSV, one
+// line per tick.
+//
+// Round trip on a client is the time from sending its input for a tick to
+// getting that tick's game state back, so it includes waiting for the
+// slowest player. The lag of a client, seen by the server, is how long
+// after the server's own input for a tick the client's input arrives.
+// Both come with their jitter, the average distance of a sample from the
+// mean, which the engine uses to pick its input delay and how long to wait
+// before asking for a packet again.
+
+void netstat_bytes_in(int bytes);
+void netstat_bytes_out(int bytes);
+void netstat_resend_requested();          // we asked for a packet again
+void netstat_resend_served(int client_id); // the server was asked, by a client
+
+void netstat_input_sent(int tick);        // our input for a tick is out
+void netstat_state_received(int tick);    // client
+void netstat_broadcast();                 // server, all inputs are in
+void netstat_client_input(int client_id, int tick); // server
+void netstat_client_gone(int client_id);  // server
+void netstat_reset_ticks();               // tick numbers start over
+
+void netstat_end_tick(int tick, double stall_ms, int input_delay);
+
+double netstat_worst_lag();     // ms, slowest client's lag plus twice its jitter
+double netstat_resend_timeout(); // seconds
+
+void netstat_csv_toggle(char const *filename);
+char const *netstat_line(int n); // overlay text, NULL past the last line
+
+extern int netstat_overlay;
+
+#endif
@@ -48,6 +48,12 @@ int get_remote_lsf(net_address *addr, char *filename);   // filename should be 2
 void send_local_request();                          // sends from *base
 int get_inputs_from_server(unsigned char *buf);     // return bytes read into buf (will be less than PACKET_MAX_SIZE
 
+void net_reset_ticks();                             // start counting rounds from the level's tick
+void net_add_timing(int tick_ms);                   // server adds SCMD_NET_TIMING to *base if needed
+void net_set_timing(int input_delay, int tick_ms);  // from SCMD_NET_TIMING
+int net_input_held();                               // this round's input goes with the next one
+int net_tick_ms(int local_ms);                      // tick length to play at
+
 
 int client_number();
 extern net_address *net_server;
@@ -28,6 +28,7 @@
 #include "clisp.h"
 #include "lisp_gc.h"
 #include "profile.h"
+#include "drawlist.h"
 
 char **object_names;
 int total_objects;
@@ -337,7 +338,8 @@ void game_object::next_sequence()
 
 game_object::~game_object()
 {
-  if (lvars) free(lvars);
+  objpool_free_lvars(lvars);
+  objpool_count(pool_type,-1);
   clean_up();
 }
 
@@ -393,7 +395,7 @@ void game_object::draw_above(view *v)
     TransImage *p = picture();
 
     for (int i = pos2.y; i <= pos1.y; i++)
-      p->PutScanLine(main_screen, ivec2(pos1.x, i), 0);
+      draw_list.PutScanLine(p, ivec2(pos1.x, i), 0);
   }
 }
 
@@ -404,26 +406,28 @@ int game_object::push_range()
 
 int game_object::decide()
 {
-  if (figures[otype]->get_fun(OFUN_AI))
+  LSymbol *ai = (LSymbol *)figures[otype]->get_fun(OFUN_AI);
+  if (ai && profiling())
+  {
+    time_marker start;
+    int ret = think(ai);
+    time_marker now;
+    profile_add_time(otype, now.diff_time(&start));
+    return ret;
+  }
+  return think(ai);
+}
+
+int game_object::think(LSymbol *ai)
+{
+  if (ai)
   {
     int old_aistate;
     old_aistate=aistate();
 
     current_object=this;
     void *m = LSpace::Tmp.Mark();
-
-    time_marker *prof1=NULL;
-    if (profiling())
-      prof1=new time_marker;
-
-    LObject *ret = ((LSymbol *)figures[otype]->get_fun(OFUN_AI))->EvalFunction(NULL);
-    if (profiling())
-    {
-      time_marker now;
-      profile_add_time(this->otype,now.diff_time(prof1));
-      delete prof1;
-    }
-
+    LObject *ret = ai->EvalFunction(NULL);
     LSpace::Tmp.Restore(m);
 
     if (keep_ai_info())
@@ -669,11 +673,10 @@ void game_object::map_draw()
 void game_object::draw_trans(int count, int max)
 {
   TransImage *cpict=picture();
-  cpict->PutFade(main_screen,
+  draw_list.PutFade(cpict,
           ivec2((direction<0 ? x-(cpict->Size().x-x_center()-1) : x-x_center())-current_vxadd,
                 y-cpict->Size().y+1-current_vyadd),
-          count,max,
-          color_table,the_game->current_palette());
+          count,max);
 }
 
 
@@ -681,16 +684,15 @@ void game_object::draw_tint(int tint_id)
 {
   TransImage *cpict=picture();
   if (fade_count())
-    cpict->PutFadeTint(main_screen,
+    draw_list.PutFadeTint(cpict,
                ivec2((direction<0 ? x-(cpict->Size().x-x_center()-1) : x-x_center())-current_vxadd,
                      y-cpict->Size().y+1-current_vyadd),
                fade_count(),fade_max(),
-               cache.ctint(tint_id)->data,
-               color_table,the_game->current_palette());
+               cache.ctint(tint_id)->data);
 
 
   else
-    cpict->PutRemap(main_screen,
+    draw_list.PutRemap(cpict,
                ivec2((direction<0 ? x-(cpict->Size().x-x_center()-1) : x-x_center())-current_vxadd,
                      y-cpict->Size().y+1-current_vyadd),
                cache.ctint(tint_id)->data);
@@ -701,16 +703,15 @@ void game_object::draw_double_tint(int tint_id, int tint2)
 {
   TransImage *cpict=picture();
   if (fade_count())
-    cpict->PutFadeTint(main_screen,
+    draw_list.PutFadeTint(cpict,
                ivec2((direction<0 ? x-(cpict->Size().x-x_center()-1) : x-x_center())-current_vxadd,
                      y-cpict->Size().y+1-current_vyadd),
                fade_count(),fade_max(),
-               cache.ctint(tint_id)->data,
-               color_table,the_game->current_palette());
+               cache.ctint(tint_id)->data);
 
 
   else
-    cpict->PutDoubleRemap(main_screen,
+    draw_list.PutDoubleRemap(cpict,
                ivec2((direction<0 ? x-(cpict->Size().x-x_center()-1) : x-x_center())-current_vxadd,
                      y-cpict->Size().y+1-current_vyadd),
                cache.ctint(tint_id)->data,
@@ -722,7 +723,7 @@ void game_object::draw_double_tint(int tint_id, int tint2)
 void game_object::draw_predator()
 {
   TransImage *cpict=picture();
-  cpict->PutPredator(main_screen,
+  draw_list.PutPredator(cpict,
              ivec2((direction<0 ? x-(cpict->Size().x-x_center()-1) : x-x_center())-current_vxadd,
                    y-cpict->Size().y+1-current_vyadd));
 
@@ -732,6 +733,8 @@ void game_object::drawer()
 {
   if (morph_status())
   {
+    // morphs animate as they draw, so they can't be recorded for later
+    draw_list.Flush();
     morph_status()->draw(this,current_view);
     if (morph_status()->frames_left()<1)
       set_morph_status(NULL);
@@ -745,7 +748,7 @@ void game_object::drawer()
     else
     {
       TransImage *cpict=picture();
-      cpict->PutImage(main_screen,
+      draw_list.PutImage(cpict,
                ivec2((direction<0 ? x-(cpict->Size().x-x_center()-1) : x-x_center())-current_vxadd,
                      y-cpict->Size().y+1-current_vyadd));
     }
@@ -1543,12 +1546,13 @@ game_object::game_object(int Type, int load)
   {
     int t = figures[Type]->tv;
     if (t)
-    {
-      lvars = (int32_t *)malloc(t * sizeof(int32_t));
-      memset(lvars, 0, t * sizeof(int32_t));
-    }
+      lvars = objpool_alloc_lvars(t);
   }
 
+  grid_cell=OBJGRID_NOT_INDEXED;
+  active_slot=-1;
+  pool_type=Type;
+  objpool_count(pool_type,1);
   otype=Type;
   if (!load) defaults();
 }
@@ -1600,19 +1604,19 @@ void game_object::change_aitype(int new_type)
 
 void game_object::change_type(int new_type)
 {
-  free(lvars);     // free old variable
+  objpool_free_lvars(lvars);     // free old variable
   lvars = NULL;
 
   if (otype<0xffff)
   {
     int t = figures[new_type]->tv;
     if (t)
-    {
-      lvars = (int32_t *)malloc(t * sizeof(int32_t));
-      memset(lvars, 0, t * sizeof(int32_t));
-    }
+      lvars = objpool_alloc_lvars(t);
   }
   else return;
+  objpool_count(pool_type,-1);
+  pool_type=new_type;
+  objpool_count(pool_type,1);
   otype=new_type;
 
   if (figures[new_type]->get_fun(OFUN_CONSTRUCTOR))
@@ -17,6 +17,8 @@
 #include "loader2.h"
 #include "view.h"
 #include "extend.h"
+#include "objpool.h"
+#include "objgrid.h"
 
 class view;
 
@@ -58,9 +60,16 @@ class game_object : public simple_object
 public :
   game_object *next,*next_active;
   int32_t *lvars;
+  int pool_type;       // type counted in the pool statistics
+  int grid_cell,grid_slot;  // where the level's object_grid keeps us
+  int32_t grid_cx,grid_cy;  // and the cell and type it was indexed with
+  uint16_t grid_type;
+  int64_t grid_order;
+  int active_slot;          // index in the level's activated list, or -1
 
   int size();
   int decide();        // returns 0 if you want to be deleted
+  int think(LSymbol *ai); // same with the type's AI function already looked up
   int type() { return otype; }
   ifield *make_fields(int ystart, ifield *Next)
   {
@@ -135,6 +144,8 @@ public :
 
   game_object(int Type, int load=0);
   ~game_object();
+  static void *operator new(size_t size) { (void)size; return objpool_alloc_object(); }
+  static void operator delete(void *p) { objpool_free_object(p); }
 
   int is_playable() { return hurtable(); }
   void add_power(int amount);
@@ -0,0 +1,154 @@
+/*
+ *  Abuse - dark 2D side-scrolling platform game
+ *  Copyright (c) 1995 Crack dot Com
+ *  Copyright (c) 2005-2011 Sam Hocevar <sam@hocevar.net>
+ *
+ *  This software was released into the Public Domain. As with most public
+ *  domain software, no warranty is made or implied by Crack dot Com, by
+ *  Jonathan Clark, or by Sam Hocevar.
+ */
+
+#if defined HAVE_CONFIG_H
+#   include "config.h"
+#endif
+
+#include <algorithm>
+
+#include "common.h"
+
+#include "objgrid.h"
+#include "objects.h"
+
+#define ORDER_GAP ((int64_t)1<<20) // room for objects inserted in between
+
+static bool by_order(game_object *a, game_object *b)
+{
+  return a->grid_order<b->grid_order;
+}
+
+object_grid::object_grid()
+{
+  m_built=false;
+}
+
+int object_grid::cell_of(game_object *o)
+{
+  if (o->otype>=total_objects)
+    return OBJGRID_WIDE;
+
+  CharacterType *f=figures[o->otype];
+  long r=std::max(std::max(f->rangex,f->rangey),
+                  std::max(f->draw_rangex,f->draw_rangey));
+  if (r>(1<<CELL_BITS))
+    return OBJGRID_WIDE;
+  return hash(o->x>>CELL_BITS,o->y>>CELL_BITS);
+}
+
+void object_grid::add(game_object *o)
+{
+  int c=cell_of(o);
+  std::vector<game_object *> &v=c==OBJGRID_WIDE ? wide : cells[c];
+  o->grid_cell=c;
+  o->grid_cx=o->x>>CELL_BITS;
+  o->grid_cy=o->y>>CELL_BITS;
+  o->grid_type=o->otype;
+  o->grid_slot=v.size();
+  v.push_back(o);
+}
+
+void object_grid::rebuild(game_object *first)
+{
+  for (int i=0; i<TOTAL_CELLS; i++)
+    cells[i].clear();
+  wide.clear();
+
+  int64_t order=0;
+  for (game_object *o=first; o; o=o->next)
+  {
+    order+=ORDER_GAP;
+    o->grid_order=order;
+    add(o);
+  }
+  m_built=true;
+}
+
+void object_grid::insert(game_object *o, game_object *prev, game_object *next)
+{
+  if (!m_built) return;
+
+  if ((prev && prev->grid_cell==OBJGRID_NOT_INDEXED) ||
+      (next && next->grid_cell==OBJGRID_NOT_INDEXED))
+  {
+    clear();
+    return;
+  }
+
+  if (!prev && !next)
+    o->grid_order=0;
+  else if (!prev)
+    o->grid_order=next->grid_order-ORDER_GAP;
+  else if (!next)
+    o->grid_order=prev->grid_order+ORDER_GAP;
+  else if (next->grid_order-prev->grid_order<2)
+  {
+    clear();
+    return;
+  } else
+    o->grid_order=prev->grid_order+(next->grid_order-prev->grid_order)/2;
+
+  add(o);
+}
+
+void object_grid::remove(game_object *o)
+{
+  if (!m_built || o->grid_cell==OBJGRID_NOT_INDEXED) return;
+
+  std::vector<game_object *> &v=o->grid_cell==OBJGRID_WIDE ? wide : cells[o->grid_cell];
+  game_object *moved=v.back();
+  v[o->grid_slot]=moved;
+  moved->grid_slot=o->grid_slot;
+  v.pop_back();
+  o->grid_cell=OBJGRID_NOT_INDEXED;
+}
+
+void object_grid::update(game_object *o)
+{
+  if (!m_built || o->grid_cell==OBJGRID_NOT_INDEXED) return;
+
+  // This runs on every object every tick, so look for a change before
+  // working out the cell
+  if ((o->x>>CELL_BITS)!=o->grid_cx || (o->y>>CELL_BITS)!=o->grid_cy ||
+      o->otype!=o->grid_type)
+  {
+    remove(o);
+    add(o);
+  }
+}
+
+void object_grid::query(int32_t x1, int32_t y1, int32_t x2, int32_t y2,
+                        std::vector<game_object *> &out)
+{
+  out.assign(wide.begin(),wide.end());
+
+  // An object in a cell is at most one cell's width out of range
+  int32_t cx1=(x1>>CELL_BITS)-1,cy1=(y1>>CELL_BITS)-1,
+          cx2=(x2>>CELL_BITS)+1,cy2=(y2>>CELL_BITS)+1;
+
+  if ((int64_t)(cx2-cx1+1)*(cy2-cy1+1)>=TOTAL_CELLS)
+  {
+    for (int i=0; i<TOTAL_CELLS; i++)
+      out.insert(out.end(),cells[i].begin(),cells[i].end());
+  } else
+  {
+    for (int32_t cy=cy1; cy<=cy2; cy++)
+      for (int32_t cx=cx1; cx<=cx2; cx++)
+      {
+        std::vector<game_object *> &v=cells[hash(cx,cy)];
+        out.insert(out.end(),v.begin(),v.end());
+      }
+  }
+
+  // Different cells may share a slot, so the same object can come twice
+  std::sort(out.begin(),out.end(),by_order);
+  out.erase(std::unique(out.begin(),out.end()),out.end());
+}
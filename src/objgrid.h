@@ -0,0 +1,66 @@
+/*
+ *  Abuse - dark 2D side-scrolling platform game
+ *  Copyright (c) 1995 Crack dot Com
+ *  Copyright (c) 2005-2011 Sam Hocevar <sam@hocevar.net>
+ *
+ *  This software was released into the Public Domain. As with most public
+ *  domain software, no warranty is made or implied by Crack dot Com, by
+ *  Jonathan Clark, or by Sam Hocevar.
+ */
+
+#ifndef __OBJGRID_HPP_
+#define __OBJGRID_HPP_
+
+#include <stdint.h>
+#include <vector>
+
+class game_object;
+
+// Spatial index over all the objects of a level, so that finding the
+// ones near a view does not mean walking the whole object list. Objects
+// are hashed into square cells by position; those whose activity or draw
+// range is wider than a cell go in a separate list that every query
+// returns. Positions are written directly all over the engine, so the
+// index cannot hear about moves: update() has to be called on every object
+// that may have moved before the index is queried.
+//
+// Each object also carries an order key increasing along the level's
+// object list, and queries return their objects sorted by it: objects
+// get activated, and so ticked, in the same order as with a list walk.
+
+#define OBJGRID_NOT_INDEXED -2
+#define OBJGRID_WIDE        -1
+
+class object_grid
+{
+public:
+  object_grid();
+
+  bool built() { return m_built; }
+  void clear() { m_built=false; }     // call when the object list is rebuilt
+  void rebuild(game_object *first);
+
+  // Keep the index in sync with the object list; new objects take an
+  // order key from their neighbours, or invalidate the index if there is
+  // no room left between them.
+  void insert(game_object *o, game_object *prev, game_object *next);
+  void remove(game_object *o);
+  void update(game_object *o);       // cheap if o did not change cell or type
+
+  // Objects that may be within range of the box, sorted by list order
+  void query(int32_t x1, int32_t y1, int32_t x2, int32_t y2,
+             std::vector<game_object *> &out);
+
+private:
+  enum { CELL_BITS = 8, TOTAL_CELLS = 4096 };
+
+  int cell_of(game_object *o);
+  int hash(int32_t cx, int32_t cy)
+  { return (int)(((uint32_t)cx*73856093u)^((uint32_t)cy*19349663u))&(TOTAL_CELLS-1); }
+  void add(game_object *o);
+
+  std::vector<game_object *> cells[TOTAL_CELLS], wide;
+  bool m_built;
+};
+
+#endif
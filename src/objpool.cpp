@@ -0,0 +1,125 @@
+/*
+ *  Abuse - dark 2D side-scrolling platform game
+ *  Copyright (c) 1995 Crack dot Com
+ *  Copyright (c) 2005-2011 Sam Hocevar <sam@hocevar.net>
+ *
+ *  This software was released into the Public Domain. As with most public
+ *  domain software, no warranty is made or implied by Crack dot Com, by
+ *  Jonathan Clark, or by Sam Hocevar.
+ */
+
+#if defined HAVE_CONFIG_H
+#   include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "common.h"
+
+#include "objpool.h"
+#include "objects.h"
+#include "dprint.h"
+
+#define SLAB_BLOCKS 64 // blocks taken from malloc at a time
+
+slab_pool::slab_pool(size_t block_size)
+{
+  // blocks hold the free list link while unused
+  if (block_size<sizeof(void *)) block_size=sizeof(void *);
+  size=(block_size+sizeof(void *)-1)&~(sizeof(void *)-1);
+  blocks=0;
+  free_list=NULL;
+}
+
+void slab_pool::grow()
+{
+  uint8_t *slab=(uint8_t *)malloc(size*SLAB_BLOCKS);
+  if (!slab)
+  {
+    fprintf(stderr,"Out of memory allocating objects\n");
+    exit(1);
+  }
+  for (int i=SLAB_BLOCKS-1; i>=0; i--)
+    release(slab+i*size);
+  blocks+=SLAB_BLOCKS;
+}
+
+// Constructed on first use: game_objects may be created before main().
+static slab_pool &object_pool()
+{
+  static slab_pool pool(sizeof(game_object));
+  return pool;
+}
+
+// One pool per lvars count. A block starts with its count so that it can
+// go back to the right pool, whatever otype says by then.
+static std::vector<slab_pool *> lvars_pools;
+
+struct type_count { int live, peak; };
+static std::vector<type_count> type_counts;
+
+void *objpool_alloc_object()
+{
+  return object_pool().alloc();
+}
+
+void objpool_free_object(void *p)
+{
+  object_pool().release(p);
+}
+
+int32_t *objpool_alloc_lvars(int count)
+{
+  if (count>=(int)lvars_pools.size())
+    lvars_pools.resize(count+1,NULL);
+  if (!lvars_pools[count])
+    lvars_pools[count]=new slab_pool((count+1)*sizeof(int32_t));
+
+  int32_t *block=(int32_t *)lvars_pools[count]->alloc();
+  block[0]=count;
+  memset(block+1,0,count*sizeof(int32_t));
+  return block+1;
+}
+
+void objpool_free_lvars(int32_t *lvars)
+{
+  if (!lvars) return;
+  int32_t *block=lvars-1;
+  lvars_pools[block[0]]->release(block);
+}
+
+void objpool_count(int type, int delta)
+{
+  if (type<0 || type>=0xffff) return;
+  if (type>=(int)type_counts.size())
+  {
+    type_count zero={0,0};
+    type_counts.resize(type+1,zero);
+  }
+  type_count &c=type_counts[type];
+  c.live+=delta;
+  if (c.live>c.peak) c.peak=c.live;
+}
+
+void objpool_show_stats()
+{
+  int live=0,peak=0;
+  for (int i=0; i<(int)type_counts.size(); i++)
+  {
+    if (!type_counts[i].peak) continue;
+    dprintf("  %-20s live=%d peak=%d\n",
+            i<total_objects ? object_names[i] : "?",
+            type_counts[i].live,type_counts[i].peak);
+    live+=type_counts[i].live;
+    peak+=type_counts[i].peak;
+  }
+
+  int bytes=object_pool().total_blocks()*object_pool().block_size();
+  for (int i=0; i<(int)lvars_pools.size(); i++)
+    if (lvars_pools[i])
+      bytes+=lvars_pools[i]->total_blocks()*lvars_pools[i]->block_size();
+  dprintf("%d objects live (sum of peaks %d), pools=%d bytes\n",
+          live,peak,bytes);
+}
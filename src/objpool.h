@@ -0,0 +1,61 @@
+/*
+ *  Abuse - dark 2D side-scrolling platform game
+ *  Copyright (c) 1995 Crack dot Com
+ *  Copyright (c) 2005-2011 Sam Hocevar <sam@hocevar.net>
+ *
+ *  This software was released into the Public Domain. As with most public
+ *  domain software, no warranty is made or implied by Crack dot Com, by
+ *  Jonathan Clark, or by Sam Hocevar.
+ */
+
+#ifndef __OBJPOOL_HPP_
+#define __OBJPOOL_HPP_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Memory for game_objects and their lvars arrays. Bullets, sparks and
+// explosions come and go every few ticks, so instead of a malloc and a
+// free each, deleted blocks go on a free list and the next create() of
+// the same size takes them back. Blocks are carved out of larger slabs,
+// which are kept until the game exits.
+
+class slab_pool
+{
+public:
+  slab_pool(size_t block_size);
+
+  void *alloc()
+  {
+    if (!free_list) grow();
+    void *p=free_list;
+    free_list=*(void **)p;
+    return p;
+  }
+  void release(void *p)
+  {
+    *(void **)p=free_list;
+    free_list=p;
+  }
+
+  size_t block_size() { return size; }
+  int total_blocks() { return blocks; }
+
+private:
+  void grow();
+
+  size_t size;
+  int blocks;
+  void *free_list;
+};
+
+void *objpool_alloc_object();             // game_object::operator new
+void objpool_free_object(void *p);
+int32_t *objpool_alloc_lvars(int count);  // zeroed, count from figures[]->tv
+void objpool_free_lvars(int32_t *lvars);
+
+// Live and peak object counts per type
+void objpool_count(int type, int delta);
+void objpool_show_stats();
+
+#endif
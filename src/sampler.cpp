@@ -0,0 +1,150 @@
+/*
+ *  Abuse - dark 2D side-scrolling platform game
+ *  Copyright (c) 1995 Crack dot Com
+ *  Copyright (c) 2005-2011 Sam Hocevar <sam@hocevar.net>
+ *
+ *  This software was released into the Public Domain. As with most public
+ *  domain software, no warranty is made or implied by Crack dot Com, by
+ *  Jonathan Clark, or by Sam Hocevar.
+ */
+
+#if defined HAVE_CONFIG_H
+#   include "config.h"
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <map>
+
+#include <SDL.h>
+
+#include "common.h"
+
+#include "sampler.h"
+#include "lisp.h"
+#include "dprint.h"
+#include "file_utils.h"
+
+#define SAMPLE_INTERVAL 1 // in milliseconds
+
+static char const *phase_names[SAMPLE_PHASES] =
+{
+    "?", "tick", "collisions", "draw_map", "lighting", "flush"
+};
+
+static SDL_TimerID sample_timer = 0;
+static SDL_mutex *sample_mutex = NULL;
+static std::map<std::string, int> sample_counts; // raw frames -> samples
+static int sample_total = 0;
+static std::string sample_filename;
+
+// Runs on SDL's timer thread: only copy the frames, names are looked up
+// when writing since the Lisp heap may be moving under our feet.
+static Uint32 sampler_tick(Uint32 interval, void *param)
+{
+    int depth = sample_stack.depth.load(std::memory_order_acquire);
+    if (depth > SampleStack::MAX_DEPTH)
+        depth = SampleStack::MAX_DEPTH;
+
+    std::string key((char const *)sample_stack.frames,
+                    depth * sizeof(uintptr_t));
+
+    SDL_LockMutex(sample_mutex);
+    sample_counts[key]++;
+    sample_total++;
+    SDL_UnlockMutex(sample_mutex);
+
+    return interval;
+}
+
+bool sampler_running()
+{
+    return sample_timer != 0;
+}
+
+void sampler_start(char const *filename)
+{
+    if (sampler_running())
+        return;
+
+    if (!sample_mutex)
+        sample_mutex = SDL_CreateMutex();
+    SDL_InitSubSystem(SDL_INIT_TIMER);
+
+    sample_filename = filename && filename[0] ? filename : "samples.txt";
+    sample_counts.clear();
+    sample_total = 0;
+
+    sample_stack.active.store(true);
+    sample_timer = SDL_AddTimer(SAMPLE_INTERVAL, sampler_tick, NULL);
+    if (!sample_timer)
+    {
+        sample_stack.active.store(false);
+        dprintf("sampler: cannot start timer: %s\n", SDL_GetError());
+        return;
+    }
+    dprintf("sampler: started\n");
+}
+
+static void write_frame(FILE *fp, uintptr_t frame)
+{
+    if (frame < SAMPLE_PHASES)
+    {
+        fprintf(fp, ";%s", phase_names[frame]);
+        return;
+    }
+
+    // Spaces and semicolons would break the format
+    fputc(';', fp);
+    for (char const *s = lstring_value(((LSymbol *)frame)->GetName()); *s; s++)
+        fputc(*s == ';' || *s == ' ' ? '_' : *s, fp);
+}
+
+void sampler_stop()
+{
+    if (!sampler_running())
+        return;
+
+    SDL_RemoveTimer(sample_timer);
+    sample_timer = 0;
+    sample_stack.active.store(false);
+
+    // The timer may still be in its callback
+    SDL_LockMutex(sample_mutex);
+
+    char name[512];
+    char const *prefix = get_save_filename_prefix();
+    snprintf(name, sizeof(name), "%s%s", prefix ? prefix : "",
+             sample_filename.c_str());
+    FILE *fp = fopen(name, "w");
+    if (fp)
+    {
+        std::map<std::string, int>::iterator it;
+        for (it = sample_counts.begin(); it != sample_counts.end(); ++it)
+        {
+            uintptr_t const *frames = (uintptr_t const *)it->first.data();
+            size_t depth = it->first.size() / sizeof(uintptr_t);
+
+            fputs("abuse", fp);
+            for (size_t i = 0; i < depth; i++)
+                write_frame(fp, frames[i]);
+            fprintf(fp, " %d\n", it->second);
+        }
+        fclose(fp);
+        dprintf("sampler: %d samples written to %s\n", sample_total, name);
+    }
+    else
+        dprintf("sampler: cannot write %s\n", name);
+
+    sample_counts.clear();
+    SDL_UnlockMutex(sample_mutex);
+}
+
+void sampler_toggle(char const *filename)
+{
+    if (sampler_running())
+        sampler_stop();
+    else
+        sampler_start(filename);
+}
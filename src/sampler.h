@@ -0,0 +1,81 @@
+/*
+ *  Abuse - dark 2D side-scrolling platform game
+ *  Copyright (c) 1995 Crack dot Com
+ *  Copyright (c) 2005-2011 Sam Hocevar <sam@hocevar.net>
+ *
+ *  This software was released into the Public Domain. As with most public
+ *  domain software, no warranty is made or implied by Crack dot Com, by
+ *  Jonathan Clark, or by Sam Hocevar.
+ */
+
+#ifndef __SAMPLER_HPP_
+#define __SAMPLER_HPP_
+
+#include <stdint.h>
+#include <atomic>
+
+// Sampling profiler. Engine phases and Lisp user functions push a frame on
+// the sample stack while they run; when the sampler is on, a timer thread
+// copies that stack about a thousand times per second. Stopping it writes
+// one line per distinct stack, "abuse;tick;ant_ai 123", the collapsed
+// format flamegraph.pl and speedscope read.
+//
+// A frame is a single word so the timer thread can never see half of one:
+// either one of the phases below, or the address of a Lisp symbol.
+
+enum
+{
+    SAMPLE_NONE,
+    SAMPLE_TICK,
+    SAMPLE_COLLISIONS,
+    SAMPLE_DRAW_MAP,
+    SAMPLE_LIGHTING,
+    SAMPLE_FLUSH,
+    SAMPLE_PHASES
+};
+
+struct SampleStack
+{
+    enum { MAX_DEPTH = 64 };
+
+    uintptr_t frames[MAX_DEPTH];
+    std::atomic<int> depth;     // may exceed MAX_DEPTH, deeper frames are lost
+    std::atomic<bool> active;
+};
+
+inline SampleStack sample_stack;
+
+// Pushes a frame for the lifetime of the object. Scopes entered while the
+// sampler is off cost one load and are never pushed.
+class SampleScope
+{
+public:
+    inline SampleScope(uintptr_t frame)
+    {
+        m_pushed = sample_stack.active.load(std::memory_order_relaxed);
+        if (m_pushed)
+        {
+            int depth = sample_stack.depth.load(std::memory_order_relaxed);
+            if (depth < SampleStack::MAX_DEPTH)
+                sample_stack.frames[depth] = frame;
+            sample_stack.depth.store(depth + 1, std::memory_order_release);
+        }
+    }
+
+    inline ~SampleScope()
+    {
+        if (m_pushed)
+            sample_stack.depth.store(sample_stack.depth.load(std::memory_order_relaxed) - 1,
+                                     std::memory_order_release);
+    }
+
+private:
+    bool m_pushed;
+};
+
+void sampler_start(char const *filename);
+void sampler_stop();
+void sampler_toggle(char const *filename);
+bool sampler_running();
+
+#endif
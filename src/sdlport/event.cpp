@@ -35,6 +35,7 @@
 #include "timing.h"
 #include "sprite.h"
 #include "game.h"
+#include "loadgame.h"
 #include "setup.h"
 
 extern SDL_Window *window;
@@ -306,12 +307,7 @@ void EventHandler::SysEvent(Event &ev)
 		case SDLK_F5://AR quick save in dedicated quick save slot when touching the console
 			if(ev.type==EV_KEYRELEASE && settings.player_touching_console)
 			{				
-				if(current_level->save("save0001.spe",1)==1)
-				{
-					the_game->show_help("Station secured!");
-					cache.sfx(1031)->play(127);//id 1031 should be save05.wav					
-					settings.quick_load = "save0001.spe";
-				}
+				current_level->save("save0001.spe",1,quick_save_done);
 			}
 			ev.key = JK_F5;
 			break;
@@ -429,13 +425,7 @@ void EventHandler::SysEvent(Event &ev)
 			if(sdlev.type==SDL_CONTROLLERBUTTONUP)
 				if(settings.player_touching_console)
 				{				
-					if(current_level->save("save0001.spe",1)==1)
-					{
-						the_game->show_help("Station secured!");
-						cache.sfx(1031)->play(127);//id 1031 should be save05.wav
-						settings.quick_load = get_save_filename_prefix();
-						settings.quick_load += "save0001.spe";
-					}
+					current_level->save("save0001.spe",1,quick_save_done);
 				}
 				ev.type = sdlev.type == SDL_CONTROLLERBUTTONDOWN ? EV_KEY : EV_KEYRELEASE;
 				ev.key = EV_SPURIOUS;
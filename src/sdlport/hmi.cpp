@@ -20,6 +20,9 @@
 #include <cstdio>
 #include <algorithm>
 #include <memory>
+#include <string>
+#include <filesystem>
+#include <system_error>
 
 #include "file_utils.h"
 #include "common.h"
@@ -37,6 +40,10 @@
 // The bpm and header information is fixed and not read from the file (except
 // the number of tracks). HMI files make use of running status notation, the
 // converted files don't.
+//
+// Converted files are kept in the midi subdirectory of the save directory,
+// named after the CRC-32 and size of the HMI file, so each song is only
+// converted once.
 
 
 constexpr size_t MAX_NOTE_OFF_EVENTS = 30;
@@ -58,6 +65,74 @@ struct NoteOffEvent
 };
 
 
+static uint32_t crc32(const uint8_t *buffer, size_t size)
+{
+    uint32_t crc = 0xFFFFFFFF;
+    while (size--)
+    {
+        crc ^= *buffer++;
+        for (int bit = 0; bit < 8; bit++)
+            crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+    }
+    return ~crc;
+}
+
+static std::filesystem::path midi_cache_path(uint32_t crc, uint32_t size)
+{
+    char const *prefix = get_save_filename_prefix();
+    char name[32];
+    snprintf(name, sizeof(name), "%08x-%u.mid", crc, size);
+    return std::filesystem::path(prefix ? prefix : "") / "midi" / name;
+}
+
+static uint8_t *read_cached_midi(const std::filesystem::path &path,
+                                 uint32_t &data_size)
+{
+    FILE *file = fopen(path.string().c_str(), "rb");
+    if (!file)
+        return nullptr;
+
+    uint8_t *data = nullptr;
+    long size = 0;
+    if (fseek(file, 0, SEEK_END) == 0 && (size = ftell(file)) > 0
+        && fseek(file, 0, SEEK_SET) == 0)
+    {
+        data = static_cast<uint8_t *>(malloc(size));
+        if (fread(data, 1, size, file) != static_cast<size_t>(size))
+        {
+            free(data);
+            data = nullptr;
+        }
+    }
+    fclose(file);
+
+    if (data)
+        data_size = static_cast<uint32_t>(size);
+    return data;
+}
+
+// Written under a temporary name first, so that a crash or another
+// instance of the game never leaves a truncated song behind
+static void write_cached_midi(const std::filesystem::path &path,
+                              const uint8_t *data, uint32_t data_size)
+{
+    std::error_code ec;
+    std::filesystem::create_directories(path.parent_path(), ec);
+
+    std::filesystem::path temp = path;
+    temp += ".tmp";
+    FILE *file = fopen(temp.string().c_str(), "wb");
+    if (!file)
+        return;
+    bool ok = fwrite(data, 1, data_size, file) == data_size;
+    ok = fclose(file) == 0 && ok;
+
+    if (ok)
+        std::filesystem::rename(temp, path, ec);
+    if (!ok || ec)
+        std::filesystem::remove(temp, ec);
+}
+
 static uint32_t get_int_from_buffer(const uint8_t *buffer)
 {
     return (buffer[3] << 24) | (buffer[2] << 16) |
@@ -283,6 +358,11 @@ uint8_t *load_hmi(char const *filename, uint32_t &data_size)
     }
     fclose(hmifile);
 
+    const auto cache_path = midi_cache_path(
+        crc32(input_buffer.get(), buffer_size), buffer_size);
+    if (uint8_t *cached = read_cached_midi(cache_path, data_size))
+        return cached;
+
     auto output_buffer = std::make_unique<uint8_t[]>(buffer_size * 10);
     uint8_t *output_buffer_ptr = output_buffer.get();
 
@@ -329,5 +409,6 @@ uint8_t *load_hmi(char const *filename, uint32_t &data_size)
     uint8_t *final_buffer = static_cast<uint8_t *>(malloc(data_size));
     std::memcpy(final_buffer, output_buffer.get(), data_size);
 
+    write_cached_midi(cache_path, final_buffer, data_size);
     return final_buffer;
 }
\ No newline at end of file
@@ -111,12 +111,19 @@ Settings::Settings()
 	this->volume_sound = 127;
 	this->volume_music = 127;
 	this->soundfont = "AWE64 Gold Presets.sf2"; // Empty = don't use custom soundfont
+	this->sfx_mixer = true;
 
 	// random
 	this->local_save = true;
 	this->grab_input = false;	 // don't grab the input
 	this->editor = false;			 // disable editor mode
 	this->physics_update = 1000 / 15; // original 65ms/15 FPS
+	this->frame_rate = 60;
+	this->interpolate = false;
+	this->lisp_aot = true;
+	this->lisp_lexical = false;
+	this->batch_ai = false;
+	this->spatial_index = false;
 	this->mouse_scale = 0;		 // match desktop
 	this->big_font = false;
 	this->language = "english";
@@ -221,6 +228,8 @@ bool Settings::CreateConfigFile()
 	fprintf(out, "mono=%d\n", this->mono);
 	fprintf(out, "; Path to custom soundfont file (optional)\n");
 	fprintf(out, "soundfont=%s\n\n", this->soundfont.c_str());
+	fprintf(out, "; Mix sound effects with pitch and voice priorities (0 to play them on SDL_mixer channels)\n");
+	fprintf(out, "sfx_mixer=%d\n\n", this->sfx_mixer);
 
 	fprintf(out, "; RANDOM SETTINGS\n\n");
 	fprintf(out, "; Enable editor mode\n");
@@ -235,6 +244,24 @@ bool Settings::CreateConfigFile()
 	fprintf(out, "; Physics update time in ms (65ms/15FPS original)\n");
 	fprintf(out, "physics_update=%d\n\n", this->physics_update);
 
+	fprintf(out, "; Maximum frames drawn per second, 0 for no limit (use with vsync)\n");
+	fprintf(out, "frame_rate=%d\n\n", this->frame_rate);
+
+	fprintf(out, "; Smooth movement between physics updates when drawing faster than them\n");
+	fprintf(out, "interpolate=%d\n\n", this->interpolate);
+
+	fprintf(out, "; Run the compiled versions of the game's Lisp functions (0 to interpret them)\n");
+	fprintf(out, "lisp_aot=%d\n\n", this->lisp_aot);
+
+	fprintf(out, "; Keep the locals of Lisp functions in slots instead of rebinding symbols (experimental)\n");
+	fprintf(out, "lisp_lexical=%d\n\n", this->lisp_lexical);
+
+	fprintf(out, "; Group objects by type when running their AI (not used in demos and network games)\n");
+	fprintf(out, "batch_ai=%d\n\n", this->batch_ai);
+
+	fprintf(out, "; Look up the objects near the views in a grid (not used in demos, network games and the editor)\n");
+	fprintf(out, "spatial_index=%d\n\n", this->spatial_index);
+
 	fprintf(out, "; Bullet time (%%)\n");
 	fprintf(out, "bullet_time=%d\n\n", (int)(this->bullet_time_add * 100));
 
@@ -380,6 +407,8 @@ bool Settings::ReadConfigFile()
 			this->volume_music = AR_ToInt(value);
 		else if (attr == "soundfont")
 			this->soundfont = value;
+		else if (attr == "sfx_mixer")
+			this->sfx_mixer = AR_ToBool(value);
 
 		// random
 		else if (attr == "local_save")
@@ -390,6 +419,18 @@ bool Settings::ReadConfigFile()
 			this->editor = AR_ToBool(value);
 		else if (attr == "physics_update")
 			this->physics_update = AR_ToInt(value);
+		else if (attr == "frame_rate")
+			this->frame_rate = AR_ToInt(value);
+		else if (attr == "interpolate")
+			this->interpolate = AR_ToBool(value);
+		else if (attr == "lisp_aot")
+			this->lisp_aot = AR_ToBool(value);
+		else if (attr == "lisp_lexical")
+			this->lisp_lexical = AR_ToBool(value);
+		else if (attr == "batch_ai")
+			this->batch_ai = AR_ToBool(value);
+		else if (attr == "spatial_index")
+			this->spatial_index = AR_ToBool(value);
 		else if (attr == "mouse_scale")
 			this->mouse_scale = AR_ToInt(value);
 		else if (attr == "big_font")
@@ -36,12 +36,19 @@ public:
 	int volume_sound;			 // 0-127
 	int volume_music;			 // 0-127
 	std::string soundfont; // Path to custom soundfont file
+	bool sfx_mixer;				 // mix sound effects in the engine rather than on SDL_mixer channels
 
 	// random
 	bool local_save;
 	bool grab_input;			// lock the input to the window
 	bool editor;					// enable editor mode
 	short physics_update; // custom pysics update time in miliseconds
+	short frame_rate;			// draw rate cap in frames per second, 0 = uncapped (use with vsync)
+	bool interpolate;			// blend object and view positions between physics ticks when drawing
+	bool lisp_aot;				// run the Lisp functions compiled at build time
+	bool lisp_lexical;			// give Lisp functions that allow it lexical locals
+	bool batch_ai;				// run the AI of all objects of a type back to back
+	bool spatial_index;			// find the objects near the views without walking them all
 	short mouse_scale;		// mouse scaling in fullscreen, 0 - match desktop, 1 - match game screen
 	bool big_font;				// big font doesn't render properly (there are lines under letters and stuff)
 	std::string language; // language
@@ -30,6 +30,10 @@
 #include <memory>
 #include <system_error>
 #include <algorithm>
+#include <atomic>
+#include <vector>
+#include <map>
+#include <deque>
 
 #include "SDL.h"
 #include "SDL_mixer.h"
@@ -38,6 +42,7 @@
 #include "hmi.h"
 #include "specs.h"
 #include "setup.h"
+#include "dprint.h"
 
 // Global settings object (defined setup.cpp)
 extern Settings settings;
@@ -45,6 +50,537 @@ extern Settings settings;
 int enabled = 0;          // Indicates if sound system is operational
 SDL_AudioSpec audio_spec; // Stores current audio specifications
 
+/*
+ * Sound effect mixer
+ *
+ * SDL_mixer still owns the audio device and plays the music, but sound
+ * effects are mixed here: its post-mix hook hands us every buffer it
+ * produced and the voices below are added on top. Unlike a channel, a
+ * voice can be resampled for pitch, and when all of them are busy the
+ * quietest one gives way to a louder request instead of the new sound
+ * being lost. Requests too quiet to hear, and more than a few starts of
+ * the same effect within one mixer pass (they would land on the same
+ * buffer and only sound louder), are dropped before taking a voice.
+ *
+ * Effects are freed on level loads while they may still be playing. The
+ * game does not wait for them: their voices, or SDL_mixer channels when
+ * the mixer is off, fade out on the audio thread and the chunk is put on
+ * the retired list, to be freed by a later call once nothing plays it.
+ */
+namespace
+{
+constexpr int MAX_VOICES = 32;     // voices mixed at once
+constexpr int MAX_SAME_VOICES = 4; // voices playing one effect at once
+constexpr int MAX_SAME_STARTS = 2; // starts of one effect per mixer pass
+constexpr int MIN_AUDIBLE = 2;     // quieter requests (0-127) are culled
+constexpr int FADE_MS = 100;       // fade out of the effects being freed
+
+struct Voice
+{
+    sound_effect const *effect; // nullptr once the effect is freed
+    Mix_Chunk *chunk;           // nullptr when the voice is free
+    uint32_t pos;      // in sample frames, 16.16 fixed point
+    uint32_t step;     // 1.0 plays at the recorded pitch
+    int left, right;   // gains, 1.0 = 32768
+    int priority;      // requested volume, quieter voices are stolen first
+    uint32_t serial;   // start order, older voices are stolen first
+    int fade;          // frames left to fade out, -1 if not fading
+};
+
+Voice voices[MAX_VOICES];
+SDL_mutex *voice_mutex = nullptr; // guards everything the audio thread sees
+std::vector<Mix_Chunk *> channel_chunks; // what each SDL_mixer channel plays
+std::vector<Mix_Chunk *> retired;        // chunks to free once silent
+bool soft_mixer = false;
+int mix_channels = 2;
+uint32_t voice_serial = 0;
+std::atomic<uint32_t> mix_passes(0);
+std::vector<int32_t> mix_buffer; // only touched by the audio thread
+
+struct MixerStats
+{
+    int requests, culled, limited, stolen, dropped, peak;
+} stats;
+
+// Called by SDL_mixer on the audio thread when a channel stops
+void channel_finished(int channel)
+{
+    SDL_LockMutex(voice_mutex);
+    if (channel >= 0 && channel < static_cast<int>(channel_chunks.size()))
+        channel_chunks[channel] = nullptr;
+    SDL_UnlockMutex(voice_mutex);
+}
+
+// Frees the retired chunks no voice or channel plays any more
+void free_retired()
+{
+    SDL_LockMutex(voice_mutex);
+    std::vector<Mix_Chunk *> silent;
+    for (size_t i = 0; i < retired.size(); )
+    {
+        Mix_Chunk *chunk = retired[i];
+        bool busy = std::find(channel_chunks.begin(), channel_chunks.end(),
+                              chunk) != channel_chunks.end();
+        for (Voice const &v : voices)
+            busy = busy || v.chunk == chunk;
+
+        if (busy)
+            i++;
+        else
+        {
+            silent.push_back(chunk);
+            retired[i] = retired.back();
+            retired.pop_back();
+        }
+    }
+    SDL_UnlockMutex(voice_mutex);
+
+    // Outside of the lock, SDL_mixer takes the audio lock to free a chunk
+    for (Mix_Chunk *chunk : silent)
+        Mix_FreeChunk(chunk);
+}
+
+bool quieter(Voice const &a, Voice const &b)
+{
+    return a.priority < b.priority
+           || (a.priority == b.priority && a.serial < b.serial);
+}
+
+// Called by SDL_mixer on the audio thread with the music already in stream
+void mix_voices(void *udata, Uint8 *stream, int len)
+{
+    int16_t *out = reinterpret_cast<int16_t *>(stream);
+    int const samples = len / static_cast<int>(sizeof(int16_t));
+    int const frames = samples / mix_channels;
+
+    mix_buffer.assign(out, out + samples);
+
+    SDL_LockMutex(voice_mutex);
+    int const fade_frames = std::max(1, audio_spec.freq * FADE_MS / 1000);
+    for (Voice &v : voices)
+    {
+        if (!v.chunk)
+            continue;
+
+        int16_t const *src = reinterpret_cast<int16_t const *>(v.chunk->abuf);
+        uint32_t const length = v.chunk->alen / (sizeof(int16_t) * mix_channels);
+
+        // Inaudible voices keep their place in the sound but are not mixed
+        if (!v.left && !v.right)
+        {
+            v.pos += v.step * frames;
+            if ((v.pos >> 16) >= length || v.fade >= 0)
+                v.chunk = nullptr;
+            continue;
+        }
+
+        for (int i = 0; i < frames; i++)
+        {
+            uint32_t const n = v.pos >> 16;
+            if (n >= length || v.fade == 0)
+            {
+                v.chunk = nullptr;
+                break;
+            }
+            uint32_t const next = n + 1 < length ? n + 1 : n;
+            int64_t const frac = v.pos & 0xffff;
+
+            int64_t left = v.left, right = v.right;
+            if (v.fade > 0)
+            {
+                left = left * v.fade / fade_frames;
+                right = right * v.fade / fade_frames;
+                v.fade--;
+            }
+
+            for (int c = 0; c < mix_channels; c++)
+            {
+                int64_t a = src[n * mix_channels + c];
+                int64_t b = src[next * mix_channels + c];
+                int64_t sample = a + (((b - a) * frac) >> 16);
+                mix_buffer[i * mix_channels + c] +=
+                    static_cast<int32_t>((sample * (c ? right : left)) >> 15);
+            }
+            v.pos += v.step;
+        }
+    }
+    SDL_UnlockMutex(voice_mutex);
+
+    for (int i = 0; i < samples; i++)
+        out[i] = static_cast<int16_t>(std::clamp(mix_buffer[i], -32768, 32767));
+
+    mix_passes.fetch_add(1, std::memory_order_relaxed);
+}
+} // namespace
+
+namespace
+{
+/**
+ * @brief Reads and decodes a sound effect file
+ *
+ * Uses SDL_RWops for memory-based loading to avoid leaving files open.
+ * The chunk is converted to the format of the audio device. Safe to call
+ * from the sound bank thread.
+ *
+ * @param filename Path to the sound effect file
+ * @return Mix_Chunk* The decoded sound, nullptr on failure
+ */
+Mix_Chunk *load_chunk(char const *filename)
+{
+    // Use prefix_fopen to get the file
+    FILE *file = prefix_fopen(filename, "rb");
+    if (!file)
+    {
+        printf("Failed to open file %s\n", filename);
+        return nullptr;
+    }
+
+    // Create SDL_RWops from the FILE*
+    SDL_RWops *rw = SDL_RWFromFP(file, SDL_TRUE); // SDL_TRUE means SDL will close the file
+    if (!rw)
+    {
+        printf("Failed to create RWops for %s: %s\n", filename, SDL_GetError());
+        fclose(file);
+        return nullptr;
+    }
+
+    Mix_Chunk *chunk = Mix_LoadWAV_RW(rw, SDL_TRUE); // 1 means SDL will free the RWops
+    if (!chunk)
+    {
+        printf("Failed to load WAV from file %s: %s\n", filename, Mix_GetError());
+    }
+    return chunk;
+}
+
+/*
+ * Sound bank
+ *
+ * When a level loads, the cache queues the sound effects it expects the
+ * level to use and a thread decodes them in the background, while the
+ * rest of the level loads and during the first seconds of play. Creating
+ * one of these effects later only takes its ready chunk, instead of
+ * reading and converting the WAV file on the game thread. Decoded chunks
+ * nobody took yet are limited to BANK_BUDGET bytes; past that the queue
+ * is left for the effects to load themselves as before.
+ */
+constexpr size_t BANK_BUDGET = 32 * 1024 * 1024;
+
+struct BankEntry
+{
+    std::string filename;
+    Mix_Chunk *chunk;   // nullptr until decoded
+    bool loading;       // the bank thread is decoding it
+};
+
+std::map<int, BankEntry> bank;   // cache id -> entry, under bank_mutex
+std::deque<int> bank_queue;      // ids still to decode
+size_t bank_bytes = 0;           // decoded and not taken yet
+int bank_hits = 0, bank_misses = 0, bank_over_budget = 0;
+bool bank_quit = false;
+SDL_mutex *bank_mutex = nullptr;
+SDL_cond *bank_cond = nullptr;
+SDL_Thread *bank_thread = nullptr;
+
+int bank_loader(void *)
+{
+    SDL_LockMutex(bank_mutex);
+    while (!bank_quit)
+    {
+        if (bank_queue.empty())
+        {
+            SDL_CondWait(bank_cond, bank_mutex);
+            continue;
+        }
+
+        int id = bank_queue.front();
+        bank_queue.pop_front();
+        auto it = bank.find(id);
+        if (it == bank.end() || it->second.chunk)
+            continue;
+        if (bank_bytes >= BANK_BUDGET)
+        {
+            bank_over_budget++;
+            bank.erase(it);
+            continue;
+        }
+
+        std::string filename = it->second.filename;
+        it->second.loading = true;
+        SDL_UnlockMutex(bank_mutex);
+
+        Mix_Chunk *chunk = load_chunk(filename.c_str());
+
+        SDL_LockMutex(bank_mutex);
+        it = bank.find(id);
+        if (it != bank.end() && chunk)
+        {
+            it->second.chunk = chunk;
+            it->second.loading = false;
+            bank_bytes += chunk->alen;
+        }
+        else
+        {
+            if (it != bank.end())
+                bank.erase(it);
+            if (chunk)
+                Mix_FreeChunk(chunk);
+        }
+        SDL_CondBroadcast(bank_cond);
+    }
+    SDL_UnlockMutex(bank_mutex);
+    return 0;
+}
+
+// Returns the decoded chunk of an effect and forgets it, nullptr if the
+// bank does not have it. Waits if the bank thread is decoding it now.
+Mix_Chunk *bank_take(int id)
+{
+    if (!bank_mutex || id < 0)
+        return nullptr;
+
+    Mix_Chunk *chunk = nullptr;
+    SDL_LockMutex(bank_mutex);
+    auto it = bank.find(id);
+    while (it != bank.end() && it->second.loading)
+    {
+        SDL_CondWait(bank_cond, bank_mutex);
+        it = bank.find(id);
+    }
+    if (it != bank.end())
+    {
+        chunk = it->second.chunk;
+        if (chunk)
+            bank_bytes -= chunk->alen;
+        bank.erase(it); // still queued: it is loaded here instead
+    }
+    if (chunk)
+        bank_hits++;
+    else
+        bank_misses++;
+    SDL_UnlockMutex(bank_mutex);
+    return chunk;
+}
+} // namespace
+
+/**
+ * @brief Drops the effects queued for the previous level
+ *
+ * Frees the decoded chunks nobody took and empties the queue. Waits for
+ * the effect being decoded, if any.
+ */
+void sound_bank_reset()
+{
+    if (!bank_mutex)
+        return;
+
+    SDL_LockMutex(bank_mutex);
+    bank_queue.clear();
+    for (auto it = bank.begin(); it != bank.end(); )
+    {
+        if (it->second.loading)
+        {
+            SDL_CondWait(bank_cond, bank_mutex);
+            it = bank.begin();
+            continue;
+        }
+        if (it->second.chunk)
+            Mix_FreeChunk(it->second.chunk);
+        it = bank.erase(it);
+    }
+    bank_bytes = 0;
+    SDL_UnlockMutex(bank_mutex);
+}
+
+/**
+ * @brief Queues a sound effect to be decoded in the background
+ *
+ * @param id Cache id of the effect, passed again to the sound_effect
+ * @param filename Path to the sound effect file
+ */
+void sound_bank_queue(int id, char const *filename)
+{
+    if (!enabled || settings.no_sound)
+        return;
+
+    if (!bank_mutex)
+    {
+        bank_mutex = SDL_CreateMutex();
+        bank_cond = SDL_CreateCond();
+        bank_quit = false;
+        bank_thread = SDL_CreateThread(bank_loader, "sound bank", nullptr);
+    }
+
+    SDL_LockMutex(bank_mutex);
+    if (bank.find(id) == bank.end())
+    {
+        bank[id] = BankEntry{filename, nullptr, false};
+        bank_queue.push_back(id);
+        SDL_CondBroadcast(bank_cond);
+    }
+    SDL_UnlockMutex(bank_mutex);
+}
+
+/**
+ * @brief Prints the sound bank and mixer counters to the console
+ */
+void sound_show_stats()
+{
+    SDL_LockMutex(bank_mutex);
+    dprintf("sfx: bank has %d effects, %d KB decoded; %d taken from it, "
+            "%d loaded on demand, %d over budget\n", static_cast<int>(bank.size()),
+            static_cast<int>(bank_bytes / 1024), bank_hits, bank_misses,
+            bank_over_budget);
+    SDL_UnlockMutex(bank_mutex);
+
+    if (!soft_mixer)
+    {
+        dprintf("sfx: the mixer is off, effects play on SDL_mixer channels\n");
+        return;
+    }
+
+    int active = 0, pending = 0;
+    SDL_LockMutex(voice_mutex);
+    for (Voice const &v : voices)
+        active += v.chunk != nullptr;
+    pending = static_cast<int>(retired.size());
+    SDL_UnlockMutex(voice_mutex);
+
+    dprintf("sfx: %d of %d voices active, %d at most, %d freed effects fading\n",
+            active, MAX_VOICES, stats.peak, pending);
+    dprintf("sfx: %d requests, %d culled, %d over the same-sound limit, "
+            "%d stole a voice, %d dropped\n", stats.requests, stats.culled,
+            stats.limited, stats.stolen, stats.dropped);
+}
+
+/*
+ * Music thread
+ *
+ * Converting an HMI song and loading it into SDL_mixer, which for MIDI
+ * also sets up the soundfont synthesizer, takes a while, and switching
+ * songs waits for the old one to fade out. The song objects therefore
+ * only queue jobs for this thread and return; it runs them one by one in
+ * order, so that the old song is stopped and freed before the new one
+ * starts. Without threads the jobs run at once on the caller.
+ */
+namespace
+{
+struct MusicJob
+{
+    enum Type { LOAD, PLAY, STOP, FREE, QUIT } type;
+    std::shared_ptr<SongData> song;
+};
+
+std::deque<MusicJob> music_jobs;
+SDL_mutex *music_mutex = nullptr;
+SDL_cond *music_cond = nullptr;
+SDL_Thread *music_thread = nullptr;
+
+void run_music_job(MusicJob const &job)
+{
+    SongData &song = *job.song;
+    switch (job.type)
+    {
+    case MusicJob::LOAD:
+        // Load HMI format music file into memory
+        try
+        {
+            song.data = load_hmi(song.filename.c_str(), song.data_size);
+        }
+        catch (const std::exception &e)
+        {
+            printf("Sound: ERROR - Exception while loading %s: %s\n",
+                   song.filename.c_str(), e.what());
+        }
+        if (!song.data)
+        {
+            printf("Sound: ERROR - could not load %s\n", song.filename.c_str());
+            break;
+        }
+
+        // Create SDL_RWops for memory-based playback
+        song.rw = SDL_RWFromMem(song.data, song.data_size);
+        if (!song.rw)
+        {
+            printf("Sound: ERROR - could not create RWops for %s\n",
+                   song.filename.c_str());
+            break;
+        }
+
+        // Load music using SDL_mixer
+        song.music = Mix_LoadMUS_RW(song.rw, SDL_FALSE); // 0 means don't free the rwops
+        if (!song.music)
+        {
+            printf("Sound: ERROR - %s while loading %s\n",
+                   Mix_GetError(), song.filename.c_str());
+        }
+        break;
+
+    case MusicJob::PLAY:
+        if (song.music)
+        {
+            Mix_PlayMusic(song.music, -1);
+            Mix_VolumeMusic(song.volume);
+        }
+        song.play_pending--;
+        break;
+
+    case MusicJob::STOP:
+        Mix_FadeOutMusic(100); // Always fade out over 100ms to avoid audio pops
+        break;
+
+    case MusicJob::FREE:
+        if (song.music)
+            Mix_FreeMusic(song.music); // waits for the fade out
+        if (song.rw)
+            SDL_FreeRW(song.rw);
+        free(song.data); // Using free because it was allocated by load_hmi
+        song.music = nullptr;
+        song.rw = nullptr;
+        song.data = nullptr;
+        break;
+
+    case MusicJob::QUIT:
+        break;
+    }
+
+    // Whether or not it worked, the song will not be loaded any further
+    if (job.type == MusicJob::LOAD || job.type == MusicJob::FREE)
+        song.loaded.store(true);
+}
+
+int music_loop(void *)
+{
+    for (;;)
+    {
+        SDL_LockMutex(music_mutex);
+        while (music_jobs.empty())
+            SDL_CondWait(music_cond, music_mutex);
+        MusicJob job = music_jobs.front();
+        music_jobs.pop_front();
+        SDL_UnlockMutex(music_mutex);
+
+        if (job.type == MusicJob::QUIT)
+            return 0;
+        run_music_job(job);
+    }
+}
+
+void music_queue(MusicJob::Type type, std::shared_ptr<SongData> const &song)
+{
+    MusicJob job{type, song};
+    if (!music_thread)
+    {
+        run_music_job(job);
+        return;
+    }
+
+    SDL_LockMutex(music_mutex);
+    music_jobs.push_back(job);
+    SDL_CondSignal(music_cond);
+    SDL_UnlockMutex(music_mutex);
+}
+} // namespace
+
 /**
  * @brief Initializes the sound system
  *
@@ -119,6 +655,22 @@ int sound_init(int argc, char **argv)
                   &temp_channels);
     audio_spec.channels = static_cast<uint8_t>(temp_channels & 0xFF);
 
+    // Mix the sound effects ourselves if the device takes 16-bit samples
+    soft_mixer = settings.sfx_mixer && audio_spec.format == AUDIO_S16SYS
+                 && (audio_spec.channels == 1 || audio_spec.channels == 2);
+    voice_mutex = SDL_CreateMutex();
+    channel_chunks.assign(Mix_AllocateChannels(-1), nullptr);
+    Mix_ChannelFinished(channel_finished);
+    if (soft_mixer)
+    {
+        mix_channels = audio_spec.channels;
+        Mix_SetPostMix(mix_voices, nullptr);
+    }
+
+    music_mutex = SDL_CreateMutex();
+    music_cond = SDL_CreateCond();
+    music_thread = SDL_CreateThread(music_loop, "music", nullptr);
+
     // Enable both SFX and music subsystems
     enabled = SFX_INITIALIZED | MUSIC_INITIALIZED;
 
@@ -136,79 +688,121 @@ void sound_uninit()
     if (!enabled)
         return;
 
+    // Lets the jobs queued so far run, songs still alive are not freed
+    if (music_thread)
+    {
+        music_queue(MusicJob::QUIT, std::make_shared<SongData>());
+        SDL_WaitThread(music_thread, nullptr);
+        music_thread = nullptr;
+    }
+    SDL_DestroyCond(music_cond);
+    SDL_DestroyMutex(music_mutex);
+    music_cond = nullptr;
+    music_mutex = nullptr;
+
+    if (bank_mutex)
+    {
+        sound_bank_reset();
+        SDL_LockMutex(bank_mutex);
+        bank_quit = true;
+        SDL_CondBroadcast(bank_cond);
+        SDL_UnlockMutex(bank_mutex);
+        SDL_WaitThread(bank_thread, nullptr);
+        SDL_DestroyCond(bank_cond);
+        SDL_DestroyMutex(bank_mutex);
+        bank_thread = nullptr;
+        bank_cond = nullptr;
+        bank_mutex = nullptr;
+    }
+
+    if (soft_mixer)
+        Mix_SetPostMix(nullptr, nullptr);
+    Mix_ChannelFinished(nullptr);
+    Mix_HaltChannel(-1);
+    for (Voice &v : voices)
+        v.chunk = nullptr;
+    std::fill(channel_chunks.begin(), channel_chunks.end(), nullptr);
+    free_retired();
+
     Mix_CloseAudio();
     Mix_Quit();
+    if (voice_mutex)
+        SDL_DestroyMutex(voice_mutex);
+    voice_mutex = nullptr;
+    soft_mixer = false;
     enabled = false;
 }
 
+
 /**
  * @brief Constructor for sound effect objects
  *
- * Loads a sound effect from a file and prepares it for playback.
- * Uses SDL_RWops for memory-based loading to avoid leaving files open.
+ * Takes the sound from the sound bank if it was queued there, or loads
+ * it from the file.
  *
  * @param filename Path to the sound effect file
+ * @param id Cache id of the effect, -1 if it is not in the cache
  */
-sound_effect::sound_effect(char const *filename)
-    : m_chunk(nullptr)
+sound_effect::sound_effect(char const *filename, int id)
+    : m_chunk(nullptr),
+      m_mix_pass(0),
+      m_pass_starts(0)
 {
     if (!enabled)
         return;
 
-    // Use prefix_fopen to get the file
-    FILE *file = prefix_fopen(filename, "rb");
-    if (!file)
-    {
-        printf("Failed to open file %s\n", filename);
-        return;
-    }
+    free_retired();
 
-    // Create SDL_RWops from the FILE*
-    SDL_RWops *rw = SDL_RWFromFP(file, SDL_TRUE); // SDL_TRUE means SDL will close the file
-    if (!rw)
-    {
-        printf("Failed to create RWops for %s: %s\n", filename, SDL_GetError());
-        fclose(file);
-        return;
-    }
-
-    m_chunk = Mix_LoadWAV_RW(rw, SDL_TRUE); // 1 means SDL will free the RWops
+    m_chunk = bank_take(id);
     if (!m_chunk)
-    {
-        printf("Failed to load WAV from file %s: %s\n", filename, Mix_GetError());
-    }
+        m_chunk = load_chunk(filename);
 }
 
 /**
  * @brief Destructor for sound effect objects
  *
- * Ensures all instances of this sound effect stop playing
- * before freeing resources. Uses fade out to avoid audio pops.
+ * Fades out the instances of this sound effect still playing and retires
+ * its chunk, which is freed by a later call once they are silent. Never
+ * waits for the audio thread.
  */
 sound_effect::~sound_effect()
 {
-    if (!enabled)
+    if (!enabled || !m_chunk)
         return;
 
-    // Sound effect deletion only happens on level load
-    Mix_FadeOutGroup(-1, 100); // Fade out all channels over 100ms
-    while (Mix_Playing(-1))
-    { // Wait for all sounds to finish
-        SDL_Delay(10);
-    }
-
-    if (m_chunk)
-    {
-        Mix_FreeChunk(m_chunk);
-        m_chunk = nullptr;
-    }
+    SDL_LockMutex(voice_mutex);
+    for (Voice &v : voices)
+        if (v.effect == this)
+        {
+            v.effect = nullptr;
+            v.priority = -1; // first to be stolen
+            if (v.fade < 0)
+                v.fade = std::max(1, audio_spec.freq * FADE_MS / 1000);
+        }
+    std::vector<int> fading;
+    for (size_t i = 0; i < channel_chunks.size(); i++)
+        if (channel_chunks[i] == m_chunk)
+            fading.push_back(static_cast<int>(i));
+    retired.push_back(m_chunk);
+    SDL_UnlockMutex(voice_mutex);
+
+    // channel_finished takes the lock, so not from inside it
+    for (int channel : fading)
+        Mix_FadeOutChannel(channel, FADE_MS);
+
+    m_chunk = nullptr;
+    free_retired();
 }
 
 /**
  * @brief Plays a sound effect with specified parameters
  *
+ * The volume is also the priority of the sound: when every voice of the
+ * mixer is busy, the new sound takes the place of the quietest one if it
+ * is at least as loud, and is dropped otherwise.
+ *
  * @param volume Volume level (0-127)
- * @param pitch Pitch adjustment (unused in current implementation)
+ * @param pitch Playback rate, 128 plays the sound as recorded (mixer only)
  * @param panpot Stereo panning (0=left, 128=center, 255=right)
  */
 void sound_effect::play(int volume, int pitch, int panpot)
@@ -220,6 +814,88 @@ void sound_effect::play(int volume, int pitch, int panpot)
     volume = std::clamp(volume, 0, 127);
     panpot = std::clamp(panpot, 0, 255);
 
+    if (soft_mixer)
+    {
+        stats.requests++;
+        if (volume < MIN_AUDIBLE)
+        {
+            stats.culled++;
+            return;
+        }
+
+        uint32_t pass = mix_passes.load(std::memory_order_relaxed);
+        if (pass != m_mix_pass)
+        {
+            m_mix_pass = pass;
+            m_pass_starts = 0;
+        }
+        if (m_pass_starts >= MAX_SAME_STARTS)
+        {
+            stats.limited++;
+            return;
+        }
+
+        SDL_LockMutex(voice_mutex);
+
+        Voice *slot = nullptr, *quietest = nullptr, *quietest_same = nullptr;
+        int same = 0, active = 0;
+        for (Voice &v : voices)
+        {
+            if (!v.chunk)
+            {
+                if (!slot)
+                    slot = &v;
+                continue;
+            }
+            active++;
+            if (!quietest || quieter(v, *quietest))
+                quietest = &v;
+            if (v.effect == this)
+            {
+                same++;
+                if (!quietest_same || quieter(v, *quietest_same))
+                    quietest_same = &v;
+            }
+        }
+
+        // Too many of this sound already: it can only replace one of its own
+        Voice *victim = same >= MAX_SAME_VOICES ? quietest_same
+                        : slot ? nullptr : quietest;
+        if (victim)
+        {
+            slot = nullptr;
+            if (victim->priority <= volume)
+            {
+                slot = victim;
+                stats.stolen++;
+                active--;
+            }
+        }
+
+        if (slot)
+        {
+            int const left = mix_channels == 2 ? panpot : 255;
+            int const right = mix_channels == 2 ? 255 - panpot : 255;
+
+            slot->effect = this;
+            slot->chunk = m_chunk;
+            slot->pos = 0;
+            slot->step = static_cast<uint32_t>(std::clamp(pitch, 16, 512)) << 9;
+            slot->left = volume * left * 32768 / (128 * 255);
+            slot->right = volume * right * 32768 / (128 * 255);
+            slot->priority = volume;
+            slot->serial = voice_serial++;
+            slot->fade = -1;
+            stats.peak = std::max(stats.peak, active + 1);
+            m_pass_starts++;
+        }
+        else
+            stats.dropped++;
+
+        SDL_UnlockMutex(voice_mutex);
+        return;
+    }
+
     // Play on first available channel (-1)
     int channel = Mix_PlayChannel(-1, m_chunk, 0);
     if (channel > -1)
@@ -228,97 +904,64 @@ void sound_effect::play(int volume, int pitch, int panpot)
         Mix_SetPanning(channel,
                        static_cast<uint8_t>(panpot),
                        static_cast<uint8_t>(255 - panpot));
+
+        // A short sound may already be over, channel_finished missed it
+        SDL_LockMutex(voice_mutex);
+        if (channel < static_cast<int>(channel_chunks.size()))
+            channel_chunks[channel] = m_chunk;
+        SDL_UnlockMutex(voice_mutex);
+        if (!Mix_Playing(channel))
+            channel_finished(channel);
     }
 }
 
 /**
  * @brief Constructor for music/song objects
  *
- * Loads a music file (HMI format) and prepares it for playback.
- * Uses SDL_RWops for memory-based playback to avoid keeping files open.
+ * Queues the song to be converted from HMI and loaded by the music thread,
+ * the game goes on meanwhile.
  *
  * @param filename Path to the music file
  */
 song::song(char const *filename)
-    : data(nullptr) // Raw music data
-      ,
-      song_id(0) // Playback identifier
-      ,
-      rw(nullptr) // SDL memory operations
-      ,
-      music(nullptr) // SDL mixer music object
+    : Name(nullptr),
+      song_id(0), // Playback identifier
+      m_data(std::make_shared<SongData>())
 {
-    if (!filename)
+    if (!filename || !enabled)
         return;
 
-    try
-    {
-        // Load HMI format music file into memory
-        uint32_t data_size;
-        data = load_hmi(filename, data_size);
-
-        if (!data)
-        {
-            printf("Sound: ERROR - could not load %s\n", filename);
-            return;
-        }
-
-        // Create SDL_RWops for memory-based playback
-        rw = SDL_RWFromMem(data, data_size);
-        if (!rw)
-        {
-            printf("Sound: ERROR - could not create RWops for %s\n",
-                   filename);
-            return;
-        }
-
-        // Load music using SDL_mixer
-        music = Mix_LoadMUS_RW(rw, SDL_FALSE); // 0 means don't free the rwops
-
-        if (!music)
-        {
-            printf("Sound: ERROR - %s while loading %s\n",
-                   Mix_GetError(), filename);
-        }
-    }
-    catch (const std::exception &e)
-    {
-        printf("Sound: ERROR - Exception while loading %s: %s\n",
-               filename, e.what());
-    }
+    m_data->filename = filename;
+    music_queue(MusicJob::LOAD, m_data);
 }
 
 /**
  * @brief Destructor for music/song objects
  *
- * Stops playback and frees all allocated resources.
+ * Stops playback; the music thread frees the song once it has faded out.
  */
 song::~song()
 {
     if (playing())
         stop();
-
-    free(data); // Using free because it was allocated by load_hmi    
-
-    if (music)
-        Mix_FreeMusic(music);
-    if (rw)
-        SDL_FreeRW(rw);
+    if (enabled)
+        music_queue(MusicJob::FREE, m_data);
 }
 
 /**
- * @brief Starts playing the music
+ * @brief Starts playing the music, as soon as it is loaded
  *
  * @param volume Volume level (0-127)
  */
 void song::play(unsigned char volume)
 {
-    if (!enabled || settings.no_music || !music)
+    if (!enabled || settings.no_music)
         return;
 
     song_id = 1;
-    Mix_PlayMusic(music, -1);
-    Mix_VolumeMusic(std::clamp(static_cast<int>(volume), 0, 127));
+    m_data->volume = std::clamp(static_cast<int>(volume), 0, 127);
+    m_data->play_pending++;
+    music_queue(MusicJob::PLAY, m_data);
 }
 
 /**
@@ -329,17 +972,22 @@ void song::play(unsigned char volume)
 void song::stop(long fadeout_time)
 {
     song_id = 0;
-    Mix_FadeOutMusic(100); // Always fade out over 100ms to avoid audio pops
+    if (enabled)
+        music_queue(MusicJob::STOP, m_data);
 }
 
 /**
  * @brief Checks if music is currently playing
  *
+ * A song still loading, or waiting for the music thread to start it, counts
+ * as playing if it was asked to play.
+ *
  * @return int Non-zero if music is playing, 0 otherwise
  */
 int song::playing()
 {
-    return Mix_PlayingMusic();
+    return Mix_PlayingMusic() ||
+           (song_id && (!m_data->loaded.load() || m_data->play_pending.load()));
 }
 
 /**
@@ -349,6 +997,7 @@ int song::playing()
  */
 void song::set_volume(int volume)
 {
-    if (music)
+    m_data->volume = volume;
+    if (m_data->loaded.load())
         Mix_VolumeMusic(volume);
-}
\ No newline at end of file
+}
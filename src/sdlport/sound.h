@@ -12,6 +12,10 @@
 #define __SOUND_H__
 
 
+#include <string>
+#include <memory>
+#include <atomic>
+
 #include "SDL_mixer.h"
 
 
@@ -24,17 +28,35 @@
 
 int sound_init(int argc, char **argv);
 void sound_uninit();
+void sound_show_stats();
+void sound_bank_queue(int id, char const *filename);
+void sound_bank_reset();
 
 class sound_effect
 {
 public:
-    sound_effect(char const *filename);
+    sound_effect(char const *filename, int id = -1);
     ~sound_effect();
 
     void play(int volume = 127, int pitch = 128, int panpot = 128);
 
 private:
     Mix_Chunk* m_chunk;
+    uint32_t m_mix_pass;  // mixer pass of the last start, see sound.cpp
+    int m_pass_starts;    // starts during that pass
+};
+
+// Filled in by the music thread, see sound.cpp
+struct SongData
+{
+    std::string filename;
+    uint8_t *data = nullptr;
+    uint32_t data_size = 0;
+    SDL_RWops *rw = nullptr;
+    Mix_Music *music = nullptr;
+    std::atomic<int> volume{127};
+    std::atomic<bool> loaded{false}; // the thread is done loading it
+    std::atomic<int> play_pending{0}; // PLAY jobs the thread has yet to run
 };
 
 class song
@@ -49,10 +71,8 @@ public:
 
 private:
     char *Name;
-    unsigned char *data;
     unsigned long song_id;
-    Mix_Music* music;
-    SDL_RWops* rw;
+    std::shared_ptr<SongData> m_data;
 };
 
 #endif
@@ -0,0 +1,819 @@
+/*
+ *  Abuse - dark 2D side-scrolling platform game
+ *  Copyright (c) 1995 Crack dot Com
+ *  Copyright (c) 2005-2011 Sam Hocevar <sam@hocevar.net>
+ *
+ *  This software was released into the Public Domain. As with most public
+ *  domain software, no warranty is made or implied by Crack dot Com, by
+ *  Jonathan Clark, or by Sam Hocevar.
+ */
+
+/*
+ * abuse-lispc - translate the defuns of Lisp source files to C++
+ *
+ *   abuse-lispc -o lisp_aot_gen.cpp file.lsp...
+ *
+ * Files are read with the game's own reader, so the compiled bodies are
+ * hashed from exactly the lists the game will build when it loads them.
+ * Each body is translated form by form: the core builtins (arithmetic,
+ * comparisons, if, progn, let, setq, select...) become C++, calls to C
+ * functions build their argument list directly, and everything else is
+ * handed back to the interpreter. See lisp_aot.h for the runtime side.
+ */
+
+#if defined HAVE_CONFIG_H
+#   include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+
+#include "common.h"
+
+#include "lisp.h"
+#include "lisp_gc.h"
+#include "lisp_aot.h"
+#include "symbols.h"
+#include "cache.h"
+#include "dprint.h"
+
+// The reader does not need any of the game, but lisp.cpp refers to it
+void clisp_init() { }
+long c_caller(long number, void *arg) { return 0; }
+void *l_caller(long number, void *arg) { return NULL; }
+void *l_obj_get(long number) { return NULL; }
+void l_obj_set(long number, void *arg) { }
+void l_obj_print(long number) { }
+CrcManager crc_manager;
+CrcManager::CrcManager() { total_files = 0; files = NULL; }
+int CrcManager::get_filenumber(char const *filename) { return 0; }
+
+static void print_stderr(char *st)
+{
+    fputs(st, stderr);
+}
+
+class LispCompiler
+{
+public:
+    LispCompiler() : m_functions(0), m_native(0), m_fallback(0) { }
+
+    void CompileFile(char const *filename);
+    bool Write(char const *filename);
+
+private:
+    enum Kind { K_OBJ, K_INT, K_BOOL };
+
+    struct Value
+    {
+        Value(std::string const &e, Kind k) : expr(e), kind(k) { }
+        std::string expr;
+        Kind kind;
+    };
+
+    void CompileDefun(LObject *form, char const *source);
+
+    Value Compile(LObject *x);
+    Value CompileBlock(LObject *list);
+    Value CompileSys(LObject *x, int fun);
+    Value CompileCall(LObject *x, LSymbol *sym);
+    Value Fallback(LObject *x);
+
+    std::string ToObj(Value const &v);
+    std::string ToInt(Value const &v);
+    std::string ToBool(Value const &v);
+
+    std::string NewTmp(Kind kind, std::string const &init);
+    std::string Form(LObject *x);
+    std::string Sym(LSymbol *sym);
+    static bool IsPure(LObject *x);
+    static int Length(LObject *list);
+
+    void Line(char const *format, ...);
+    void Open() { Line("{"); m_indent++; }
+    void Close() { m_indent--; Line("}"); }
+
+    // Per function state
+    std::string m_body;
+    std::map<LObject *, size_t> m_forms;
+    int m_indent, m_tmp;
+
+    // Per file state
+    std::string m_code;
+    std::vector<std::string> m_entries;
+    std::set<std::pair<std::string, uint32_t> > m_seen;
+    std::vector<std::string> m_symbols;
+    std::map<std::string, int> m_symbol_ids;
+    int m_functions, m_native, m_fallback;
+};
+
+void LispCompiler::Line(char const *format, ...)
+{
+    char buf[1024];
+    va_list ap;
+    va_start(ap, format);
+    vsnprintf(buf, sizeof(buf), format, ap);
+    va_end(ap);
+    m_body.append(4 * m_indent, ' ');
+    m_body += buf;
+    m_body += '\n';
+}
+
+std::string LispCompiler::NewTmp(Kind kind, std::string const &init)
+{
+    char name[16];
+    sprintf(name, "t%d", m_tmp++);
+    switch (kind)
+    {
+    case K_INT:
+        Line("int32_t %s = %s;", name, init.c_str());
+        break;
+    case K_BOOL:
+        Line("bool %s = %s;", name, init.c_str());
+        break;
+    case K_OBJ:
+        // Anything held while something else gets evaluated may be moved
+        // by the garbage collector, so all objects are registered.
+        Line("LObject *%s = %s;", name, init.c_str());
+        Line("PtrRef r%s(%s);", name, name);
+        break;
+    }
+    return name;
+}
+
+std::string LispCompiler::Form(LObject *x)
+{
+    std::map<LObject *, size_t>::iterator it = m_forms.find(x);
+    if (it == m_forms.end())
+    {
+        fprintf(stderr, "abuse-lispc: form not found in body\n");
+        exit(1);
+    }
+    char buf[32];
+    sprintf(buf, "AOT_FORM(%d)", (int)it->second);
+    return buf;
+}
+
+std::string LispCompiler::Sym(LSymbol *sym)
+{
+    std::string name = lstring_value(sym->GetName());
+    std::map<std::string, int>::iterator it = m_symbol_ids.find(name);
+    int id;
+    if (it == m_symbol_ids.end())
+    {
+        id = (int)m_symbols.size();
+        m_symbols.push_back(name);
+        m_symbol_ids[name] = id;
+    }
+    else
+        id = it->second;
+
+    char buf[32];
+    sprintf(buf, "AOT_SYM(%d)", id);
+    return buf;
+}
+
+int LispCompiler::Length(LObject *list)
+{
+    int n = 0;
+    for (; list; list = CDR(list), n++)
+        if (item_type(list) != L_CONS_CELL)
+            return -1;
+    return n;
+}
+
+// Evaluating these twice in a row gives the same result and has no effect
+bool LispCompiler::IsPure(LObject *x)
+{
+    if (item_type(x) != L_CONS_CELL || !x)
+        return true;
+    LObject *f = CAR(x);
+    return item_type(f) == L_SYMBOL && f == quote_symbol;
+}
+
+std::string LispCompiler::ToObj(Value const &v)
+{
+    switch (v.kind)
+    {
+    case K_INT:
+        // May allocate a cell on 32-bit systems, so keep it registered
+        return NewTmp(K_OBJ, "LNumber::Create(" + v.expr + ")");
+    case K_BOOL:
+        return "lisp_aot_bool(" + v.expr + ")";
+    default:
+        return v.expr;
+    }
+}
+
+std::string LispCompiler::ToInt(Value const &v)
+{
+    switch (v.kind)
+    {
+    case K_INT:
+        return v.expr;
+    case K_BOOL:
+        return "lnumber_value(lisp_aot_bool(" + v.expr + "))";
+    default:
+        return "lnumber_value(" + v.expr + ")";
+    }
+}
+
+std::string LispCompiler::ToBool(Value const &v)
+{
+    switch (v.kind)
+    {
+    case K_INT:
+        return "true";
+    case K_BOOL:
+        return v.expr;
+    default:
+        return "(" + v.expr + " != NULL)";
+    }
+}
+
+LispCompiler::Value LispCompiler::Fallback(LObject *x)
+{
+    m_fallback++;
+    return Value(NewTmp(K_OBJ, Form(x) + "->Eval()"), K_OBJ);
+}
+
+// Same as eval_block()
+LispCompiler::Value LispCompiler::CompileBlock(LObject *list)
+{
+    if (!list)
+        return Value("NULL", K_OBJ);
+
+    Value ret("NULL", K_OBJ);
+    for (; list; list = CDR(list))
+        ret = Compile(CAR(list));
+    return ret;
+}
+
+LispCompiler::Value LispCompiler::Compile(LObject *x)
+{
+    if (!x)
+        return Value("NULL", K_OBJ);
+
+    switch (item_type(x))
+    {
+    case L_NUMBER:
+    {
+        long n = LNumber::GetValue(x);
+        if (!lisp_fixnump(x))
+            return Value(Form(x), K_OBJ);
+        char buf[64];
+        if (n < -0x7fffffffL || n > 0x7fffffffL)
+        {
+            // Immediate on this host, maybe not on the target
+            sprintf(buf, "LNumber::Create(%ldL)", n);
+            return Value(NewTmp(K_OBJ, buf), K_OBJ);
+        }
+        sprintf(buf, n < 0 ? "(%ld)" : "%ld", n);
+        return Value(buf, K_INT);
+    }
+    case L_SYMBOL:
+        if (x == true_symbol)
+            return Value("(LObject *)true_symbol", K_OBJ);
+        return Value(NewTmp(K_OBJ, "lisp_aot_value(" + Sym((LSymbol *)x) + ")"),
+                     K_OBJ);
+    case L_CONS_CELL:
+        break;
+    default:
+        // Strings, characters... evaluate to themselves
+        return Value(Form(x), K_OBJ);
+    }
+
+    LObject *head = CAR(x);
+    if (item_type(head) != L_SYMBOL || !head)
+        return Fallback(x);
+
+    LObject *fun = ((LSymbol *)head)->GetFunction();
+    if (item_type(fun) == L_SYS_FUNCTION)
+    {
+        int n = ((LSysFunction *)fun)->fun_number;
+        int args = Length(CDR(x));
+        if (args < 0 || (sys_funcs[n].min_args != -1
+                          && (args < sys_funcs[n].min_args
+                               || (sys_funcs[n].max_args != -1
+                                    && args > sys_funcs[n].max_args))))
+            return Fallback(x); // let the interpreter complain
+        return CompileSys(x, n);
+    }
+
+    if (Length(CDR(x)) < 0)
+        return Fallback(x);
+    return CompileCall(x, (LSymbol *)head);
+}
+
+// Calls to anything that is not a builtin: C functions get their argument
+// list built here, user functions and Lisp functions go through the
+// interpreter, which will run their compiled version if they have one.
+LispCompiler::Value LispCompiler::CompileCall(LObject *x, LSymbol *sym)
+{
+    m_native++;
+    std::string ret = NewTmp(K_OBJ, "NULL");
+    std::string f = NewTmp(K_OBJ, Sym(sym) + "->m_function");
+
+    Line("if (lisp_aot_cfun(%s, %d))", f.c_str(), Length(CDR(x)));
+    Open();
+    Line("LList *first = NULL, *last = NULL;");
+    Line("PtrRef rfirst(first), rlast(last);");
+    for (LObject *arg = CDR(x); arg; arg = CDR(arg))
+    {
+        Value v = Compile(CAR(arg));
+        std::string val = ToObj(v);
+        Line("lisp_aot_append(first, last);");
+        Line("last->m_car = %s;", val.c_str());
+    }
+    Line("%s = lisp_aot_ccall(%s, first);", ret.c_str(), f.c_str());
+    Close();
+    Line("else");
+    Open();
+    Line("%s = %s->EvalFunction(CDR(%s));", ret.c_str(), Sym(sym).c_str(),
+         Form(x).c_str());
+    Close();
+    return Value(ret, K_OBJ);
+}
+
+LispCompiler::Value LispCompiler::CompileSys(LObject *x, int fun)
+{
+    LObject *args = CDR(x);
+    int nargs = Length(args);
+    LObject *a0 = nargs > 0 ? CAR(args) : NULL;
+    LObject *a1 = nargs > 1 ? CAR(CDR(args)) : NULL;
+    LObject *a2 = nargs > 2 ? CAR(CDR(CDR(args))) : NULL;
+
+    switch (fun)
+    {
+    case SYS_FUNC_QUOTE:
+        return Value("CAR(CDR(" + Form(x) + "))", K_OBJ);
+
+    case SYS_FUNC_PROGN:
+        m_native++;
+        return CompileBlock(args);
+
+    case SYS_FUNC_IF:
+    case SYS_FUNC_IF_1PROGN:
+    case SYS_FUNC_IF_2PROGN:
+    case SYS_FUNC_IF_12PROGN:
+    {
+        bool then_block = fun == SYS_FUNC_IF_1PROGN || fun == SYS_FUNC_IF_12PROGN;
+        bool else_block = fun == SYS_FUNC_IF_2PROGN || fun == SYS_FUNC_IF_12PROGN;
+        if (fun != SYS_FUNC_IF && nargs != 3)
+            return Fallback(x);
+        if ((then_block && Length(a1) < 0) || (else_block && Length(a2) < 0))
+            return Fallback(x);
+
+        m_native++;
+        std::string ret = NewTmp(K_OBJ, "NULL");
+        Value c = Compile(a0);
+        Line("if (%s)", ToBool(c).c_str());
+        Open();
+        Value v = then_block ? CompileBlock(a1) : Compile(a1);
+        Line("%s = %s;", ret.c_str(), ToObj(v).c_str());
+        Close();
+        if (nargs > 2)
+        {
+            Line("else");
+            Open();
+            v = else_block ? CompileBlock(a2) : Compile(a2);
+            Line("%s = %s;", ret.c_str(), ToObj(v).c_str());
+            Close();
+        }
+        return Value(ret, K_OBJ);
+    }
+
+    case SYS_FUNC_NOT:
+    case SYS_FUNC_NULL:
+    {
+        m_native++;
+        Value v = Compile(a0);
+        if (v.kind == K_INT)
+            return Value("false", K_BOOL);
+        return Value(NewTmp(K_BOOL, "!" + ToBool(v)), K_BOOL);
+    }
+
+    case SYS_FUNC_AND:
+    case SYS_FUNC_OR:
+    {
+        m_native++;
+        bool is_and = fun == SYS_FUNC_AND;
+        std::string ret = NewTmp(K_BOOL, is_and ? "true" : "false");
+        int depth = 0;
+        for (LObject *l = args; l; l = CDR(l))
+        {
+            Value v = Compile(CAR(l));
+            Line(is_and ? "if (!%s)" : "if (%s)", ToBool(v).c_str());
+            Line(is_and ? "    %s = false;" : "    %s = true;", ret.c_str());
+            if (CDR(l))
+            {
+                Line("else");
+                Open();
+                depth++;
+            }
+        }
+        while (depth--)
+            Close();
+        return Value(ret, K_BOOL);
+    }
+
+    case SYS_FUNC_EQ:
+    {
+        m_native++;
+        Value v1 = Compile(a0);
+        Value v2 = Compile(a1);
+        if (v1.kind == K_INT && v2.kind == K_INT)
+            return Value(NewTmp(K_BOOL, v1.expr + " == " + v2.expr), K_BOOL);
+        std::string o1 = ToObj(v1), o2 = ToObj(v2);
+        return Value(NewTmp(K_BOOL, "lisp_eq(" + o1 + ", " + o2 + ") != NULL"),
+                     K_BOOL);
+    }
+
+    case SYS_FUNC_EQ0:
+    {
+        m_native++;
+        Value v = Compile(a0);
+        if (v.kind == K_INT)
+            return Value(NewTmp(K_BOOL, v.expr + " == 0"), K_BOOL);
+        if (v.kind == K_BOOL)
+            return Value("false", K_BOOL);
+        return Value(NewTmp(K_BOOL, "item_type(" + v.expr + ") == L_NUMBER && "
+                            "LNumber::GetValue(" + v.expr + ") == 0"), K_BOOL);
+    }
+
+    case SYS_FUNC_PLUS:
+    case SYS_FUNC_MINUS:
+    {
+        m_native++;
+        std::string ret;
+        for (LObject *l = args; l; l = CDR(l))
+        {
+            Value v = Compile(CAR(l));
+            if (ret.empty())
+                ret = NewTmp(K_INT, fun == SYS_FUNC_PLUS ? "0 + " + ToInt(v)
+                                                         : ToInt(v));
+            else
+                Line(fun == SYS_FUNC_PLUS ? "%s += %s;" : "%s -= %s;",
+                     ret.c_str(), ToInt(v).c_str());
+        }
+        if (ret.empty())
+            return Value("0", K_INT);
+        return Value(ret, K_INT);
+    }
+
+    case SYS_FUNC_TIMES:
+    {
+        if (!nargs)
+            return Fallback(x);
+        m_native++;
+
+        // The integer case of the interpreter evaluates every argument
+        // twice, once to look at its type and once to use it.
+        Value first = Compile(a0);
+        if (first.kind != K_OBJ)
+        {
+            if (!IsPure(a0))
+                first = Compile(a0);
+            std::string prod = NewTmp(K_INT, "1");
+            Line("%s *= %s;", prod.c_str(), ToInt(first).c_str());
+            for (LObject *l = CDR(args); l; l = CDR(l))
+            {
+                Value v = Compile(CAR(l));
+                if (!IsPure(CAR(l)))
+                    v = Compile(CAR(l));
+                Line("%s *= %s;", prod.c_str(), ToInt(v).c_str());
+            }
+            return Value(prod, K_INT);
+        }
+
+        std::string f = first.expr;
+        std::string ret = NewTmp(K_OBJ, "NULL");
+        Line("if (item_type(%s) == L_FIXED_POINT)", f.c_str());
+        Open();
+        Line("int32_t prod = (1 << 16 >> 8) * (lfixed_point_value(%s) >> 8);",
+             f.c_str());
+        for (LObject *l = CDR(args); l; l = CDR(l))
+        {
+            Value v = Compile(CAR(l));
+            Line("prod = (prod >> 8) * (lfixed_point_value(%s) >> 8);",
+                 ToObj(v).c_str());
+        }
+        Line("%s = LFixedPoint::Create(prod);", ret.c_str());
+        Close();
+        Line("else");
+        Open();
+        Line("int32_t prod = 1;");
+        if (IsPure(a0))
+            Line("prod *= lnumber_value(%s);", f.c_str());
+        else
+        {
+            Value v = Compile(a0);
+            Line("prod *= %s;", ToInt(v).c_str());
+        }
+        for (LObject *l = CDR(args); l; l = CDR(l))
+        {
+            Value v = Compile(CAR(l));
+            if (!IsPure(CAR(l)))
+                v = Compile(CAR(l));
+            Line("prod *= %s;", ToInt(v).c_str());
+        }
+        Line("%s = LNumber::Create(prod);", ret.c_str());
+        Close();
+        return Value(ret, K_OBJ);
+    }
+
+    case SYS_FUNC_SLASH:
+    {
+        m_native++;
+        std::string quot;
+        for (LObject *l = args; l; l = CDR(l))
+        {
+            Value v = Compile(CAR(l));
+            std::string n = v.kind == K_INT ? v.expr
+                          : "lisp_aot_slash_arg(" + ToObj(v) + ")";
+            if (quot.empty())
+                quot = NewTmp(K_INT, n);
+            else
+                Line("%s /= %s;", quot.c_str(), n.c_str());
+        }
+        return Value(quot, K_INT);
+    }
+
+    case SYS_FUNC_GT:
+    case SYS_FUNC_LT:
+    case SYS_FUNC_GE:
+    case SYS_FUNC_LE:
+    case SYS_FUNC_MIN:
+    case SYS_FUNC_MAX:
+    case SYS_FUNC_MOD:
+    {
+        m_native++;
+        Value v1 = Compile(a0);
+        std::string n1 = v1.kind == K_INT ? v1.expr : NewTmp(K_INT, ToInt(v1));
+        Value v2 = Compile(a1);
+        std::string n2 = ToInt(v2);
+        switch (fun)
+        {
+        case SYS_FUNC_GT: return Value(NewTmp(K_BOOL, n1 + " > " + n2), K_BOOL);
+        case SYS_FUNC_LT: return Value(NewTmp(K_BOOL, n1 + " < " + n2), K_BOOL);
+        case SYS_FUNC_GE: return Value(NewTmp(K_BOOL, n1 + " >= " + n2), K_BOOL);
+        case SYS_FUNC_LE: return Value(NewTmp(K_BOOL, n1 + " <= " + n2), K_BOOL);
+        case SYS_FUNC_MIN:
+            n2 = NewTmp(K_INT, n2);
+            return Value(NewTmp(K_INT, n1 + " < " + n2 + " ? " + n1 + " : " + n2), K_INT);
+        case SYS_FUNC_MAX:
+            n2 = NewTmp(K_INT, n2);
+            return Value(NewTmp(K_INT, n1 + " > " + n2 + " ? " + n1 + " : " + n2), K_INT);
+        default:
+            return Value(NewTmp(K_INT, "lisp_aot_mod(" + n1 + ", " + n2 + ")"), K_INT);
+        }
+    }
+
+    case SYS_FUNC_ABS:
+    {
+        m_native++;
+        Value v = Compile(a0);
+        return Value(NewTmp(K_INT, "abs(" + ToInt(v) + ")"), K_INT);
+    }
+
+    case SYS_FUNC_SETQ:
+    case SYS_FUNC_SETF:
+    {
+        if (item_type(a0) != L_SYMBOL || !a0)
+            return Fallback(x); // aref, car, cdr...
+        m_native++;
+        Value v = Compile(a1);
+        std::string val = ToObj(v);
+        return Value(NewTmp(K_OBJ, "lisp_setq(" + Sym((LSymbol *)a0) + ", "
+                                   + val + ")"), K_OBJ);
+    }
+
+    case SYS_FUNC_LET:
+    {
+        std::vector<LSymbol *> vars;
+        if (Length(a0) < 0)
+            return Fallback(x);
+        for (LObject *l = a0; l; l = CDR(l))
+        {
+            LObject *v = CAR(l);
+            if (!v || item_type(v) != L_CONS_CELL || !CAR(v)
+                 || item_type(CAR(v)) != L_SYMBOL
+                 || !CDR(v) || item_type(CDR(v)) != L_CONS_CELL)
+                return Fallback(x);
+            vars.push_back((LSymbol *)CAR(v));
+        }
+
+        m_native++;
+        std::string ret = NewTmp(K_OBJ, "NULL");
+        Open();
+        Line("size_t stack_start = l_user_stack.m_size;");
+        for (LObject *l = a0; l; l = CDR(l))
+        {
+            std::string s = Sym((LSymbol *)CAR(CAR(l)));
+            Line("l_user_stack.push(%s->m_value);", s.c_str());
+            Value v = Compile(CAR(CDR(CAR(l))));
+            Line("%s->SetValue(%s);", s.c_str(), ToObj(v).c_str());
+        }
+        Value v = CompileBlock(CDR(args));
+        Line("%s = %s;", ret.c_str(), ToObj(v).c_str());
+        for (size_t i = 0; i < vars.size(); i++)
+            Line("%s->SetValue((LObject *)l_user_stack.sdata[stack_start + %d]);",
+                 Sym(vars[i]).c_str(), (int)i);
+        Line("l_user_stack.m_size = stack_start;");
+        Close();
+        return Value(ret, K_OBJ);
+    }
+
+    case SYS_FUNC_SELECT:
+    {
+        for (LObject *l = CDR(args); l; l = CDR(l))
+            if (!CAR(l) || item_type(CAR(l)) != L_CONS_CELL
+                 || Length(CDR(CAR(l))) < 0)
+                return Fallback(x);
+
+        m_native++;
+        std::string ret = NewTmp(K_OBJ, "NULL");
+        Open();
+        std::string selector = ToObj(Compile(a0));
+        int depth = 0;
+        for (LObject *l = CDR(args); l; l = CDR(l))
+        {
+            Value key = Compile(CAR(CAR(l)));
+            Line("if (lisp_equal(%s, %s))", selector.c_str(),
+                 ToObj(key).c_str());
+            Open();
+            Value v = CompileBlock(CDR(CAR(l)));
+            if (CDR(CAR(l)))
+                Line("%s = %s;", ret.c_str(), ToObj(v).c_str());
+            Close();
+            if (CDR(l))
+            {
+                Line("else");
+                Open();
+                depth++;
+            }
+        }
+        while (depth--)
+            Close();
+        Close();
+        return Value(ret, K_OBJ);
+    }
+
+    default:
+        return Fallback(x);
+    }
+}
+
+void LispCompiler::CompileDefun(LObject *form, char const *source)
+{
+    LObject *name = lcar(lcdr(form));
+    LObject *arg_list = lcar(lcdr(lcdr(form)));
+    LObject *block_list = lcdr(lcdr(lcdr(form)));
+
+    if (!name || item_type(name) != L_SYMBOL || Length(arg_list) < 0
+         || Length(block_list) < 0)
+        return;
+    for (LObject *l = arg_list; l; l = CDR(l))
+        if (!CAR(l) || item_type(CAR(l)) != L_SYMBOL)
+            return;
+
+    std::string st = lstring_value(((LSymbol *)name)->GetName());
+    uint32_t hash = lisp_aot_hash(arg_list, block_list);
+    if (m_seen.count(std::make_pair(st, hash)))
+        return;
+    m_seen.insert(std::make_pair(st, hash));
+
+    std::vector<LObject *> forms(lisp_aot_walk(block_list, NULL) + 1);
+    lisp_aot_walk(block_list, &forms[0]);
+    m_forms.clear();
+    for (size_t i = 0; i + 1 < forms.size(); i++)
+        m_forms[forms[i]] = i;
+
+    m_body.clear();
+    m_indent = 1;
+    m_tmp = 0;
+    Value v = CompileBlock(block_list);
+    Line("return %s;", ToObj(v).c_str());
+
+    char buf[256];
+    int id = m_functions++;
+    sprintf(buf, "// %s: %s\nstatic LObject *aot_%d(LArray *const &forms)\n{\n",
+            source, st.c_str(), id);
+    m_code += buf;
+    m_code += m_body;
+    m_code += "}\n\n";
+
+    sprintf(buf, "    { \"%s\", 0x%08xu, aot_%d },\n", st.c_str(), hash, id);
+    m_entries.push_back(buf);
+}
+
+void LispCompiler::CompileFile(char const *filename)
+{
+    FILE *fp = fopen(filename, "rb");
+    if (!fp)
+    {
+        fprintf(stderr, "abuse-lispc: cannot open %s\n", filename);
+        exit(1);
+    }
+    std::string text;
+    char buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), fp)) > 0)
+        text.append(buf, n);
+    fclose(fp);
+
+    char const *source = strrchr(filename, '/');
+    source = source ? source + 1 : filename;
+
+    char const *cs = text.c_str();
+    LObject *form = NULL;
+    PtrRef r1(form);
+    while (!end_of_program(cs))
+    {
+        void *m = LSpace::Tmp.Mark();
+        form = LObject::Compile(cs);
+        // Only top level definitions, like the ones load evaluates
+        if (form && item_type(form) == L_CONS_CELL
+             && CAR(form) == LSymbol::Find("defun"))
+            CompileDefun(form, source);
+        form = NULL;
+        LSpace::Tmp.Restore(m);
+    }
+}
+
+bool LispCompiler::Write(char const *filename)
+{
+    FILE *fp = fopen(filename, "w");
+    if (!fp)
+    {
+        fprintf(stderr, "abuse-lispc: cannot write %s\n", filename);
+        return false;
+    }
+
+    fprintf(fp, "// Generated by abuse-lispc, do not edit.\n\n");
+    fprintf(fp, "#if defined HAVE_CONFIG_H\n#   include \"config.h\"\n#endif\n\n");
+    fprintf(fp, "#include \"common.h\"\n\n");
+    fprintf(fp, "#include \"lisp.h\"\n#include \"lisp_gc.h\"\n"
+                "#include \"lisp_aot.h\"\n\n");
+    fprintf(fp, "static LSymbol *aot_symbols[%d];\n\n",
+            (int)m_symbols.size() + 1);
+    fprintf(fp, "static char const *const aot_symbol_names[] =\n{\n");
+    for (size_t i = 0; i < m_symbols.size(); i++)
+    {
+        fputs("    \"", fp);
+        for (char const *s = m_symbols[i].c_str(); *s; s++)
+            fprintf(fp, *s == '"' || *s == '\\' ? "\\%c" : "%c", *s);
+        fputs("\",\n", fp);
+    }
+    fprintf(fp, "    NULL\n};\n\n");
+    fprintf(fp, "#define AOT_SYM(i) aot_symbols[i]\n");
+    fprintf(fp, "#define AOT_FORM(i) forms->GetData()[i]\n\n");
+    fputs(m_code.c_str(), fp);
+    fprintf(fp, "static LispAotEntry const aot_entries[] =\n{\n");
+    for (size_t i = 0; i < m_entries.size(); i++)
+        fputs(m_entries[i].c_str(), fp);
+    fprintf(fp, "    { NULL, 0, NULL }\n};\n\n");
+    fprintf(fp, "LispAotTable const lisp_aot_table =\n"
+                "{\n    aot_entries, aot_symbol_names, aot_symbols\n};\n");
+    fclose(fp);
+
+    printf("abuse-lispc: %d functions, %d forms compiled, %d interpreted\n",
+           m_functions, m_native, m_fallback);
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    char const *output = NULL;
+    std::vector<char const *> inputs;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "-o") && i + 1 < argc)
+            output = argv[++i];
+        else
+            inputs.push_back(argv[i]);
+    }
+
+    if (!output)
+    {
+        fprintf(stderr, "usage: abuse-lispc -o output.cpp file.lsp...\n");
+        return 1;
+    }
+
+    set_dprinter(print_stderr);
+    Lisp::Init();
+
+    LispCompiler compiler;
+    for (size_t i = 0; i < inputs.size(); i++)
+        compiler.CompileFile(inputs[i]);
+    bool ok = compiler.Write(output);
+
+    Lisp::Uninit();
+    return ok ? 0 : 1;
+}
@@ -40,6 +40,7 @@
 #include "sbar.h"
 #include "nfserver.h"
 #include "chat.h"
+#include "sampler.h"
 
 #define SHIFT_DOWN_DEFAULT 24
 #define SHIFT_RIGHT_DEFAULT 0
@@ -125,6 +126,15 @@ int view::weapon_total(int type)
 }
 
 
+// Blend a scroll position between the last two ticks, alpha is in 1/256ths.
+// Jumps larger than half the view (teleports, level warps) are not smoothed.
+static int32_t lerp_scroll(int32_t from, int32_t to, int alpha, int32_t limit)
+{
+    if (abs(to - from) > limit)
+        return to;
+    return from + (to - from) * alpha / 256;
+}
+
 int32_t view::xoff()
 {
     if (!m_focus)
@@ -133,12 +143,13 @@ int32_t view::xoff()
     return Max(0, m_lastpos.x - (m_bb.x - m_aa.x + 1) / 2 + m_shift.x + pan_x);
 }
 
-int32_t view::interpolated_xoff()
+int32_t view::interpolated_xoff(int alpha)
 {
     if (!m_focus)
         return pan_x;
 
-    return Max(0, (m_lastlastpos.x + m_lastpos.x) / 2
+    return Max(0, lerp_scroll(m_lastlastpos.x, m_lastpos.x, alpha,
+                              (m_bb.x - m_aa.x + 1) / 2)
                     - (m_bb.x - m_aa.x + 1) / 2 + m_shift.x + pan_x);
 }
 
@@ -150,12 +161,13 @@ int32_t view::yoff()
     return Max(0, m_lastpos.y - (m_bb.y - m_aa.y + 1) / 2 - m_shift.y + pan_y);
 }
 
-int32_t view::interpolated_yoff()
+int32_t view::interpolated_yoff(int alpha)
 {
     if (!m_focus)
         return pan_y;
 
-    return Max(0, (m_lastlastpos.y + m_lastpos.y) / 2
+    return Max(0, lerp_scroll(m_lastlastpos.y, m_lastpos.y, alpha,
+                              (m_bb.y - m_aa.y + 1) / 2)
                     - (m_bb.y - m_aa.y + 1) / 2 - m_shift.y + pan_y);
 }
 
@@ -467,6 +479,15 @@ void view::add_chat_key(int key)  // return string if buf is complete
 
 		  strcpy(m_chat_buf,chat_text.c_str());
 	  }
+	  else if(chat_text=="sample")
+	  {
+		  sampler_toggle(NULL);
+
+		  if(sampler_running()) chat_text += " STARTED";
+		  else chat_text += " WRITTEN";
+
+		  strcpy(m_chat_buf,chat_text.c_str());
+	  }
 	  else if(chat_text=="giveall")
 	  {
 		  chat_text += " DONE";
@@ -1251,7 +1272,11 @@ void process_packet_commands(uint8_t *pk, int size)
       pk += 2;
       x = lstl(x);
       if (demo_man.current_state() == demo_manager::PLAYING)
+      {
         sync_uint16 = make_sync();
+        if (x != sync_uint16)
+          demo_man.note_divergence();
+      }
 
       if (sync_uint16 == -1)
         sync_uint16 = x;
@@ -1265,6 +1290,17 @@ void process_packet_commands(uint8_t *pk, int size)
     }
     break;
     
+    case SCMD_NET_TIMING:
+    {
+      uint8_t delay = *(pk++);
+      uint16_t tick_ms;
+      memcpy(&tick_ms, pk, 2);
+      pk += 2;
+      if (demo_man.current_state() != demo_manager::PLAYING)
+        net_set_timing(delay, lstl(tick_ms));
+    }
+    break;
+
     case SCMD_DELETE_CLIENT:
     {
       uint8_t player_num = *(pk++);
@@ -80,9 +80,9 @@ public:
   int32_t x_center();                        // center of attention
   int32_t y_center();
   int32_t xoff();                            // top left and right corner of the screen
-  int32_t interpolated_xoff();
+  int32_t interpolated_xoff(int alpha);  // alpha in 1/256ths of a tick
   int32_t yoff();
-  int32_t interpolated_yoff();
+  int32_t interpolated_yoff(int alpha);
   int drawable();                        // network viewables are not drawable
   int local_player();                    //  just in case I ever need non-viewable local players.
 